@@ -295,12 +295,8 @@ rtsPackageArgs = package rts ? do
             , "-DTablesNextToCode="          ++ show ghcEnableTNC
             ]
 
-          -- We're after pur performance here. So make sure fast math and
-          -- vectorization is enabled.
-          , input "**/xxhash.c" ? pure
-            [ "-O3"
-            , "-ffast-math"
-            , "-ftree-vectorize" ]
+          -- We're after pure performance here.
+          , input "**/xxh3.c" ? arg "-O3"
 
             , inputs ["**/Evac.c", "**/Evac_thr.c"] ? arg "-funroll-loops"
 
@@ -185,8 +185,8 @@
 
 #define EVENT_USER_BINARY_MSG              181
 
-#define EVENT_CONC_MARK_BEGIN              200
-#define EVENT_CONC_MARK_END                201
+#define EVENT_CONC_MARK_BEGIN              200 /* (worker) */
+#define EVENT_CONC_MARK_END                201 /* (worker, marked_obj_count) */
 #define EVENT_CONC_SYNC_BEGIN              202
 #define EVENT_CONC_SYNC_END                203
 #define EVENT_CONC_SWEEP_BEGIN             204
@@ -194,12 +194,14 @@
 #define EVENT_CONC_UPD_REM_SET_FLUSH       206
 #define EVENT_NONMOVING_HEAP_CENSUS        207
 
+#define EVENT_MESSAGE_COUNTERS             208 /* (sent, batches, max_batch) */
+
 /*
  * The highest event code +1 that ghc itself emits. Note that some event
  * ranges higher than this are reserved but not currently emitted by ghc.
  * This must match the size of the EventDesc[] array in EventLog.c
  */
-#define NUM_GHC_EVENT_TAGS        208
+#define NUM_GHC_EVENT_TAGS        209
 
 #if 0  /* DEPRECATED EVENTS: */
 /* we don't actually need to record the thread, it's implicit */
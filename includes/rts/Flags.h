@@ -55,11 +55,18 @@ typedef struct _GC_FLAGS {
     bool         useNonmoving; // default = false
     bool         nonmovingSelectorOpt; // Do selector optimization in the
                                        // non-moving heap, default = false
+    uint32_t     nonmovingMarkThreads; // Number of threads marking and
+                                       // sweeping the non-moving heap,
+                                       // default = 1
+    bool         nonmovingLazySweep; // Let allocating threads sweep
+                                     // non-moving segments, default = false
     uint32_t     generations;
     bool squeezeUpdFrames;
 
     bool compact;		/* True <=> "compact all the time" */
     double  compactThreshold;
+    uint32_t compactThreads;    /* threads used to compact the oldest
+                                 * generation, default = 1 */
 
     bool sweep;		/* use "mostly mark-sweep" instead of copying
                                  * for the oldest generation */
@@ -72,6 +79,11 @@ typedef struct _GC_FLAGS {
     Time    longGCSync;         /* units: TIME_RESOLUTION */
 
     StgWord heapBase;           /* address to ask the OS for memory */
+    bool hugePages;             /* back the heap with transparent huge
+                                 * pages, see Note [Transparent huge pages] */
+    Time memoryReturnWindow;    /* units: TIME_RESOLUTION, 0 == return
+                                 * surplus memory at once, see Note
+                                 * [Gradual return of memory to the OS] */
 
     StgWord allocLimitGrace;    /* units: *blocks*
                                  * After an AllocationLimitExceeded
@@ -184,6 +196,8 @@ typedef struct _TRACE_FLAGS {
 typedef struct _CONCURRENT_FLAGS {
     Time ctxtSwitchTime;         /* units: TIME_RESOLUTION */
     int ctxtSwitchTicks;         /* derived */
+    bool stmGlobalClock;         /* See Note [STM global version clock]
+                                    in STM.c */
 } CONCURRENT_FLAGS;
 
 /*
@@ -209,6 +223,7 @@ typedef struct _CONCURRENT_FLAGS {
 /* See Note [Synchronization of flags and base APIs] */
 typedef struct _MISC_FLAGS {
     Time    tickInterval;        /* units: TIME_RESOLUTION */
+    bool tickless;               /* See Note [Tickless idle] in Timer.c */
     bool install_signal_handlers;
     bool install_seh_handlers;
     bool generate_dump_file;
@@ -253,6 +268,9 @@ typedef struct _PAR_FLAGS {
                                   * GC (default: use all nNodes). */
 
   bool           setAffinity;    /* force thread affinity with CPUs */
+  bool           stealThreads;   /* idle capabilities ask busy ones for
+                                  * threads, see Note [Pull-based thread
+                                  * stealing] */
 } PAR_FLAGS;
 
 /* See Note [Synchronization of flags and base APIs] */
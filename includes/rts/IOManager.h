@@ -29,6 +29,16 @@ void     setIOManagerControlFd   (uint32_t cap_no, int fd);
 void     setTimerManagerControlFd(int fd);
 void     setIOManagerWakeupFd   (int fd);
 
+// Wait for readiness of an fd (poll(2) events), or for a timeout, using
+// the io_uring of the calling Capability.  When the request completes the
+// RTS does tryPutMVar on the MVar behind the StablePtr and frees the
+// StablePtr, as hs_try_putmvar() does.  Call these through an unsafe
+// foreign import.  They return an id for ioUringCancel(), or 0 with errno
+// set (ENOSYS unless this is the threaded RTS on Linux).
+StgWord64 ioUringPollFd  (int fd, uint32_t events, HsStablePtr mvar);
+StgWord64 ioUringTimeout (StgWord64 usecs, HsStablePtr mvar);
+int       ioUringCancel  (StgWord64 id);
+
 #endif
 
 //
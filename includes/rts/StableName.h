@@ -23,7 +23,8 @@ typedef struct {
                          // otherwise. May be NULL temporarily during GC (when
                          // pointee dies).
 
-    StgPtr  old;         // Old Haskell object, used during GC
+    StgPtr  old;         // Address the entry is hashed under in the
+                         // address index, or NULL
 
     StgClosure *sn_obj;  // The StableName object, or NULL when the entry is
                          // free
@@ -378,6 +378,8 @@ struct StgTRecHeader_ {
   struct StgTRecHeader_     *enclosing_trec;
   StgTRecChunk              *current_chunk;
   TRecState                  state;
+  StgWord                    read_version; /* See Note [STM global version
+                                              clock] in rts/STM.c */
 };
 
 typedef struct {
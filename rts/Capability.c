@@ -25,6 +25,7 @@
 #include "Trace.h"
 #include "sm/GC.h" // for gcWorkerThread()
 #include "STM.h"
+#include "Messages.h"
 #include "RtsUtils.h"
 #include "sm/OSMem.h"
 #include "sm/BlockAlloc.h" // for countBlocks()
@@ -90,13 +91,54 @@ globalWorkToDo (void)
 #endif
 
 #if defined(THREADED_RTS)
+// Pick a random capability to start looking for a victim from, so that
+// idle capabilities don't all descend on capability 0.
+uint32_t
+randomStealStart (Capability *cap)
+{
+    return xorshift32(&cap->steal_seed) % n_capabilities;
+}
+
+// The most sparks we take from another capability in one go, see
+// Note [Stealing half a WSDeque]
+#define SPARK_STEAL_BATCH 32
+
+// Steal up to half of robbed's sparks.  The first useful one is
+// returned to be run, and the rest go into our own pool, where we (or
+// other thieves) will find them.
+static StgClosure *
+stealSparks (Capability *cap, Capability *robbed)
+{
+    StgClosure *batch[SPARK_STEAL_BATCH];
+    StgClosure *spark = NULL;
+    uint32_t i, n;
+
+    do {
+        n = stealHalfWSDeque(robbed->sparks, (void **)batch,
+                             SPARK_STEAL_BATCH);
+        for (i = 0; i < n; i++) {
+            if (fizzledSpark(batch[i])) {
+                cap->spark_stats.fizzled++;
+                traceEventSparkFizzle(cap);
+            } else if (spark == NULL) {
+                spark = batch[i];
+            } else if (!pushWSDeque(cap->sparks, batch[i])) {
+                cap->spark_stats.overflowed++;
+                traceEventSparkOverflow(cap);
+            }
+        }
+    } while (spark == NULL && n > 0);
+
+    return spark;
+}
+
 StgClosure *
 findSpark (Capability *cap)
 {
   Capability *robbed;
   StgClosurePtr spark;
   bool retry;
-  uint32_t i = 0;
+  uint32_t i = 0, start;
 
   if (!emptyRunQueue(cap) || cap->n_returning_tasks != 0) {
       // If there are other threads, don't try to run any new
@@ -138,22 +180,18 @@ findSpark (Capability *cap)
                  "cap %d: Trying to steal work from other capabilities",
                  cap->no);
 
-      /* visit cap.s 0..n-1 in sequence until a theft succeeds. We could
-      start at a random place instead of 0 as well.  */
+      /* visit the other caps, starting from a random one, until a
+         theft succeeds.  */
+      start = randomStealStart(cap);
       for ( i=0 ; i < n_capabilities ; i++ ) {
-          robbed = capabilities[i];
+          robbed = capabilities[(start + i) % n_capabilities];
           if (cap == robbed)  // ourselves...
               continue;
 
           if (emptySparkPoolCap(robbed)) // nothing to steal here
               continue;
 
-          spark = tryStealSpark(robbed->sparks);
-          while (spark != NULL && fizzledSpark(spark)) {
-              cap->spark_stats.fizzled++;
-              traceEventSparkFizzle(cap);
-              spark = tryStealSpark(robbed->sparks);
-          }
+          spark = stealSparks(cap, robbed);
           if (spark == NULL && !emptySparkPoolCap(robbed)) {
               // we conflicted with another thread while trying to steal;
               // try again later.
@@ -247,6 +285,7 @@ initCapability (Capability *cap, uint32_t i)
     cap->no = i;
     cap->node = capNoToNumaNode(i);
     cap->in_haskell        = false;
+    cap->preempt_at        = 0;
     cap->idle              = 0;
     cap->disabled          = false;
 
@@ -266,6 +305,17 @@ initCapability (Capability *cap, uint32_t i)
     cap->n_returning_tasks  = 0;
     cap->inbox              = (Message*)END_TSO_QUEUE;
     cap->putMVars           = NULL;
+    cap->outbox             = NULL;
+    cap->outbox_targets     = NULL;
+    cap->n_outbox_targets   = 0;
+    cap->outbox_size        = 0;
+    cap->outbox_interrupt   = false;
+    cap->messages_sent      = 0;
+    cap->message_batches    = 0;
+    cap->max_message_batch  = 0;
+    cap->sp_batch.n_reserved = 0;
+    cap->sp_batch.n_unfiled  = 0;
+    cap->sp_batch.n_freed    = 0;
     cap->sparks             = allocSparkPool();
     cap->spark_stats.created    = 0;
     cap->spark_stats.dud        = 0;
@@ -273,8 +323,13 @@ initCapability (Capability *cap, uint32_t i)
     cap->spark_stats.converted  = 0;
     cap->spark_stats.gcd        = 0;
     cap->spark_stats.fizzled    = 0;
+    cap->steal_seed             = i + 1; // xorshift state must be non-zero
+    cap->steal_request          = NULL;
+    cap->thread_migrations      = 0;
+    cap->remote_thread_migrations = 0;
 #if !defined(mingw32_HOST_OS)
     cap->io_manager_control_wr_fd = -1;
+    cap->io_uring               = NULL;
 #endif
 #endif
     cap->total_allocated        = 0;
@@ -308,6 +363,7 @@ initCapability (Capability *cap, uint32_t i)
     cap->context_switch = 0;
     cap->pinned_object_block = NULL;
     cap->pinned_object_blocks = NULL;
+    initBlockCache(&cap->block_cache, cap->node);
 
 #if defined(PROFILING)
     cap->r.rCCCS = CCS_SYSTEM;
@@ -434,6 +490,11 @@ moreCapabilities (uint32_t from USED_IF_THREADS, uint32_t to USED_IF_THREADS)
         }
     }
 
+    // every Capability needs an outbox for each of the new ones
+    for (i = 0; i < to; i++) {
+        growOutbox(capabilities[i], to);
+    }
+
     debugTrace(DEBUG_sched, "allocated %d more capabilities", to - from);
 
     if (old_capabilities != NULL) {
@@ -492,7 +553,7 @@ giveCapabilityToTask (Capability *cap USED_IF_DEBUG, Task *task)
         // the wakeup flag is needed because signalCondition() doesn't
         // flag the condition if the thread is already running, but we want
         // it to be sticky.
-        signalCondition(&task->cond);
+        signalSpinCondition(&task->cond);
     }
     RELEASE_LOCK(&task->lock);
 }
@@ -593,6 +654,7 @@ releaseCapability_ (Capability* cap,
 void
 releaseCapability (Capability* cap USED_IF_THREADS)
 {
+    flushOutbox(cap);
     ACQUIRE_LOCK(&cap->lock);
     releaseCapability_(cap, false);
     RELEASE_LOCK(&cap->lock);
@@ -601,6 +663,7 @@ releaseCapability (Capability* cap USED_IF_THREADS)
 void
 releaseAndWakeupCapability (Capability* cap USED_IF_THREADS)
 {
+    flushOutbox(cap);
     ACQUIRE_LOCK(&cap->lock);
     releaseCapability_(cap, true);
     RELEASE_LOCK(&cap->lock);
@@ -654,7 +717,7 @@ static Capability * waitForWorkerCapability (Task *task)
     for (;;) {
         ACQUIRE_LOCK(&task->lock);
         // task->lock held, cap->lock not held
-        if (!task->wakeup) waitCondition(&task->cond, &task->lock);
+        if (!task->wakeup) waitSpinCondition(&task->cond, &task->lock);
         cap = task->cap;
         task->wakeup = false;
         RELEASE_LOCK(&task->lock);
@@ -719,7 +782,7 @@ static Capability * waitForReturnCapability (Task *task)
     for (;;) {
         ACQUIRE_LOCK(&task->lock);
         // task->lock held, cap->lock not held
-        if (!task->wakeup) waitCondition(&task->cond, &task->lock);
+        if (!task->wakeup) waitSpinCondition(&task->cond, &task->lock);
         cap = task->cap;
         task->wakeup = false;
         RELEASE_LOCK(&task->lock);
@@ -874,6 +937,7 @@ yieldCapability (Capability** pCap, Task *task, bool gcAllowed)
                     gcWorkerThread(cap);
                     traceEventGcEnd(cap);
                     traceSparkCounters(cap);
+                    traceMessageCounters(cap);
                     // See Note [migrated bound threads 2]
                     if (task->cap == cap) {
                         return true;
@@ -893,6 +957,9 @@ yieldCapability (Capability** pCap, Task *task, bool gcAllowed)
 
     debugTrace(DEBUG_sched, "giving up capability %d", cap->no);
 
+    // deliver our messages before anyone waits for them
+    flushOutbox(cap);
+
     // We must now release the capability and wait to be woken up again.
     task->wakeup = false;
 
@@ -1116,6 +1183,7 @@ shutdownCapability (Capability *cap USED_IF_THREADS,
         }
 
         traceSparkCounters(cap);
+        traceMessageCounters(cap);
         RELEASE_LOCK(&cap->lock);
         break;
     }
@@ -1149,6 +1217,8 @@ freeCapability (Capability *cap)
     stgFree(cap->saved_mut_lists);
 #if defined(THREADED_RTS)
     freeSparkPool(cap->sparks);
+    stgFree(cap->outbox);
+    stgFree(cap->outbox_targets);
 #endif
     traceCapsetRemoveCap(CAPSET_OSPROCESS_DEFAULT, cap->no);
     traceCapsetRemoveCap(CAPSET_CLOCKDOMAIN_DEFAULT, cap->no);
@@ -1194,6 +1264,7 @@ markCapability (evac_fn evac, void *user, Capability *cap,
     evac(user, (StgClosure **)(void *)&cap->run_queue_tl);
 #if defined(THREADED_RTS)
     evac(user, (StgClosure **)(void *)&cap->inbox);
+    markOutbox(evac, user, cap);
 #endif
     for (incall = cap->suspended_ccalls; incall != NULL;
          incall=incall->next) {
@@ -24,6 +24,8 @@
 #include "Task.h"
 #include "Sparks.h"
 #include "sm/NonMovingMark.h" // for MarkQueue
+#include "sm/BlockAlloc.h" // for BlockCache
+#include "StablePtr.h" // for StablePtrBatch
 
 #include "BeginPrivate.h"
 
@@ -55,6 +57,10 @@ struct Capability_ {
     // catching unsafe call-ins.
     bool in_haskell;
 
+    // With --tickless, the timer tick at which the Haskell thread running
+    // on this Capability should be preempted; see Note [Tickless idle].
+    StgWord preempt_at;
+
     // Has there been any activity on this Capability since the last GC?
     uint32_t idle;
 
@@ -93,6 +99,11 @@ struct Capability_ {
     // full pinned object blocks allocated since the last GC
     bdescr *pinned_object_blocks;
 
+    // free blocks for this capability, so that the common small block
+    // allocations don't need sm_mutex.  See Note [Per-capability block
+    // caches] in BlockAlloc.c.
+    BlockCache block_cache;
+
     // per-capability weak pointer list associated with nursery (older
     // lists stored in generation object)
     StgWeak *weak_ptr_list_hd;
@@ -146,13 +157,52 @@ struct Capability_ {
     // can't go on the inbox queue: the GC would get confused.
     struct PutMVar_ *putMVars;
 
+    // Messages we have sent to other Capabilities but not yet delivered.
+    // outbox[i] is the list for capabilities[i] (END_TSO_QUEUE if empty),
+    // and outbox_targets[0..n_outbox_targets-1] are the i with a
+    // non-empty outbox[i].  Owned by the running Task, no lock required.
+    // See Note [Batched messages] in Messages.c.
+    Message **outbox;
+    uint32_t *outbox_targets;
+    uint32_t n_outbox_targets;
+    uint32_t outbox_size;        // number of entries in outbox[]
+    // sendMessage() interrupted the running Haskell thread only so that
+    // the outbox gets flushed, so the thread shouldn't lose its turn.
+    bool outbox_interrupt;
+
+    // Stats on message delivery
+    StgWord64 messages_sent;
+    StgWord64 message_batches;
+    StgWord64 max_message_batch;
+
+    // Stable pointer table slots for getStablePtr()/freeStablePtr() on
+    // this Capability.  Owned by the running Task, no lock required.
+    StablePtrBatch sp_batch;
+
     SparkPool *sparks;
 
     // Stats on spark creation/conversion
     SparkCounters spark_stats;
+
+    // State of the generator used to pick victims to steal from
+    uint32_t steal_seed;
+
+    // Threads we have moved to other Capabilities, and how many of
+    // those went to a Capability on another NUMA node
+    W_ thread_migrations;
+    W_ remote_thread_migrations;
+
+    // An idle Capability that wants some of our threads, or NULL.  Set
+    // with cas by the thief, cleared by us.  See Note [Pull-based
+    // thread stealing] in Schedule.c.
+    Capability * volatile steal_request;
 #if !defined(mingw32_HOST_OS)
     // IO manager for this cap
     int io_manager_control_wr_fd;
+
+    // io_uring for this cap, or NULL until first used.  See
+    // Note [io_uring IO manager] in posix/IOUring.c.
+    struct IOUring_ *io_uring;
 #endif
 #endif
 
@@ -334,6 +384,10 @@ bool tryGrabCapability (Capability *cap, Task *task);
 //
 StgClosure *findSpark (Capability *cap);
 
+// A random capability number to start looking for work to steal from
+//
+uint32_t randomStealStart (Capability *cap);
+
 // True if any capabilities have sparks
 //
 bool anySparks (void);
@@ -387,6 +441,21 @@ extern uint32_t numa_map[MAX_NUMA_NODES];
 
 #define capNoToNumaNode(n) ((n) % n_numa_nodes)
 
+/* Work stealing and work pushing prefer our own NUMA node: they make
+ * numaPasses() passes over the candidates, where pass 0 takes only those
+ * on our own node (home) and pass 1 only those on other nodes.  With a
+ * single node there is one pass that takes everyone. */
+INLINE_HEADER uint32_t numaPasses (void)
+{
+    return n_numa_nodes > 1 ? 2 : 1;
+}
+
+INLINE_HEADER bool numaPassIncludes (uint32_t pass, uint32_t home,
+                                     uint32_t node)
+{
+    return n_numa_nodes == 1 || (node == home) == (pass == 0);
+}
+
 /* -----------------------------------------------------------------------------
    Messages
    -------------------------------------------------------------------------- */
@@ -400,6 +469,9 @@ typedef struct PutMVar_ {
 
 INLINE_HEADER bool emptyInbox(Capability *cap);
 
+// Record that a thread has moved from cap to dest.  Requires cap.
+INLINE_HEADER void countMigration(Capability *cap, Capability *dest);
+
 #endif // THREADED_RTS
 
 /* -----------------------------------------------------------------------------
@@ -417,7 +489,7 @@ recordMutableCap (const StgClosure *p, Capability *cap, uint32_t gen)
     bd = cap->mut_lists[gen];
     if (bd->free >= bd->start + BLOCK_SIZE_W) {
         bdescr *new_bd;
-        new_bd = allocBlockOnNode_lock(cap->node);
+        new_bd = allocGroupCached(&cap->block_cache, 1);
         new_bd->link = bd;
         bd = new_bd;
         cap->mut_lists[gen] = bd;
@@ -481,6 +553,14 @@ INLINE_HEADER bool emptyInbox(Capability *cap)
             cap->putMVars == NULL);
 }
 
+INLINE_HEADER void countMigration(Capability *cap, Capability *dest)
+{
+    cap->thread_migrations++;
+    if (cap->node != dest->node) {
+        cap->remote_thread_migrations++;
+    }
+}
+
 #endif
 
 #include "EndPrivate.h"
@@ -41,7 +41,7 @@ STATIC_INLINE int cmpLocks(StgWord w1, StgWord w2)
     return (l1->device == l2->device && l1->inode == l2->inode);
 }
 
-STATIC_INLINE int hashLock(const HashTable *table, StgWord w)
+STATIC_INLINE StgWord hashLock(const HashTable *table, StgWord w)
 {
     Lock *l = (Lock *)w;
     StgWord key = l->inode ^ (l->inode >> 32) ^ l->device ^ (l->device >> 32);
@@ -3,9 +3,8 @@
  * (c) The AQUA Project, Glasgow University, 1995-1998
  * (c) The GHC Team, 1999
  *
- * Dynamically expanding linear hash tables, as described in
- * Per-\AAke Larson, ``Dynamic Hash Tables,'' CACM 31(4), April 1988,
- * pp. 446 -- 457.
+ * Dynamically expanding open-addressing hash tables; see Note [Hash table
+ * layout].
  * -------------------------------------------------------------------------- */
 
 #include "PosixSource.h"
@@ -13,42 +12,89 @@
 
 #include "Hash.h"
 #include "RtsUtils.h"
-#include "xxhash.h"
+#include "xxh3.h"
 
 #include <string.h>
 
-#define HSEGSIZE    1024    /* Size of a single hash table segment */
-                            /* Also the minimum size of a hash table */
-#define HDIRSIZE    1024    /* Size of the segment directory */
-                            /* Maximum hash table size is HSEGSIZE * HDIRSIZE */
-#define HLOAD       5       /* Maximum average load of a single hash bucket */
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* Note [Hash table layout]
+ *
+ * A hash table used to be a linear hash table with separate chaining
+ * (Larson, "Dynamic Hash Tables", CACM 31(4), 1988), with a malloc'd cell
+ * per key and a fixed-size segment directory that capped it at 1M
+ * buckets.  Every lookup followed a chain of pointers, which is slow for
+ * the big tables of the linker, CheckUnload and compact regions.
+ *
+ * Now it is an open-addressing table in the style of Abseil's "Swiss
+ * tables":
+ *
+ *  - The (key, data) pairs live in one array of slots, so inserting
+ *    allocates nothing except when the table grows.
+ *
+ *  - Alongside there is one control byte per slot: HCTRL_EMPTY,
+ *    HCTRL_DELETED, or, for a slot in use, 7 bits of the key's hash
+ *    ("h2"; the remaining bits, "h1", choose where to start looking).
+ *
+ *  - The slots are grouped into aligned groups of HGROUP = 16, and a
+ *    key's probe sequence visits whole groups: h1 picks the first, and
+ *    then we step 1, 2, 3, ... groups further on (modulo the number of
+ *    groups, a power of 2, so that every group is visited).  With SSE2
+ *    we compare all 16 control bytes of a group with h2 in one go and
+ *    only look at the keys of the slots that match, of which there are
+ *    usually none or one; without SSE2 the same is done a byte at a time.
+ *
+ *  - A lookup stops at the first group with an empty slot, so removing
+ *    an entry leaves a HCTRL_DELETED tombstone, unless its group already
+ *    has an empty slot and the probe sequences through it stop there
+ *    anyway.
+ *
+ *  - We keep the slots in use plus the tombstones below 7/8 of the
+ *    table, by rehashing into a table twice the size, or the same size
+ *    if it is mostly tombstones.  Tables never shrink.
+ *
+ * Word keys are mostly aligned pointers, and are often looked up in
+ * address order (e.g. when walking the heap).  The old table hashed a
+ * word key to itself, so neighbouring keys landed in neighbouring
+ * buckets and such walks stayed in the cache.  Mixing all of the bits
+ * would spread the aligned addresses over the groups but make every
+ * lookup a cache miss once the table is bigger than the cache, so
+ * hashWord() only mixes the part of the key above the 4KB page (plus the
+ * low 3 bits, which tell apart small integers such as file descriptors)
+ * and adds the key divided by 32: the keys of one page then fill
+ * consecutive groups, starting at a pseudo-random group per page.  h2
+ * still comes from a mix of the whole key.  With 4M keys, hits in
+ * address order take about 29ns (21ns with the old table, 53ns mixing
+ * every bit), scattered keys 65ns (144ns with the old table) and the
+ * integers 0..4M 15ns (359ns); see testsuite/tests/rts/hash_bench.c,
+ * which runs both tables.
+ *
+ * A key may be inserted more than once; lookupHashTable() then returns
+ * one of its values, and removeHashTable() (with NULL data) removes one
+ * of them.
+ */
 
-#define HCHUNK      (1024 * sizeof(W_) / sizeof(HashList))
-                            /* Number of HashList cells to allocate in one go */
+#define HGROUP      16              /* Slots per group */
+#define HWORD_SHIFT 5               /* see hashWord() */
+#define HWORD_PAGE  0xff8           /* see hashWord() */
+#define HMINSIZE    (4 * HGROUP)    /* Initial number of slots */
 
+#define HCTRL_EMPTY   ((uint8_t)0x80)
+#define HCTRL_DELETED ((uint8_t)0xfe)
 
-/* Linked list of (key, data) pairs for separate chaining */
-typedef struct hashlist {
+typedef struct {
     StgWord key;
     const void *data;
-    struct hashlist *next;  /* Next cell in bucket chain (same hash value) */
-} HashList;
-
-typedef struct chunklist {
-  HashList *chunk;
-  struct chunklist *next;
-} HashListChunk;
+} HashSlot;
 
 struct hashtable {
-    int split;              /* Next bucket to split when expanding */
-    int max;                /* Max bucket of smaller table */
-    int mask1;              /* Mask for doing the mod of h_1 (smaller table) */
-    int mask2;              /* Mask for doing the mod of h_2 (larger table) */
-    int kcount;             /* Number of keys */
-    int bcount;             /* Number of buckets */
-    HashList **dir[HDIRSIZE];   /* Directory of segments */
-    HashList *freeList;         /* free list of HashLists */
-    HashListChunk *chunks;
+    uint8_t *ctrl;          /* Control bytes, one per slot */
+    HashSlot *slots;
+    StgWord size;           /* Number of slots, a power of 2 */
+    StgWord kcount;         /* Number of keys */
+    StgWord deleted;        /* Number of tombstones */
 };
 
 /* Create an identical structure, but is distinct on a type level,
@@ -58,46 +104,40 @@ struct hashtable {
 struct strhashtable { struct hashtable table; };
 
 /* -----------------------------------------------------------------------------
- * Hash first using the smaller table.  If the bucket is less than the
- * next bucket to be split, re-hash using the larger table.
+ * Hash functions.  These return the full hash of a key; the table takes
+ * h1 and h2 from it.
  * -------------------------------------------------------------------------- */
-int
-hashWord(const HashTable *table, StgWord key)
-{
-    int bucket;
-
-    /* Strip the boring zero bits */
-    key >>= sizeof(StgWord);
 
-    /* Mod the size of the hash table (a power of 2) */
-    bucket = key & table->mask1;
-
-    if (bucket < table->split) {
-        /* Mod the size of the expanded hash table (also a power of 2) */
-        bucket = key & table->mask2;
-    }
-    return bucket;
-}
-
-int
-hashStr(const HashTable *table, StgWord w)
+/* Mix the bits of a word (this is the finaliser of MurmurHash3) */
+STATIC_INLINE StgWord
+mixWord(StgWord w)
 {
-    const char *key = (char*) w;
-#if defined(x86_64_HOST_ARCH)
-    StgWord h = XXH64 (key, strlen(key), 1048583);
+#if SIZEOF_VOID_P == 8
+    w ^= w >> 33;
+    w *= UINT64_C(0xff51afd7ed558ccd);
+    w ^= w >> 33;
 #else
-    StgWord h = XXH32 (key, strlen(key), 1048583);
+    w ^= w >> 16;
+    w *= 0x85ebca6b;
+    w ^= w >> 13;
 #endif
+    return w;
+}
 
-    /* Mod the size of the hash table (a power of 2) */
-    int bucket = h & table->mask1;
-
-    if (bucket < table->split) {
-        /* Mod the size of the expanded hash table (also a power of 2) */
-        bucket = h & table->mask2;
-    }
+StgWord
+hashWord(const HashTable *table STG_UNUSED, StgWord key)
+{
+    /* h1 is the key's 32-byte block plus a mix of its page, and h2 comes
+     * from a mix of the whole key; see Note [Hash table layout] */
+    StgWord h1 = (key >> HWORD_SHIFT) + mixWord(key & ~(StgWord)HWORD_PAGE);
+    return (h1 << 7) | (mixWord(key) & 0x7f);
+}
 
-    return bucket;
+StgWord
+hashStr(const HashTable *table STG_UNUSED, StgWord w)
+{
+    const char *key = (char*) w;
+    return (StgWord) xxh3_64bits(key, strlen(key));
 }
 
 STATIC_INLINE int
@@ -112,122 +152,205 @@ compareStr(StgWord key1, StgWord key2)
     return (strcmp((char *)key1, (char *)key2) == 0);
 }
 
+STATIC_INLINE uint8_t
+hashH2(StgWord h)
+{
+    return h & 0x7f;
+}
+
+STATIC_INLINE StgWord
+hashH1(StgWord h)
+{
+    return h >> 7;
+}
 
 /* -----------------------------------------------------------------------------
- * Allocate a new segment of the dynamically growing hash table.
+ * Probing a group: each function returns a bitmask with bit i set for the
+ * slots i of the group that qualify.
  * -------------------------------------------------------------------------- */
 
-STATIC_INLINE void
-allocSegment(HashTable *table, int segment)
+STATIC_INLINE uint32_t
+groupMatch(const uint8_t *ctrl, uint8_t h2)
+{
+#if defined(__SSE2__)
+    __m128i g = _mm_loadu_si128((const __m128i *)ctrl);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(h2)));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < HGROUP; i++) {
+        mask |= (uint32_t)(ctrl[i] == h2) << i;
+    }
+    return mask;
+#endif
+}
+
+STATIC_INLINE uint32_t
+groupMatchEmpty(const uint8_t *ctrl)
+{
+    return groupMatch(ctrl, HCTRL_EMPTY);
+}
+
+/* Empty or deleted: the slots with the top bit set */
+STATIC_INLINE uint32_t
+groupMatchFree(const uint8_t *ctrl)
 {
-    table->dir[segment] = stgMallocBytes(HSEGSIZE * sizeof(HashList *),
-                                         "allocSegment");
+#if defined(__SSE2__)
+    return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < HGROUP; i++) {
+        mask |= (uint32_t)(ctrl[i] >> 7) << i;
+    }
+    return mask;
+#endif
 }
 
+STATIC_INLINE int
+lowestBit(uint32_t mask)
+{
+    return __builtin_ctz(mask);
+}
 
 /* -----------------------------------------------------------------------------
- * Expand the larger hash table by one bucket, and split one bucket
- * from the smaller table into two parts.  Only the bucket referenced
- * by @table->split@ is affected by the expansion.
+ * Finding slots
  * -------------------------------------------------------------------------- */
 
-STATIC_INLINE void
-expand(HashTable *table, HashFunction f)
-{
-    int oldsegment;
-    int oldindex;
-    int newbucket;
-    int newsegment;
-    int newindex;
-    HashList *hl;
-    HashList *next;
-    HashList *old, *new;
-
-    if (table->split + table->max >= HDIRSIZE * HSEGSIZE)
-        /* Wow!  That's big.  Too big, so don't expand. */
-        return;
-
-    /* Calculate indices of bucket to split */
-    oldsegment = table->split / HSEGSIZE;
-    oldindex = table->split % HSEGSIZE;
-
-    newbucket = table->max + table->split;
-
-    /* And the indices of the new bucket */
-    newsegment = newbucket / HSEGSIZE;
-    newindex = newbucket % HSEGSIZE;
-
-    if (newindex == 0)
-        allocSegment(table, newsegment);
-
-    if (++table->split == table->max) {
-        table->split = 0;
-        table->max *= 2;
-        table->mask1 = table->mask2;
-        table->mask2 = table->mask2 << 1 | 1;
+/* The slot holding key, whose hash is h (and data, unless that is NULL),
+ * or -1 */
+STATIC_INLINE StgInt
+findSlot(const HashTable *table, StgWord key, StgWord h, const void *data,
+         CompareFunction cmp)
+{
+    uint8_t h2 = hashH2(h);
+    StgWord groups_mask = table->size / HGROUP - 1;
+    StgWord group = hashH1(h) & groups_mask;
+    StgWord step = 0;
+    uint32_t match;
+    StgWord slot;
+
+    while (1) {
+        const uint8_t *ctrl = table->ctrl + group * HGROUP;
+        for (match = groupMatch(ctrl, h2); match != 0; match &= match - 1) {
+            slot = group * HGROUP + lowestBit(match);
+            if (cmp(table->slots[slot].key, key)
+                && (data == NULL || table->slots[slot].data == data)) {
+                return slot;
+            }
+        }
+        if (groupMatchEmpty(ctrl) != 0) {
+            /* It's not there */
+            return -1;
+        }
+        step++;
+        group = (group + step) & groups_mask;
     }
-    table->bcount++;
-
-    /* Split the bucket, paying no attention to the original order */
+}
 
-    old = new = NULL;
-    for (hl = table->dir[oldsegment][oldindex]; hl != NULL; hl = next) {
-        next = hl->next;
-        if (f(table, hl->key) == newbucket) {
-            hl->next = new;
-            new = hl;
-        } else {
-            hl->next = old;
-            old = hl;
+/* A free slot for a key with hash h; the table must have one */
+STATIC_INLINE StgWord
+findFreeSlot(const HashTable *table, StgWord h)
+{
+    StgWord groups_mask = table->size / HGROUP - 1;
+    StgWord group = hashH1(h) & groups_mask;
+    StgWord step = 0;
+    uint32_t free;
+
+    while (1) {
+        free = groupMatchFree(table->ctrl + group * HGROUP);
+        if (free != 0) {
+            return group * HGROUP + lowestBit(free);
         }
+        step++;
+        group = (group + step) & groups_mask;
     }
-    table->dir[oldsegment][oldindex] = old;
-    table->dir[newsegment][newindex] = new;
+}
 
-    return;
+/* -----------------------------------------------------------------------------
+ * Allocating and resizing
+ * -------------------------------------------------------------------------- */
+
+static void
+allocSlots(HashTable *table, StgWord size)
+{
+    table->size = size;
+    table->ctrl = stgMallocBytes(size, "allocSlots");
+    table->slots = stgMallocBytes(size * sizeof(HashSlot), "allocSlots");
+    memset(table->ctrl, HCTRL_EMPTY, size);
+    table->kcount = 0;
+    table->deleted = 0;
 }
 
-STATIC_INLINE void*
-lookupHashTable_inlined(const HashTable *table, StgWord key,
-                        HashFunction f, CompareFunction cmp)
+/* Rehash all the entries into a table of the given size, dropping the
+ * tombstones */
+static void
+resize(HashTable *table, StgWord size, HashFunction f)
 {
-    int bucket;
-    int segment;
-    int index;
+    uint8_t *old_ctrl = table->ctrl;
+    HashSlot *old_slots = table->slots;
+    StgWord old_size = table->size;
+    StgWord kcount = table->kcount;
+    StgWord i, slot, h;
+
+    allocSlots(table, size);
+    for (i = 0; i < old_size; i++) {
+        if (!(old_ctrl[i] & 0x80)) {
+            h = f(table, old_slots[i].key);
+            slot = findFreeSlot(table, h);
+            table->ctrl[slot] = hashH2(h);
+            table->slots[slot] = old_slots[i];
+        }
+    }
+    table->kcount = kcount;
+
+    stgFree(old_ctrl);
+    stgFree(old_slots);
+}
 
-    HashList *hl;
+/* -----------------------------------------------------------------------------
+ * Lookup, insert and remove
+ * -------------------------------------------------------------------------- */
 
-    bucket = f(table, key);
-    segment = bucket / HSEGSIZE;
-    index = bucket % HSEGSIZE;
+STATIC_INLINE void*
+lookupHashTable_inlined(const HashTable *table, StgWord key, StgWord h,
+                        CompareFunction cmp)
+{
+    StgInt slot = findSlot(table, key, h, NULL, cmp);
 
-    for (hl = table->dir[segment][index]; hl != NULL; hl = hl->next) {
-        if (cmp(hl->key, key))
-            return (void *) hl->data;
+    if (slot < 0) {
+        return NULL;
     }
-
-    /* It's not there */
-    return NULL;
+    return (void *) table->slots[slot].data;
 }
 
 void *
 lookupHashTable_(const HashTable *table, StgWord key,
                  HashFunction f, CompareFunction cmp)
 {
-    return lookupHashTable_inlined(table, key, f, cmp);
+    return lookupHashTable_inlined(table, key, f(table, key), cmp);
 }
 
 void *
 lookupHashTable(const HashTable *table, StgWord key)
 {
-    return lookupHashTable_inlined(table, key, hashWord, compareWord);
+    return lookupHashTable_inlined(table, key, hashWord(table, key),
+                                   compareWord);
 }
 
 void *
 lookupStrHashTable(const StrHashTable* table, const char* key)
 {
     return lookupHashTable_inlined(&table->table, (StgWord) key,
-                                   hashStr, compareStr);
+                                   hashStr(&table->table, (StgWord) key),
+                                   compareStr);
+}
+
+void *
+lookupStrHashTableHashed(const StrHashTable* table, const char* key,
+                         StgWord hash)
+{
+    ASSERT(hash == hashStr(&table->table, (StgWord) key));
+    return lookupHashTable_inlined(&table->table, (StgWord) key, hash,
+                                   compareStr);
 }
 
 // Puts up to szKeys keys of the hash table into the given array. Returns the
@@ -236,165 +359,132 @@ lookupStrHashTable(const StrHashTable* table, const char* key)
 // If the table is modified concurrently, the function behavior is undefined.
 //
 int keysHashTable(HashTable *table, StgWord keys[], int szKeys) {
-    int segment, index;
+    StgWord i;
     int k = 0;
-    HashList *hl;
 
-
-    /* The last bucket with something in it is table->max + table->split - 1 */
-    segment = (table->max + table->split - 1) / HSEGSIZE;
-    index = (table->max + table->split - 1) % HSEGSIZE;
-
-    while (segment >= 0 && k < szKeys) {
-        while (index >= 0 && k < szKeys) {
-            hl = table->dir[segment][index];
-            while (hl && k < szKeys) {
-                keys[k] = hl->key;
-                k += 1;
-                hl = hl->next;
-            }
-            index--;
+    for (i = 0; i < table->size && k < szKeys; i++) {
+        if (!(table->ctrl[i] & 0x80)) {
+            keys[k++] = table->slots[i].key;
         }
-        segment--;
-        index = HSEGSIZE - 1;
     }
     return k;
 }
 
-/* -----------------------------------------------------------------------------
- * We allocate the hashlist cells in large chunks to cut down on malloc
- * overhead.  Although we keep a free list of hashlist cells, we make
- * no effort to actually return the space to the malloc arena.
- * -------------------------------------------------------------------------- */
-
-static HashList *
-allocHashList (HashTable *table)
-{
-    HashList *hl, *p;
-    HashListChunk *cl;
-
-    if ((hl = table->freeList) != NULL) {
-        table->freeList = hl->next;
-    } else {
-        hl = stgMallocBytes(HCHUNK * sizeof(HashList), "allocHashList");
-        cl = stgMallocBytes(sizeof (*cl), "allocHashList: chunkList");
-        cl->chunk = hl;
-        cl->next = table->chunks;
-        table->chunks = cl;
-
-        table->freeList = hl + 1;
-        for (p = table->freeList; p < hl + HCHUNK - 1; p++)
-            p->next = p + 1;
-        p->next = NULL;
-    }
-    return hl;
-}
-
-static void
-freeHashList (HashTable *table, HashList *hl)
-{
-    hl->next = table->freeList;
-    table->freeList = hl;
-}
-
+/* f is only used to rehash the other keys if the table has to grow */
 STATIC_INLINE void
-insertHashTable_inlined(HashTable *table, StgWord key,
+insertHashTable_inlined(HashTable *table, StgWord key, StgWord h,
                         const void *data, HashFunction f)
 {
-    int bucket;
-    int segment;
-    int index;
-    HashList *hl;
+    StgWord slot;
 
     // Disable this assert; sometimes it's useful to be able to
     // overwrite entries in the hash table.
     // ASSERT(lookupHashTable(table, key) == NULL);
 
-    /* When the average load gets too high, we expand the table */
-    if (++table->kcount >= HLOAD * table->bcount)
-        expand(table, f);
-
-    bucket = f(table, key);
-    segment = bucket / HSEGSIZE;
-    index = bucket % HSEGSIZE;
-
-    hl = allocHashList(table);
+    /* When the table gets too full, we expand it, or just clear out the
+     * tombstones if there are plenty of them */
+    if (table->kcount + table->deleted + 1 > table->size / 8 * 7) {
+        if (table->kcount + 1 > table->size / 16 * 7) {
+            resize(table, table->size * 2, f);
+        } else {
+            resize(table, table->size, f);
+        }
+    }
 
-    hl->key = key;
-    hl->data = data;
-    hl->next = table->dir[segment][index];
-    table->dir[segment][index] = hl;
+    slot = findFreeSlot(table, h);
+    if (table->ctrl[slot] == HCTRL_DELETED) {
+        table->deleted--;
+    }
+    table->ctrl[slot] = hashH2(h);
+    table->slots[slot].key = key;
+    table->slots[slot].data = data;
+    table->kcount++;
 }
 
 void
 insertHashTable_(HashTable *table, StgWord key,
                  const void *data, HashFunction f)
 {
-    return insertHashTable_inlined(table, key, data, f);
+    return insertHashTable_inlined(table, key, f(table, key), data, f);
 }
 
 void
 insertHashTable(HashTable *table, StgWord key, const void *data)
 {
-    insertHashTable_inlined(table, key, data, hashWord);
+    insertHashTable_inlined(table, key, hashWord(table, key), data, hashWord);
 }
 
 void
 insertStrHashTable(StrHashTable *table, const char * key, const void *data)
 {
-    insertHashTable_inlined(&table->table, (StgWord) key, data, hashStr);
+    insertHashTable_inlined(&table->table, (StgWord) key,
+                            hashStr(&table->table, (StgWord) key),
+                            data, hashStr);
+}
+
+void
+insertStrHashTableHashed(StrHashTable *table, const char * key, StgWord hash,
+                         const void *data)
+{
+    ASSERT(hash == hashStr(&table->table, (StgWord) key));
+    insertHashTable_inlined(&table->table, (StgWord) key, hash, data, hashStr);
 }
 
 STATIC_INLINE void*
-removeHashTable_inlined(HashTable *table, StgWord key, const void *data,
-                        HashFunction f, CompareFunction cmp)
-{
-    int bucket;
-    int segment;
-    int index;
-    HashList *hl;
-    HashList *prev = NULL;
-
-    bucket = f(table, key);
-    segment = bucket / HSEGSIZE;
-    index = bucket % HSEGSIZE;
-
-    for (hl = table->dir[segment][index]; hl != NULL; hl = hl->next) {
-        if (cmp(hl->key, key) && (data == NULL || hl->data == data)) {
-            if (prev == NULL)
-                table->dir[segment][index] = hl->next;
-            else
-                prev->next = hl->next;
-            freeHashList(table,hl);
-            table->kcount--;
-            return (void *) hl->data;
-        }
-        prev = hl;
+removeHashTable_inlined(HashTable *table, StgWord key, StgWord h,
+                        const void *data, CompareFunction cmp)
+{
+    StgInt slot = findSlot(table, key, h, data, cmp);
+    uint8_t *group_ctrl;
+
+    if (slot < 0) {
+        /* It's not there */
+        ASSERT(data == NULL);
+        return NULL;
     }
 
-    /* It's not there */
-    ASSERT(data == NULL);
-    return NULL;
+    /* If the group has an empty slot, no probe sequence goes past it, so
+     * this one can be emptied too; see Note [Hash table layout] */
+    group_ctrl = table->ctrl + (slot & ~(StgWord)(HGROUP - 1));
+    if (groupMatchEmpty(group_ctrl) != 0) {
+        table->ctrl[slot] = HCTRL_EMPTY;
+    } else {
+        table->ctrl[slot] = HCTRL_DELETED;
+        table->deleted++;
+    }
+    table->kcount--;
+    return (void *) table->slots[slot].data;
 }
 
 void*
 removeHashTable_(HashTable *table, StgWord key, const void *data,
                  HashFunction f, CompareFunction cmp)
 {
-    return removeHashTable_inlined(table, key, data, f, cmp);
+    return removeHashTable_inlined(table, key, f(table, key), data, cmp);
 }
 
 void *
 removeHashTable(HashTable *table, StgWord key, const void *data)
 {
-    return removeHashTable_inlined(table, key, data, hashWord, compareWord);
+    return removeHashTable_inlined(table, key, hashWord(table, key), data,
+                                   compareWord);
 }
 
 void *
 removeStrHashTable(StrHashTable *table, const char * key, const void *data)
 {
     return removeHashTable_inlined(&table->table, (StgWord) key,
-                                   data, hashStr, compareStr);
+                                   hashStr(&table->table, (StgWord) key),
+                                   data, compareStr);
+}
+
+void *
+removeStrHashTableHashed(StrHashTable *table, const char * key, StgWord hash,
+                         const void *data)
+{
+    ASSERT(hash == hashStr(&table->table, (StgWord) key));
+    return removeHashTable_inlined(&table->table, (StgWord) key, hash,
+                                   data, compareStr);
 }
 
 /* -----------------------------------------------------------------------------
@@ -406,34 +496,17 @@ removeStrHashTable(StrHashTable *table, const char * key, const void *data)
 void
 freeHashTable(HashTable *table, void (*freeDataFun)(void *) )
 {
-    long segment;
-    long index;
-    HashList *hl;
-    HashList *next;
-    HashListChunk *cl, *cl_next;
-
-    /* The last bucket with something in it is table->max + table->split - 1 */
-    segment = (table->max + table->split - 1) / HSEGSIZE;
-    index = (table->max + table->split - 1) % HSEGSIZE;
-
-    while (segment >= 0) {
-        while (index >= 0) {
-            for (hl = table->dir[segment][index]; hl != NULL; hl = next) {
-                next = hl->next;
-                if (freeDataFun != NULL)
-                    (*freeDataFun)((void *) hl->data);
+    StgWord i;
+
+    if (freeDataFun != NULL) {
+        for (i = 0; i < table->size; i++) {
+            if (!(table->ctrl[i] & 0x80)) {
+                (*freeDataFun)((void *) table->slots[i].data);
             }
-            index--;
         }
-        stgFree(table->dir[segment]);
-        segment--;
-        index = HSEGSIZE - 1;
-    }
-    for (cl = table->chunks; cl != NULL; cl = cl_next) {
-        cl_next = cl->next;
-        stgFree(cl->chunk);
-        stgFree(cl);
     }
+    stgFree(table->ctrl);
+    stgFree(table->slots);
     stgFree(table);
 }
 
@@ -444,67 +517,34 @@ freeHashTable(HashTable *table, void (*freeDataFun)(void *) )
 void
 mapHashTable(HashTable *table, void *data, MapHashFn fn)
 {
-    /* The last bucket with something in it is table->max + table->split - 1 */
-    long segment = (table->max + table->split - 1) / HSEGSIZE;
-    long index = (table->max + table->split - 1) % HSEGSIZE;
-
-    while (segment >= 0) {
-        while (index >= 0) {
-            for (HashList *hl = table->dir[segment][index]; hl != NULL; hl = hl->next) {
-                fn(data, hl->key, hl->data);
-            }
-            index--;
+    for (StgWord i = 0; i < table->size; i++) {
+        if (!(table->ctrl[i] & 0x80)) {
+            fn(data, table->slots[i].key, table->slots[i].data);
         }
-        segment--;
-        index = HSEGSIZE - 1;
     }
 }
 
 void
 mapHashTableKeys(HashTable *table, void *data, MapHashFnKeys fn)
 {
-    /* The last bucket with something in it is table->max + table->split - 1 */
-    long segment = (table->max + table->split - 1) / HSEGSIZE;
-    long index = (table->max + table->split - 1) % HSEGSIZE;
-
-    while (segment >= 0) {
-        while (index >= 0) {
-            for (HashList *hl = table->dir[segment][index]; hl != NULL; hl = hl->next) {
-                fn(data, &hl->key, hl->data);
-            }
-            index--;
+    for (StgWord i = 0; i < table->size; i++) {
+        if (!(table->ctrl[i] & 0x80)) {
+            fn(data, &table->slots[i].key, table->slots[i].data);
         }
-        segment--;
-        index = HSEGSIZE - 1;
     }
 }
 
 /* -----------------------------------------------------------------------------
- * When we initialize a hash table, we set up the first segment as well,
- * initializing all of the first segment's hash buckets to NULL.
+ * When we initialize a hash table, we set up a few groups of empty slots.
  * -------------------------------------------------------------------------- */
 
 HashTable *
 allocHashTable(void)
 {
     HashTable *table;
-    HashList **hb;
 
     table = stgMallocBytes(sizeof(HashTable),"allocHashTable");
-
-    allocSegment(table, 0);
-
-    for (hb = table->dir[0]; hb < table->dir[0] + HSEGSIZE; hb++)
-        *hb = NULL;
-
-    table->split = 0;
-    table->max = HSEGSIZE;
-    table->mask1 = HSEGSIZE - 1;
-    table->mask2 = 2 * HSEGSIZE - 1;
-    table->kcount = 0;
-    table->bcount = HSEGSIZE;
-    table->freeList = NULL;
-    table->chunks = NULL;
+    allocSlots(table, HMINSIZE);
 
     return table;
 }
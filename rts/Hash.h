@@ -54,6 +54,17 @@ void *      lookupStrHashTable ( const StrHashTable *table, const char * key);
 void *      removeStrHashTable ( StrHashTable *table, const char * key,
                                  const void *data );
 
+/* The same, for callers that keep the hash of each key, as given by
+ * strHash(), so that it is computed only once; see e.g. Symbol_t in
+ * LinkerInternals.h.
+ */
+void        insertStrHashTableHashed ( StrHashTable *table, const char * key,
+                                       StgWord hash, const void *data );
+void *      lookupStrHashTableHashed ( const StrHashTable *table,
+                                       const char * key, StgWord hash );
+void *      removeStrHashTableHashed ( StrHashTable *table, const char * key,
+                                       StgWord hash, const void *data );
+
 /*
  * Hash tables for arbitrary key types.
  * Generally, these functions allow for the specification of the
@@ -63,11 +74,19 @@ void *      removeStrHashTable ( StrHashTable *table, const char * key,
  * it's not guaranteed. Either way, the functions are parameters
  * as the types should be statically known and thus
  * storing them is unnecessary.
+ *
+ * A HashFunction returns the full hash of a key, from which the table
+ * takes what it needs; it must not depend on the size of the table.
  */
-typedef int HashFunction(const HashTable *table, StgWord key);
+typedef StgWord HashFunction(const HashTable *table, StgWord key);
 typedef int CompareFunction(StgWord key1, StgWord key2);
-int hashWord(const HashTable *table, StgWord key);
-int hashStr(const HashTable *table, StgWord w);
+StgWord hashWord(const HashTable *table, StgWord key);
+StgWord hashStr(const HashTable *table, StgWord w);
+
+INLINE_HEADER StgWord strHash ( const char *key )
+{
+    return hashStr(NULL, (StgWord) key);
+}
 void        insertHashTable_ ( HashTable *table, StgWord key,
                                const void *data, HashFunction f );
 void *      lookupHashTable_ ( const HashTable *table, StgWord key,
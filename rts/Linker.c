@@ -228,11 +228,11 @@ int ocTryLoad( ObjectCode* oc );
 static void *mmap_32bit_base = (void *)MMAP_32BIT_BASE_DEFAULT;
 
 static void ghciRemoveSymbolTable(StrHashTable *table, const SymbolName* key,
-    ObjectCode *owner)
+    StgWord hash, ObjectCode *owner)
 {
-    RtsSymbolInfo *pinfo = lookupStrHashTable(table, key);
+    RtsSymbolInfo *pinfo = lookupStrHashTableHashed(table, key, hash);
     if (!pinfo || owner != pinfo->owner) return;
-    removeStrHashTable(table, key, NULL);
+    removeStrHashTableHashed(table, key, hash, NULL);
     if (isSymbolImport (owner, key))
       stgFree(pinfo->value);
 
@@ -268,14 +268,27 @@ int ghciInsertSymbolTable(
    HsBool weak,
    ObjectCode *owner)
 {
-   RtsSymbolInfo *pinfo = lookupStrHashTable(table, key);
+   return ghciInsertSymbolTableHashed(obj_name, table, key, strHash(key),
+                                      data, weak, owner);
+}
+
+int ghciInsertSymbolTableHashed(
+   pathchar* obj_name,
+   StrHashTable *table,
+   const SymbolName* key,
+   StgWord hash,
+   SymbolAddr* data,
+   HsBool weak,
+   ObjectCode *owner)
+{
+   RtsSymbolInfo *pinfo = lookupStrHashTableHashed(table, key, hash);
    if (!pinfo) /* new entry */
    {
       pinfo = stgMallocBytes(sizeof (*pinfo), "ghciInsertToSymbolTable");
       pinfo->value = data;
       pinfo->owner = owner;
       pinfo->weak = weak;
-      insertStrHashTable(table, key, pinfo);
+      insertStrHashTableHashed(table, key, hash, pinfo);
       return 1;
    }
    else if (weak && data && pinfo->weak && !pinfo->value)
@@ -1139,7 +1152,8 @@ static void removeOcSymbols (ObjectCode *oc)
     int i;
     for (i = 0; i < oc->n_symbols; i++) {
         if (oc->symbols[i].name != NULL) {
-            ghciRemoveSymbolTable(symhash, oc->symbols[i].name, oc);
+            ghciRemoveSymbolTable(symhash, oc->symbols[i].name,
+                                  symbolHash(&oc->symbols[i]), oc);
         }
     }
 
@@ -1647,13 +1661,15 @@ int ocTryLoad (ObjectCode* oc) {
         are distinguished by name, oc and attributes (weak symbols etc).
     */
     int x;
-    Symbol_t symbol;
+    Symbol_t *symbol;
     for (x = 0; x < oc->n_symbols; x++) {
-        symbol = oc->symbols[x];
-        if (   symbol.name
-            && !ghciInsertSymbolTable(oc->fileName, symhash, symbol.name,
-                                      symbol.addr,
-                                      isSymbolWeak(oc, symbol.name), oc)) {
+        symbol = &oc->symbols[x];
+        if (   symbol->name
+            && !ghciInsertSymbolTableHashed(oc->fileName, symhash,
+                                            symbol->name, symbolHash(symbol),
+                                            symbol->addr,
+                                            isSymbolWeak(oc, symbol->name),
+                                            oc)) {
             return 0;
         }
     }
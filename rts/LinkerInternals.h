@@ -27,8 +27,21 @@ typedef struct _Symbol
 {
     SymbolName *name;
     SymbolAddr *addr;
+    StgWord hash;       /* strHash(name), or 0 if not computed yet; a symbol
+                           goes in and out of symhash several times (see
+                           ocTryLoad and removeOcSymbols), so we hash its
+                           name only once */
 } Symbol_t;
 
+/* The hash of a symbol's name, computing it if we haven't yet */
+INLINE_HEADER StgWord symbolHash (Symbol_t *symbol)
+{
+    if (symbol->hash == 0) {
+        symbol->hash = strHash(symbol->name);
+    }
+    return symbol->hash;
+}
+
 /* Indication of section kinds for loaded objects.  Needed by
    the GC for deciding whether or not a pointer on the stack
    is a code pointer.
@@ -315,6 +328,16 @@ int ghciInsertSymbolTable(
     HsBool weak,
     ObjectCode *owner);
 
+/* As ghciInsertSymbolTable, given strHash(key) */
+int ghciInsertSymbolTableHashed(
+    pathchar* obj_name,
+    StrHashTable *table,
+    const SymbolName* key,
+    StgWord hash,
+    SymbolAddr* data,
+    HsBool weak,
+    ObjectCode *owner);
+
 /* lock-free version of lookupSymbol */
 SymbolAddr* lookupSymbol_ (SymbolName* lbl);
 
@@ -13,17 +13,73 @@
 #include "Schedule.h"
 #include "Threads.h"
 #include "RaiseAsync.h"
+#include "RtsUtils.h"
 #include "sm/Storage.h"
 
 /* ----------------------------------------------------------------------------
    Send a message to another Capability
+
+   Note [Batched messages]
+   ~~~~~~~~~~~~~~~~~~~~~~~
+
+   Delivering a message means taking the target Capability's lock,
+   pushing the message on its inbox and then either waking up a worker
+   on it (if it was free) or interrupting it.  When one thread wakes
+   up many others, e.g. by writing to a TVar or updating a blackhole
+   that lots of threads are waiting on, or just by feeding many
+   consumers through MVars in a loop, doing all of that for every
+   message means a lot of lock and wakeup traffic on the receiving
+   Capabilities, which are likely to be busy processing the earlier
+   messages.
+
+   So sendMessage() doesn't deliver the message straight away: it puts
+   it in the sending Capability's outbox for the target (cap->outbox[n]
+   is a list of messages for capabilities[n]).  flushOutbox() later
+   moves each of these lists onto the target's inbox under a single
+   acquisition of its lock, and prods the target once for the whole
+   batch.
+
+   Messages have to be delivered before anyone can depend on them being
+   processed, which in practice means before the sending Capability goes
+   back to running Haskell code or gives up the Capability.  So we
+   flush:
+
+     - in the scheduler, just before running a Haskell thread, and
+       before schedule() returns;
+     - in releaseCapability(), releaseAndWakeupCapability(),
+       yieldCapability(), suspendThread() and rts_unlock();
+     - when the Haskell thread that sent the messages is still running:
+       the first message put in an empty outbox interrupts the sending
+       Capability, so the thread comes back to the scheduler at its
+       next heap check.  Everything sent in the meantime goes out in
+       one batch.
+
+   The thread must not lose its turn because of that interrupt.  It
+   usually returns with ThreadYielding, and scheduleHandleYield() puts
+   it back at the front of the run queue.  But it can also return with
+   HeapOverflow, and scheduleHandleHeapOverflow() treats a NULL HpLim
+   as a missed context switch and appends the thread to the run queue.
+   So sendMessage() sets cap->outbox_interrupt along with the
+   interrupt, and scheduleHandleHeapOverflow() keeps the thread at the
+   front when that flag is set and no real context switch is pending.
+   flushOutbox() clears the flag.
+
+   A message in an outbox is reachable only from there, so the outboxes
+   are GC roots (markOutbox()).  The order in which the messages to one
+   Capability are processed is unchanged: its inbox is a stack either
+   way.
+
+   The number of messages delivered, the number of batches they were
+   delivered in and the largest batch are kept in the Capability and
+   posted to the eventlog alongside the spark counters
+   (EVENT_MESSAGE_COUNTERS, enabled by +RTS -ls).
    ------------------------------------------------------------------------- */
 
 #if defined(THREADED_RTS)
 
 void sendMessage(Capability *from_cap, Capability *to_cap, Message *msg)
 {
-    ACQUIRE_LOCK(&to_cap->lock);
+    uint32_t n = to_cap->no;
 
 #if defined(DEBUG)
     {
@@ -38,20 +94,91 @@ void sendMessage(Capability *from_cap, Capability *to_cap, Message *msg)
     }
 #endif
 
-    msg->link = to_cap->inbox;
-    to_cap->inbox = msg;
+    ASSERT(n < from_cap->outbox_size);
+
+    if (from_cap->outbox[n] == (Message*)END_TSO_QUEUE) {
+        if (from_cap->n_outbox_targets == 0 && from_cap->in_haskell) {
+            // come back to the scheduler soon to deliver the batch
+            interruptCapability(from_cap);
+            from_cap->outbox_interrupt = true;
+        }
+        from_cap->outbox_targets[from_cap->n_outbox_targets++] = n;
+    }
+    msg->link = from_cap->outbox[n];
+    from_cap->outbox[n] = msg;
 
     recordClosureMutated(from_cap,(StgClosure*)msg);
+}
+
+void flushOutbox_ (Capability *cap)
+{
+    uint32_t i, n_msgs;
+    Capability *to_cap;
+    Message *msg, *next;
+
+    for (i = 0; i < cap->n_outbox_targets; i++) {
+        to_cap = capabilities[cap->outbox_targets[i]];
+        msg = cap->outbox[to_cap->no];
+        cap->outbox[to_cap->no] = (Message*)END_TSO_QUEUE;
+        n_msgs = 0;
+
+        ACQUIRE_LOCK(&to_cap->lock);
+
+        for (; msg != (Message*)END_TSO_QUEUE; msg = next) {
+            next = msg->link;
+            msg->link = to_cap->inbox;
+            to_cap->inbox = msg;
+            // msg->link has changed, and msg may be old
+            recordClosureMutated(cap,(StgClosure*)msg);
+            n_msgs++;
+        }
+
+        if (to_cap->running_task == NULL) {
+            to_cap->running_task = myTask();
+                // precond for releaseCapability_()
+            releaseCapability_(to_cap,false);
+        } else {
+            interruptCapability(to_cap);
+        }
+
+        RELEASE_LOCK(&to_cap->lock);
+
+        cap->messages_sent += n_msgs;
+        cap->message_batches++;
+        if (n_msgs > cap->max_message_batch) {
+            cap->max_message_batch = n_msgs;
+        }
+    }
+
+    cap->n_outbox_targets = 0;
+    cap->outbox_interrupt = false;
+}
+
+void growOutbox (Capability *cap, uint32_t n_caps)
+{
+    uint32_t i;
 
-    if (to_cap->running_task == NULL) {
-        to_cap->running_task = myTask();
-            // precond for releaseCapability_()
-        releaseCapability_(to_cap,false);
-    } else {
-        interruptCapability(to_cap);
+    if (n_caps <= cap->outbox_size) {
+        return;
+    }
+    cap->outbox = stgReallocBytes(cap->outbox, n_caps * sizeof(Message*),
+                                  "growOutbox");
+    cap->outbox_targets = stgReallocBytes(cap->outbox_targets,
+                                          n_caps * sizeof(uint32_t),
+                                          "growOutbox");
+    for (i = cap->outbox_size; i < n_caps; i++) {
+        cap->outbox[i] = (Message*)END_TSO_QUEUE;
     }
+    cap->outbox_size = n_caps;
+}
 
-    RELEASE_LOCK(&to_cap->lock);
+void markOutbox (evac_fn evac, void *user, Capability *cap)
+{
+    uint32_t i;
+
+    for (i = 0; i < cap->n_outbox_targets; i++) {
+        evac(user, (StgClosure **)(void *)&cap->outbox[cap->outbox_targets[i]]);
+    }
 }
 
 #endif /* THREADED_RTS */
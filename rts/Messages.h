@@ -22,6 +22,25 @@ void sendMessage    (Capability *from_cap, Capability *to_cap, Message *msg);
 #include "Updates.h" // for DEBUG_FILL_SLOP
 #include "SMPClosureOps.h"
 
+#if defined(THREADED_RTS)
+// See Note [Batched messages] in Messages.c
+void flushOutbox_   (Capability *cap);
+void growOutbox     (Capability *cap, uint32_t n_caps);
+void markOutbox     (evac_fn evac, void *user, Capability *cap);
+#endif
+
+// Deliver the messages sent from cap; cap must be owned by the calling
+// Task, which must not hold any Capability's lock.
+INLINE_HEADER void
+flushOutbox (Capability *cap USED_IF_THREADS)
+{
+#if defined(THREADED_RTS)
+    if (cap->n_outbox_targets != 0) {
+        flushOutbox_(cap);
+    }
+#endif
+}
+
 INLINE_HEADER void
 doneWithMsgThrowTo (MessageThrowTo *m)
 {
@@ -704,18 +704,19 @@ removeFromQueues(Capability *cap, StgTSO *tso)
   case BlockedOnWrite:
 #if defined(mingw32_HOST_OS)
   case BlockedOnDoProc:
-#endif
       removeThreadFromDeQueue(cap, &blocked_queue_hd, &blocked_queue_tl, tso);
-#if defined(mingw32_HOST_OS)
       /* (Cooperatively) signal that the worker thread should abort
        * the request.
        */
       abandonWorkRequest(tso->block_info.async_result->reqID);
+#else
+      removeIOWaiter(cap, tso);
 #endif
       goto done;
 
   case BlockedOnDelay:
-        removeThreadFromQueue(cap, &sleeping_queue, tso);
+        // The thread's entry in the sleeping heap is left behind and
+        // discarded lazily; see Note [The sleeping heap].
         goto done;
 #endif
 
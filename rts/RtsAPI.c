@@ -17,6 +17,7 @@
 #include "Capability.h"
 #include "StablePtr.h"
 #include "Threads.h"
+#include "Messages.h"
 #include "Weak.h"
 
 /* ----------------------------------------------------------------------------
@@ -630,6 +631,7 @@ rts_unlock (Capability *cap)
     // could have boundTaskExiting()/workerTaskStop() running at some
     // random point in the future, which causes problems for
     // freeTaskManager().
+    flushOutbox(cap);
     ACQUIRE_LOCK(&cap->lock);
     releaseCapability_(cap,false);
 
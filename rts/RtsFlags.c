@@ -164,10 +164,13 @@ void initRtsFlagsDefaults(void)
     RtsFlags.GcFlags.oldGenFactor       = 2;
     RtsFlags.GcFlags.useNonmoving       = false;
     RtsFlags.GcFlags.nonmovingSelectorOpt = false;
+    RtsFlags.GcFlags.nonmovingMarkThreads = 1;
+    RtsFlags.GcFlags.nonmovingLazySweep = false;
     RtsFlags.GcFlags.generations        = 2;
     RtsFlags.GcFlags.squeezeUpdFrames   = true;
     RtsFlags.GcFlags.compact            = false;
     RtsFlags.GcFlags.compactThreshold   = 30.0;
+    RtsFlags.GcFlags.compactThreads     = 1;
     RtsFlags.GcFlags.sweep              = false;
     RtsFlags.GcFlags.idleGCDelayTime    = USToTime(300000); // 300ms
     RtsFlags.GcFlags.interIdleGCWait    = 0;
@@ -177,6 +180,8 @@ void initRtsFlagsDefaults(void)
     RtsFlags.GcFlags.doIdleGC           = false;
 #endif
     RtsFlags.GcFlags.heapBase           = 0;   /* means don't care */
+    RtsFlags.GcFlags.hugePages          = false;
+    RtsFlags.GcFlags.memoryReturnWindow = 0;   /* return memory at once */
     RtsFlags.GcFlags.allocLimitGrace    = (100*1024) / BLOCK_SIZE;
     RtsFlags.GcFlags.numa               = false;
     RtsFlags.GcFlags.numaMask           = 1;
@@ -243,7 +248,9 @@ void initRtsFlagsDefaults(void)
 #else
     RtsFlags.MiscFlags.tickInterval     = DEFAULT_TICK_INTERVAL;
 #endif
+    RtsFlags.MiscFlags.tickless         = false;
     RtsFlags.ConcFlags.ctxtSwitchTime   = USToTime(20000); // 20ms
+    RtsFlags.ConcFlags.stmGlobalClock   = false;
 
     RtsFlags.MiscFlags.install_signal_handlers = true;
     RtsFlags.MiscFlags.install_seh_handlers    = true;
@@ -265,6 +272,7 @@ void initRtsFlagsDefaults(void)
     RtsFlags.ParFlags.parGcNoSyncWithIdle   = 0;
     RtsFlags.ParFlags.parGcThreads      = 0; /* defaults to -N */
     RtsFlags.ParFlags.setAffinity       = 0;
+    RtsFlags.ParFlags.stealThreads      = false;
 #endif
 
 #if defined(THREADED_RTS)
@@ -311,7 +319,19 @@ usage_text[] = {
 "  -xb<addr> Sets the address from which a suitable start for the heap memory",
 "            will be searched from. This is useful if the default address",
 "            clashes with some third-party library.",
+"  --huge-pages",
+"            Back the heap with transparent huge pages where supported",
+"  --memory-return-window=<sec>",
+"            Return surplus heap memory to the OS gradually over <sec>",
+"            seconds instead of at the next major GC (default: 0 == off)",
 "  -xn       Use the non-moving collector for the old generation.",
+#if defined(THREADED_RTS)
+"  --nonmoving-mark-threads=<n>",
+"            Use <n> threads to mark and sweep the non-moving heap",
+"            (default: 1)",
+"  --nonmoving-lazy-sweep",
+"            Let allocation sweep non-moving heap segments on demand",
+#endif
 "  -m<n>     Minimum % of heap which must be available (default 3%)",
 "  -G<n>     Number of generations (default: 2)",
 "  -c<n>     Use in-place compaction instead of copying in the oldest generation",
@@ -319,6 +339,10 @@ usage_text[] = {
 "           -M (default: 30%)",
 "  -c       Use in-place compaction for all oldest generation collections",
 "           (the default is to use copying)",
+#if defined(THREADED_RTS)
+"  --compact-threads=<n>",
+"           Use up to <n> GC threads for in-place compaction (default: 1)",
+#endif
 "  -w       Use mark-region for the oldest generation (experimental)",
 #if defined(THREADED_RTS)
 "  -I<sec>  Perform full GC after <sec> idle time (default: 0.3, 0 == off)",
@@ -410,6 +434,9 @@ usage_text[] = {
 #else
 "            Default: 0.01 sec.",
 #endif
+"  --tickless",
+"            Stop the timer while no Haskell code is running, and",
+"            preempt each capability on its own deadline",
 "",
 #if defined(DEBUG)
 "  -Ds  DEBUG: scheduler",
@@ -447,11 +474,15 @@ usage_text[] = {
 "  -qn<n>    Use <n> threads for parallel GC (defaults to value of -N)",
 "  -qa       Use the OS to set thread affinity (experimental)",
 "  -qm       Don't automatically migrate threads between CPUs",
+"  -qs       Let idle CPUs take threads from busy ones (experimental)",
 "  -qi<n>    If a processor has been idle for the last <n> GCs, do not",
 "            wake it up for a non-load-balancing parallel GC.",
 "            (0 disables,  default: 0)",
 "  --numa[=<node_mask>]",
 "            Use NUMA, nodes given by <node_mask> (default: off)",
+"  --stm-global-clock",
+"            Validate STM transactions against a global version clock",
+"            (experimental)",
 #if defined(DEBUG)
 "  --debug-numa[=<num_nodes>]",
 "            Pretend NUMA: like --numa, but without the system calls.",
@@ -474,7 +505,7 @@ usage_text[] = {
 "            made to resolve addresses to names. (default: yes)",
 #endif
 #if defined(THREADED_RTS)
-"  -e<n>     Maximum number of outstanding local sparks (default: 4096)",
+"  -e<n>     Initial size of the local spark pool (default: 4096)",
 #endif
 #if defined(x86_64_HOST_ARCH)
 #if !DEFAULT_LINKER_ALWAYS_PIC
@@ -932,6 +963,18 @@ error = true;
                       OPTION_SAFE;
                       RtsFlags.MiscFlags.internalCounters = true;
                   }
+                  else if (strequal("tickless",
+                                    &rts_argv[arg][2])) {
+                      OPTION_SAFE;
+                      RtsFlags.MiscFlags.tickless = true;
+                  }
+                  else if (strequal("stm-global-clock",
+                                    &rts_argv[arg][2])) {
+                      OPTION_SAFE;
+                      THREADED_BUILD_ONLY(
+                          RtsFlags.ConcFlags.stmGlobalClock = true;
+                      )
+                  }
                   else if (strequal("info",
                                &rts_argv[arg][2])) {
                       OPTION_SAFE;
@@ -943,7 +986,55 @@ error = true;
                       OPTION_SAFE;
                       RtsFlags.GcFlags.useNonmoving = true;
                   }
+                  else if (strequal("nonmoving-lazy-sweep",
+                               &rts_argv[arg][2])) {
+                      OPTION_SAFE;
+                      THREADED_BUILD_ONLY(
+                          RtsFlags.GcFlags.nonmovingLazySweep = true;
+                      )
+                  }
+                  else if (strequal("huge-pages",
+                               &rts_argv[arg][2])) {
+                      OPTION_SAFE;
+                      RtsFlags.GcFlags.hugePages = true;
+                  }
+                  else if (!strncmp("memory-return-window=",
+                                    &rts_argv[arg][2], 21)) {
+                      OPTION_SAFE;
+                      double secs = atof(rts_argv[arg]+23);
+                      if (secs < 0) {
+                          bad_option(rts_argv[arg]);
+                      }
+                      RtsFlags.GcFlags.memoryReturnWindow =
+                          fsecondsToTime(secs);
+                  }
 #if defined(THREADED_RTS)
+                  else if (!strncmp("nonmoving-mark-threads=",
+                                    &rts_argv[arg][2], 23)) {
+                      OPTION_SAFE;
+                      int threads = strtol(rts_argv[arg]+25,
+                                           (char **) NULL, 10);
+                      if (threads <= 0) {
+                          errorBelch("%s: must be 1 or greater",
+                                     rts_argv[arg]);
+                          error = true;
+                      } else {
+                          RtsFlags.GcFlags.nonmovingMarkThreads = threads;
+                      }
+                  }
+                  else if (!strncmp("compact-threads=",
+                                    &rts_argv[arg][2], 16)) {
+                      OPTION_SAFE;
+                      int threads = strtol(rts_argv[arg]+18,
+                                           (char **) NULL, 10);
+                      if (threads <= 0) {
+                          errorBelch("%s: must be 1 or greater",
+                                     rts_argv[arg]);
+                          error = true;
+                      } else {
+                          RtsFlags.GcFlags.compactThreads = threads;
+                      }
+                  }
                   else if (!strncmp("numa", &rts_argv[arg][2], 4)) {
                       if (!osBuiltWithNumaSupport()) {
                           errorBelch("%s: This GHC build was compiled without NUMA support.",
@@ -1464,6 +1555,9 @@ error = true;
                     case 'm':
                         RtsFlags.ParFlags.migrate = false;
                         break;
+                    case 's':
+                        RtsFlags.ParFlags.stealThreads = true;
+                        break;
                     case 'w':
                         // -qw was removed; accepted for backwards compat
                         break;
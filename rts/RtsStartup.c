@@ -53,6 +53,7 @@
 #include <fenv.h>
 #else
 #include "posix/TTY.h"
+#include "posix/IOUring.h"
 #endif
 
 #if defined(HAVE_UNISTD_H)
@@ -396,6 +397,10 @@ hs_exit_(bool wait_foreign)
      * collection if it's running */
     exitScheduler(wait_foreign);
 
+#if defined(RTS_IO_URING)
+    exitIOUrings();
+#endif
+
     /* run C finalizers for all active weak pointers */
     for (i = 0; i < n_capabilities; i++) {
         runAllCFinalizers(capabilities[i]->weak_ptr_list_hd);
@@ -334,6 +334,9 @@
    SymI_HasProto(setIOManagerControlFd) \
    SymI_HasProto(setTimerManagerControlFd) \
    SymI_HasProto(setIOManagerWakeupFd)  \
+   SymI_HasProto(ioUringPollFd)         \
+   SymI_HasProto(ioUringTimeout)        \
+   SymI_HasProto(ioUringCancel)         \
    SymI_HasProto(ioManagerWakeup)       \
    SymI_HasProto(blockUserSignals)      \
    SymI_HasProto(unblockUserSignals)
@@ -48,4 +48,17 @@ void checkFPUStack(void);
 #define xstr(s) str(s)
 #define str(s) #s
 
+/* A cheap xorshift pseudo-random number generator, used to pick where
+ * work stealing starts looking for victims.  *state must be non-zero; it
+ * is advanced and its new value returned. */
+INLINE_HEADER uint32_t xorshift32(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
 #include "EndPrivate.h"
@@ -75,6 +75,9 @@
  * values, (d) release the locks on the TVars, writing updates to them in the
  * case of a commit, (e) unlock the STM.
  *
+ * With STM_FG_LOCKS, +RTS --stm-global-clock replaces most of (c) by a check
+ * against a global version clock: see Note [STM global version clock].
+ *
  * Queues of waiting threads hang off the first_watch_queue_entry field of each
  * TVar.  This may only be manipulated when holding that TVar's lock.  In
  * particular, when a thread is putting itself to sleep, it mustn't release the
@@ -336,6 +339,35 @@ static StgBool cond_lock_tvar(Capability *cap,
 
 /*......................................................................*/
 
+// The global version clock, for +RTS --stm-global-clock.  It needs the
+// fine-grained locks, and is only used where it can't wrap around.  See
+// Note [STM global version clock].
+
+#if defined(STM_FG_LOCKS) && SIZEOF_VOID_P == 8
+#define STM_GLOBAL_CLOCK
+
+static volatile StgWord stm_clock = 0;
+
+static StgBool use_global_clock(void) {
+  return RtsFlags.ConcFlags.stmGlobalClock;
+}
+
+// The TVar reads of the transaction must not move across reading the clock
+static StgWord read_clock(void) {
+  StgWord result;
+  load_load_barrier();
+  result = stm_clock;
+  load_load_barrier();
+  return result;
+}
+#else
+static StgWord read_clock(void) {
+  return 0;
+}
+#endif
+
+/*......................................................................*/
+
 // Helper functions for thread blocking and unblocking
 
 static void park_tso(StgTSO *tso) {
@@ -863,6 +895,209 @@ static StgBool check_read_only(StgTRecHeader *trec STG_UNUSED) {
   return result;
 }
 
+/*
+ * Note [STM global version clock]
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * Validating a transaction normally means looking at every TVar it has
+ * accessed: commits read each read-only TVar three times (in
+ * validate_and_acquire_ownership and check_read_only), and
+ * stmValidateNestOfTransactions, which the scheduler calls on every
+ * thread in a transaction at each GC, even locks them all.  For long
+ * read-mostly transactions this dominates.  With +RTS --stm-global-clock
+ * we do as TL2 does (Dice, Shalev and Shavit, "Transactional Locking II",
+ * DISC 2006):
+ *
+ *  - stm_clock is advanced by each commit that updates TVars.  Such a
+ *    commit locks the TVars it updates, then advances the clock, taking
+ *    the new value as its write version, and stores that in num_updates
+ *    of each TVar it updates before unlocking it.  So in this mode
+ *    num_updates is a version stamp: the clock value of the last commit
+ *    that wrote the TVar.  It still changes at each update, so
+ *    check_read_only, which nested commits use, works as before.
+ *
+ *  - A transaction notes the clock when it starts, in the read_version of
+ *    its TRec; nested transactions take their parent's.
+ *
+ *  - A TVar only changes after its writer has locked it and then advanced
+ *    the clock, and reading a locked TVar waits until it is unlocked
+ *    (read_current_value).  So if the clock still reads read_version,
+ *    nothing that the transaction has read has changed since it started,
+ *    and it is valid without looking at its entries.  (A commit that
+ *    advanced the clock before we started may still be writing back, but
+ *    we can only see its writes, never the values it is replacing.)
+ *
+ *  - Otherwise the transaction is valid if every TVar it accessed is
+ *    unlocked, still holds the expected value, and was last written no
+ *    later than read_version: check_read_versions, which reads each TVar
+ *    once and takes no locks.  The transaction then saw the state as it
+ *    was at read_version.
+ *
+ *  - So a read-only transaction commits without taking any locks or
+ *    touching the clock.  A commit that updates TVars locks just those,
+ *    advances the clock, and only has to check the other TVars if some
+ *    other commit advanced the clock since read_version.
+ *
+ * stmWait and stmReWait still lock all the TVars, because they must hold
+ * the locks while they put the thread on the TVars' watch queues, and so
+ * do nested commits.  Neither affects the outcome of the clock checks.
+ *
+ * A version number that wrapped around could make a stale transaction
+ * look valid, so the clock is only used on 64-bit platforms; elsewhere
+ * the flag has no effect.
+ */
+
+#if defined(STM_GLOBAL_CLOCK)
+
+// check_read_versions : check that the TVars accessed by trec, other than
+// those it has locked, are unlocked, hold the expected values and were
+// last written no later than read_version.
+
+static StgBool check_read_versions(StgTRecHeader *trec,
+                                   StgWord read_version) {
+  StgBool result = true;
+
+  FOR_EACH_ENTRY(trec, e, {
+    StgTVar *s;
+    StgClosure *v;
+    s = e -> tvar;
+    v = s -> current_value;
+    if (v != (StgClosure *) trec) {
+      // A writer stores the version before unlocking the TVar, so read
+      // them the other way round
+      load_load_barrier();
+      if (v != e -> expected_value ||
+          (StgWord) s -> num_updates > read_version) {
+        TRACE("%p : %p changed since version %" FMT_Word,
+              trec, s, read_version);
+        result = false;
+        BREAK_FOR_EACH;
+      }
+    }
+  });
+
+  return result;
+}
+
+// validate_nest_by_clock : stmValidateNestOfTransactions with the clock.
+
+static StgBool validate_nest_by_clock(StgTRecHeader *trec) {
+  StgTRecHeader *t;
+
+  if (shake()) {
+    TRACE("%p : shake, pretending trec is invalid when it may not be", trec);
+    return false;
+  }
+
+  for (t = trec; t != NO_TREC; t = t -> enclosing_trec) {
+    if (t -> state == TREC_CONDEMNED) {
+      return false;
+    }
+  }
+
+  if (read_clock() == trec -> read_version) {
+    return true;
+  }
+
+  for (t = trec; t != NO_TREC; t = t -> enclosing_trec) {
+    ASSERT(t -> read_version == trec -> read_version);
+    if (!check_read_versions(t, trec -> read_version)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// acquire_updates : lock the TVars that trec updates, if they hold the
+// expected values, and say whether there are any.
+
+static StgBool acquire_updates(Capability *cap, StgTRecHeader *trec,
+                               StgBool *updates) {
+  StgBool result = true;
+
+  *updates = false;
+  FOR_EACH_ENTRY(trec, e, {
+    if (entry_is_update(e)) {
+      *updates = true;
+      TRACE("%p : trying to acquire %p", trec, e -> tvar);
+      if (!cond_lock_tvar(cap, trec, e -> tvar, e -> expected_value)) {
+        TRACE("%p : failed to acquire %p", trec, e -> tvar);
+        result = false;
+        BREAK_FOR_EACH;
+      }
+    }
+  });
+
+  return result;
+}
+
+// write_updates : write back the updates of trec, stamped with
+// write_version, and unlock the TVars.
+
+static void write_updates(Capability *cap, StgTRecHeader *trec,
+                          StgWord write_version) {
+  FOR_EACH_ENTRY(trec, e, {
+    if (entry_is_update(e)) {
+      StgTVar *s;
+      s = e -> tvar;
+      ACQ_ASSERT(tvar_is_locked(s, trec));
+      TRACE("%p : writing %p to %p, waking waiters", trec, e -> new_value, s);
+      unpark_waiters_on(cap,s);
+      s -> num_updates = write_version;
+      write_barrier();
+      unlock_tvar(cap, trec, s, e -> new_value, true);
+    }
+    ACQ_ASSERT(!tvar_is_locked(e -> tvar, trec));
+  });
+}
+
+// commit_by_clock : stmCommitTransaction with the clock.
+
+static StgBool commit_by_clock(Capability *cap, StgTRecHeader *trec) {
+  StgBool result;
+  StgBool updates = false;
+  StgWord write_version;
+
+  result = (trec -> state != TREC_CONDEMNED);
+  if (shake()) {
+    TRACE("%p : shake, pretending trec is invalid when it may not be", trec);
+    result = false;
+  }
+
+  if (result) {
+    result = acquire_updates(cap, trec, &updates);
+  }
+
+  if (result && !updates) {
+    // Read-only: nothing to lock or write
+    result = (read_clock() == trec -> read_version) ||
+             check_read_versions(trec, trec -> read_version);
+    TRACE("%p : read-only commit at version %" FMT_Word " %s",
+          trec, trec -> read_version, result ? "succeeded" : "failed");
+  } else if (result) {
+    write_version = atomic_inc(&stm_clock, 1);
+    result = (write_version == trec -> read_version + 1) ||
+             check_read_versions(trec, trec -> read_version);
+    TRACE("%p : commit at version %" FMT_Word " %s",
+          trec, write_version, result ? "succeeded" : "failed");
+
+    if (result) {
+      write_updates(cap, trec, write_version);
+    }
+  }
+
+  if (!result) {
+    revert_ownership(cap, trec, false);
+  }
+
+  free_stg_trec_header(cap, trec);
+
+  TRACE("%p : stmCommitTransaction()=%d", trec, result);
+
+  return result;
+}
+
+#endif
+
 
 /************************************************************************/
 
@@ -924,6 +1159,8 @@ StgTRecHeader *stmStartTransaction(Capability *cap,
   getToken(cap);
 
   t = alloc_stg_trec_header(cap, outer);
+  t -> read_version = (outer == NO_TREC) ? read_clock()
+                                         : outer -> read_version;
   TRACE("%p : stmStartTransaction()=%p", outer, t);
   return t;
 }
@@ -1016,6 +1253,17 @@ StgBool stmValidateNestOfTransactions(Capability *cap, StgTRecHeader *trec) {
          (trec -> state == TREC_WAITING) ||
          (trec -> state == TREC_CONDEMNED));
 
+#if defined(STM_GLOBAL_CLOCK)
+  if (use_global_clock()) {
+    StgBool result = validate_nest_by_clock(trec);
+    if (!result && trec -> state != TREC_WAITING) {
+      trec -> state = TREC_CONDEMNED;
+    }
+    TRACE("%p : stmValidateNestOfTransactions()=%d", trec, result);
+    return result;
+  }
+#endif
+
   lock_stm(trec);
 
   t = trec;
@@ -1073,6 +1321,13 @@ StgBool stmCommitTransaction(Capability *cap, StgTRecHeader *trec) {
   ASSERT((trec -> state == TREC_ACTIVE) ||
          (trec -> state == TREC_CONDEMNED));
 
+#if defined(STM_GLOBAL_CLOCK)
+  if (use_global_clock()) {
+    unlock_stm(trec);
+    return commit_by_clock(cap, trec);
+  }
+#endif
+
   // Use a read-phase (i.e. don't lock TVars we've read but not updated) if
   // the configuration lets us use a read phase.
 
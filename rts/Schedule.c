@@ -34,6 +34,8 @@
 #include "AwaitEvent.h"
 #if defined(mingw32_HOST_OS)
 #include "win32/IOManager.h"
+#else
+#include "posix/IOUring.h"
 #endif
 #include "Trace.h"
 #include "RaiseAsync.h"
@@ -73,7 +75,6 @@
 // Blocked/sleeping threads
 StgTSO *blocked_queue_hd = NULL;
 StgTSO *blocked_queue_tl = NULL;
-StgTSO *sleeping_queue = NULL;    // perhaps replace with a hash table?
 #endif
 
 // Bytes allocated since the last time a HeapOverflow exception was thrown by
@@ -153,6 +154,8 @@ static void scheduleCheckBlockedThreads (Capability *cap);
 static void scheduleProcessInbox(Capability **cap);
 static void scheduleDetectDeadlock (Capability **pcap, Task *task);
 static void schedulePushWork(Capability *cap, Task *task);
+static void scheduleStealThreads(Capability *cap);
+static void scheduleServeStealRequest(Capability *cap, Task *task);
 #if defined(THREADED_RTS)
 static void scheduleActivateSpark(Capability *cap);
 #endif
@@ -280,6 +283,7 @@ schedule (Capability *initialCapability, Task *task)
         // then we will exit below when we've removed our TSO from
         // the run queue.
         if (!isBoundTask(task) && emptyRunQueue(cap)) {
+            flushOutbox(cap);
             return cap;
         }
         break;
@@ -289,6 +293,9 @@ schedule (Capability *initialCapability, Task *task)
 
     scheduleFindWork(&cap);
 
+    // hand threads to an idle capability that asked for them
+    scheduleServeStealRequest(cap,task);
+
     /* work pushing, currently relevant only for THREADED_RTS:
        (pushes threads, wakes up idle capabilities for stealing) */
     schedulePushWork(cap,task);
@@ -397,6 +404,10 @@ schedule (Capability *initialCapability, Task *task)
 
 run_thread:
 
+    // deliver the messages sent since we last ran Haskell code; see
+    // Note [Batched messages] in Messages.c
+    flushOutbox(cap);
+
     // CurrentTSO is the thread to run. It might be different if we
     // loop back to run_thread, so make sure to set CurrentTSO after
     // that.
@@ -451,6 +462,10 @@ run_thread:
         recent_activity = ACTIVITY_YES;
     }
 
+    if (RtsFlags.MiscFlags.tickless) {
+        armPreemptionTimer(cap);
+    }
+
     traceEventRunThread(cap, t);
 
     switch (prev_what_next) {
@@ -553,7 +568,10 @@ run_thread:
         break;
 
     case ThreadFinished:
-        if (scheduleHandleThreadFinished(cap, task, t)) return cap;
+        if (scheduleHandleThreadFinished(cap, task, t)) {
+            flushOutbox(cap);
+            return cap;
+        }
         ASSERT_FULL_CAPABILITY_INVARIANTS(cap,task);
         break;
 
@@ -626,10 +644,15 @@ scheduleFindWork (Capability **pcap)
 
     scheduleProcessInbox(pcap);
 
+#if defined(RTS_IO_URING)
+    processIOUringCompletions(*pcap);
+#endif
+
     scheduleCheckBlockedThreads(*pcap);
 
 #if defined(THREADED_RTS)
     if (emptyRunQueue(*pcap)) { scheduleActivateSpark(*pcap); }
+    if (emptyRunQueue(*pcap)) { scheduleStealThreads(*pcap); }
 #endif
 }
 
@@ -717,7 +740,7 @@ schedulePushWork(Capability *cap USED_IF_THREADS,
 #if defined(THREADED_RTS)
 
     Capability *free_caps[n_capabilities], *cap0;
-    uint32_t i, n_wanted_caps, n_free_caps;
+    uint32_t i, pass, n_wanted_caps, n_free_caps;
 
     uint32_t spare_threads = cap->n_run_queue > 0 ? cap->n_run_queue - 1 : 0;
 
@@ -731,21 +754,28 @@ schedulePushWork(Capability *cap USED_IF_THREADS,
     n_wanted_caps = sparkPoolSizeCap(cap) + spare_threads;
     if (n_wanted_caps == 0) return;
 
-    // First grab as many free Capabilities as we can.  ToDo: we should use
-    // capabilities on the same NUMA node preferably, but not exclusively.
-    for (i = (cap->no + 1) % n_capabilities, n_free_caps=0;
-         n_free_caps < n_wanted_caps && i != cap->no;
-         i = (i + 1) % n_capabilities) {
-        cap0 = capabilities[i];
-        if (cap != cap0 && !cap0->disabled && tryGrabCapability(cap0,task)) {
-            if (!emptyRunQueue(cap0)
-                || cap0->n_returning_tasks != 0
-                || !emptyInbox(cap0)) {
-                // it already has some work, we just grabbed it at
-                // the wrong moment.  Or maybe it's deadlocked!
-                releaseCapability(cap0);
-            } else {
-                free_caps[n_free_caps++] = cap0;
+    // First grab as many free Capabilities as we can, preferring those
+    // on our own NUMA node: threads we push elsewhere, and the sparks
+    // that the woken capabilities will steal, mostly refer to data in
+    // our nursery.  The second pass takes free capabilities on other
+    // nodes, so we use them too, just not first.
+    n_free_caps = 0;
+    for (pass = 0; pass < numaPasses(); pass++) {
+        for (i = (cap->no + 1) % n_capabilities;
+             n_free_caps < n_wanted_caps && i != cap->no;
+             i = (i + 1) % n_capabilities) {
+            cap0 = capabilities[i];
+            if (!numaPassIncludes(pass, cap->node, cap0->node)) continue;
+            if (cap != cap0 && !cap0->disabled && tryGrabCapability(cap0,task)) {
+                if (!emptyRunQueue(cap0)
+                    || cap0->n_returning_tasks != 0
+                    || !emptyInbox(cap0)) {
+                    // it already has some work, we just grabbed it at
+                    // the wrong moment.  Or maybe it's deadlocked!
+                    releaseCapability(cap0);
+                } else {
+                    free_caps[n_free_caps++] = cap0;
+                }
             }
         }
     }
@@ -820,6 +850,7 @@ schedulePushWork(Capability *cap USED_IF_THREADS,
             else {
                 appendToRunQueue(free_caps[i],t);
                 traceEventMigrateThread (cap, t, free_caps[i]->no);
+                countMigration(cap, free_caps[i]);
 
                 if (t->bound) { t->bound->task->cap = free_caps[i]; }
                 t->cap = free_caps[i];
@@ -863,6 +894,147 @@ schedulePushWork(Capability *cap USED_IF_THREADS,
 
 }
 
+/* ----------------------------------------------------------------------------
+ * Pull-based thread stealing
+ *
+ * Note [Pull-based thread stealing]
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * schedulePushWork() only runs when the busy capability comes back to
+ * the scheduler, which may be a whole time slice after a burst of
+ * forkIOs filled its run queue, and meanwhile the other capabilities
+ * sit idle.  With +RTS -qs an idle capability goes looking for threads
+ * itself.
+ *
+ * A capability's run queue belongs to the Task that owns it, and the
+ * Haskell thread running there adds to it without taking any lock, so
+ * a thief cannot unlink threads from it directly.  Instead:
+ *
+ *  - The thief (scheduleStealThreads(), called when it has found no
+ *    threads and no sparks) picks a victim with a non-empty run queue,
+ *    starting at a random capability and preferring its own NUMA
+ *    node, and installs itself in the
+ *    victim's steal_request with a cas.  It then interrupts the victim
+ *    and goes to sleep as usual in scheduleYield(), releasing its
+ *    capability.
+ *
+ *  - The interrupted victim comes back to its scheduler loop, where
+ *    scheduleServeStealRequest() grabs the thief's capability and moves
+ *    half of its run queue there, taking the newest threads first: they
+ *    have had the least time to build up a working set on this CPU.
+ *    Bound threads and threads with TSO_LOCKED stay where they are.
+ *    Each move posts a migration event to the eventlog.
+ *
+ * If the victim gets to the request before the thief has released its
+ * capability, it leaves the request in place and tries again the next
+ * time round its scheduler loop.  Stealing is a form of migration, so
+ * it is disabled by -qm.
+ * ------------------------------------------------------------------------- */
+
+static void
+scheduleStealThreads (Capability *cap USED_IF_THREADS)
+{
+#if defined(THREADED_RTS)
+    Capability *victim;
+    uint32_t i, start, pass;
+
+    if (!RtsFlags.ParFlags.stealThreads || !RtsFlags.ParFlags.migrate
+        || n_capabilities == 1 || cap->disabled) {
+        return;
+    }
+
+    // look on our own NUMA node first, as schedulePushWork() does
+    start = randomStealStart(cap);
+    for (pass = 0; pass < numaPasses(); pass++) {
+        for (i = 0; i < n_capabilities; i++) {
+            victim = capabilities[(start + i) % n_capabilities];
+            if (victim == cap || victim->disabled) continue;
+            if (!numaPassIncludes(pass, cap->node, victim->node)) continue;
+
+            // the victim's own thread is not on its run queue, so any
+            // thread there is one it could spare
+            if (victim->n_run_queue == 0) continue;
+
+            if (cas((StgVolatilePtr)&victim->steal_request,
+                    (StgWord)NULL, (StgWord)cap) == (StgWord)NULL) {
+                debugTrace(DEBUG_sched, "cap %d: asking cap %d for threads",
+                           cap->no, victim->no);
+                interruptCapability(victim);
+                return;
+            }
+        }
+    }
+#endif
+}
+
+static void
+scheduleServeStealRequest (Capability *cap USED_IF_THREADS,
+                           Task *task      USED_IF_THREADS)
+{
+#if defined(THREADED_RTS)
+    Capability *thief;
+    StgTSO *t, *prev;
+    uint32_t n_wanted, n_moved;
+
+    thief = cap->steal_request;
+    if (thief == NULL) return;
+    // no thief can install itself until we clear the request
+    cap->steal_request = NULL;
+
+    if (!RtsFlags.ParFlags.migrate || thief->disabled) return;
+
+    n_wanted = cap->n_run_queue / 2;
+    if (n_wanted == 0) return;
+
+    if (!tryGrabCapability(thief, task)) {
+        // the thief hasn't gone to sleep yet; if no other thief has
+        // asked in the meantime, try again next time round
+        if (emptyRunQueue(thief)) {
+            cas((StgVolatilePtr)&cap->steal_request,
+                (StgWord)NULL, (StgWord)thief);
+        }
+        task->cap = cap;
+        return;
+    }
+
+    if (!emptyRunQueue(thief)
+        || thief->n_returning_tasks != 0
+        || !emptyInbox(thief)) {
+        // it found some work of its own
+        releaseCapability(thief);
+        task->cap = cap;
+        return;
+    }
+
+    // Walk backwards from the newest thread, pushing each one we move
+    // onto the front of the thief's run queue so that they keep their
+    // order.
+    n_moved = 0;
+    for (t = cap->run_queue_tl; t != END_TSO_QUEUE && n_moved < n_wanted;
+         t = prev) {
+        prev = t->block_info.prev;
+
+        if (t->bound != NULL || tsoLocked(t)) continue;
+
+        removeFromRunQueue(cap, t);
+        pushOnRunQueue(thief, t);
+        traceEventMigrateThread(cap, t, thief->no);
+        countMigration(cap, thief);
+        t->cap = thief;
+        n_moved++;
+    }
+
+    debugTrace(DEBUG_sched, "cap %d: gave %d threads to cap %d",
+               cap->no, n_moved, thief->no);
+
+    IF_DEBUG(sanity, checkRunQueue(cap));
+
+    // releasing the thief with threads on its run queue wakes up a
+    // worker to run them
+    releaseCapability(thief);
+    task->cap = cap;
+#endif
+}
+
 /* ----------------------------------------------------------------------------
  * Start any pending signal handlers
  * ------------------------------------------------------------------------- */
@@ -896,7 +1068,7 @@ scheduleCheckBlockedThreads(Capability *cap USED_IF_NOT_THREADS)
     // run queue is empty, and there are no other tasks running, we
     // can wait indefinitely for something to happen.
     //
-    if ( !emptyQueue(blocked_queue_hd) || !emptyQueue(sleeping_queue) )
+    if ( !EMPTY_BLOCKED_QUEUE() || !EMPTY_SLEEPING_QUEUE() )
     {
         awaitEvent (emptyRunQueue(cap));
     }
@@ -1122,7 +1294,17 @@ schedulePostRunThread (Capability *cap, StgTSO *t)
 static bool
 scheduleHandleHeapOverflow( Capability *cap, StgTSO *t )
 {
-    if (cap->r.rHpLim == NULL || cap->context_switch) {
+    bool interrupted = cap->r.rHpLim == NULL;
+
+#if defined(THREADED_RTS)
+    // An interrupt that was only for flushing the outbox doesn't count:
+    // see Note [Batched messages] in Messages.c.
+    if (cap->outbox_interrupt) {
+        interrupted = false;
+    }
+#endif
+
+    if (interrupted || cap->context_switch) {
         // Sometimes we miss a context switch, e.g. when calling
         // primitives in a tight loop, MAYBE_GC() doesn't check the
         // context switch flag, and we end up waiting for a GC.
@@ -1156,7 +1338,7 @@ scheduleHandleHeapOverflow( Capability *cap, StgTSO *t )
                                                // nursery has only one
                                                // block.
 
-            bd = allocGroupOnNode_lock(cap->node,blocks);
+            bd = allocGroupCached(&cap->block_cache,blocks);
             cap->r.rNursery->n_blocks += blocks;
 
             // link the new group after CurrentNursery
@@ -1861,6 +2043,7 @@ delete_threads_and_gc:
     }
 
     traceSparkCounters(cap);
+    traceMessageCounters(cap);
 
     switch (recent_activity) {
     case ACTIVITY_INACTIVE:
@@ -2071,6 +2254,15 @@ forkProcess(HsStablePtr *entry
         // the stats too. See #16102.
         resetChildProcessStats();
 
+#if !defined(THREADED_RTS)
+        // The child shares the parent's epoll instance, if any; drop it
+        // before deleting the threads blocked on I/O below.
+        resetIOWaitersAfterFork();
+#endif
+#if defined(RTS_IO_URING)
+        resetIOUringsAfterFork();
+#endif
+
 #if defined(THREADED_RTS)
         initMutex(&sched_mutex);
         initMutex(&sm_mutex);
@@ -2347,8 +2539,13 @@ deleteAllThreads ()
     // being GC'd, and we don't want the "main thread has been GC'd" panic.
 
 #if !defined(THREADED_RTS)
-    ASSERT(blocked_queue_hd == END_TSO_QUEUE);
-    ASSERT(sleeping_queue == END_TSO_QUEUE);
+    ASSERT(EMPTY_BLOCKED_QUEUE());
+#if !defined(mingw32_HOST_OS)
+    // The sleeping heap may still hold entries for the threads we just
+    // deleted; see Note [The sleeping heap].
+    pruneSleepingThreads();
+    ASSERT(EMPTY_SLEEPING_QUEUE());
+#endif
 #endif
 }
 
@@ -2454,6 +2651,8 @@ suspendThread (StgRegTable *reg, bool interruptible)
   // Otherwise allocate() will write to invalid memory.
   cap->r.rCurrentTSO = NULL;
 
+  flushOutbox(cap);
+
   ACQUIRE_LOCK(&cap->lock);
 
   suspendTask(cap,task);
@@ -2522,6 +2721,9 @@ resumeThread (void *task_)
 
     cap->r.rCurrentTSO = tso;
     cap->in_haskell = true;
+    if (RtsFlags.MiscFlags.tickless) {
+        armPreemptionTimer(cap);
+    }
     errno = saved_errno;
 #if defined(mingw32_HOST_OS)
     SetLastError(saved_winerror);
@@ -2670,7 +2872,6 @@ initScheduler(void)
 #if !defined(THREADED_RTS)
   blocked_queue_hd  = END_TSO_QUEUE;
   blocked_queue_tl  = END_TSO_QUEUE;
-  sleeping_queue    = END_TSO_QUEUE;
 #endif
 
   sched_state    = SCHED_RUNNING;
@@ -2754,6 +2955,10 @@ freeScheduler( void )
 #if defined(THREADED_RTS)
     closeMutex(&sched_mutex);
 #endif
+#if !defined(THREADED_RTS) && !defined(mingw32_HOST_OS)
+    freeSleepingThreads();
+    freeIOWaiters();
+#endif
 }
 
 void markScheduler (evac_fn evac USED_IF_NOT_THREADS,
@@ -2762,7 +2967,10 @@ void markScheduler (evac_fn evac USED_IF_NOT_THREADS,
 #if !defined(THREADED_RTS)
     evac(user, (StgClosure **)(void *)&blocked_queue_hd);
     evac(user, (StgClosure **)(void *)&blocked_queue_tl);
-    evac(user, (StgClosure **)(void *)&sleeping_queue);
+#if !defined(mingw32_HOST_OS)
+    markSleepingThreads(evac, user);
+    markIOWaiters(evac, user);
+#endif
 #endif
 }
 
@@ -106,7 +106,33 @@ extern volatile StgWord recent_activity;
  */
 #if !defined(THREADED_RTS)
 extern  StgTSO *blocked_queue_hd, *blocked_queue_tl;
-extern  StgTSO *sleeping_queue;
+#endif
+
+/* Threads blocked in threadDelay#, kept in a heap in posix/Select.c.
+ * See Note [The sleeping heap].
+ * Locks required  : sched_mutex
+ */
+#if !defined(THREADED_RTS) && !defined(mingw32_HOST_OS)
+void insertSleepingThread (StgTSO *tso);
+bool anySleepingThreads   (void);
+void pruneSleepingThreads (void);
+void markSleepingThreads  (evac_fn evac, void *user);
+void freeSleepingThreads  (void);
+#endif
+
+/* Threads blocked in waitRead#/waitWrite#, in posix/Select.c.  Where
+ * epoll is available these are kept in a table indexed by file
+ * descriptor; see Note [Waiting for I/O with epoll].  Otherwise they
+ * live on blocked_queue.
+ * Locks required  : sched_mutex
+ */
+#if !defined(THREADED_RTS) && !defined(mingw32_HOST_OS)
+void insertIOWaiter          (StgTSO *tso);
+void removeIOWaiter          (Capability *cap, StgTSO *tso);
+bool anyIOWaiters            (void);
+void markIOWaiters           (evac_fn evac, void *user);
+void resetIOWaitersAfterFork (void);
+void freeIOWaiters           (void);
 #endif
 
 extern bool heap_overflow;
@@ -238,8 +264,13 @@ truncateRunQueue(Capability *cap)
 }
 
 #if !defined(THREADED_RTS)
+#if defined(mingw32_HOST_OS)
 #define EMPTY_BLOCKED_QUEUE()  (emptyQueue(blocked_queue_hd))
-#define EMPTY_SLEEPING_QUEUE() (emptyQueue(sleeping_queue))
+#define EMPTY_SLEEPING_QUEUE() (true)
+#else
+#define EMPTY_BLOCKED_QUEUE()  (!anyIOWaiters())
+#define EMPTY_SLEEPING_QUEUE() (!anySleepingThreads())
+#endif
 #endif
 
 INLINE_HEADER bool
@@ -23,7 +23,8 @@
 SparkPool *
 allocSparkPool( void )
 {
-    return newWSDeque(RtsFlags.ParFlags.maxLocalSparks);
+    // The pool starts with room for -e sparks and grows on demand.
+    return newWSDeque(RtsFlags.ParFlags.maxLocalSparks, 0);
 }
 
 void
@@ -90,6 +91,7 @@ void
 pruneSparkQueue (bool nonmovingMarkFinished, Capability *cap)
 {
     SparkPool *pool;
+    WSDequeArray *array;
     StgClosurePtr spark, tmp, *elements;
     uint32_t n, pruned_sparks; // stats only
     StgWord botInd,oldBotInd,currInd; // indices in array (always < size)
@@ -100,6 +102,11 @@ pruneSparkQueue (bool nonmovingMarkFinished, Capability *cap)
 
     pool = cap->sparks;
 
+    // Nobody is stealing sparks now, so we can release any arrays left
+    // behind by resizing the pool. See Note [Growable WSDeque].
+    freeWSDequeRetired(pool);
+    array = pool->array;
+
     // it is possible that top > bottom, indicating an empty pool.  We
     // fix that here; this is only necessary because the loop below
     // assumes it.
@@ -109,8 +116,8 @@ pruneSparkQueue (bool nonmovingMarkFinished, Capability *cap)
     // Take this opportunity to reset top/bottom modulo the size of
     // the array, to avoid overflow.  This is only possible because no
     // stealing is happening during GC.
-    pool->bottom  -= pool->top & ~pool->moduloSize;
-    pool->top     &= pool->moduloSize;
+    pool->bottom  -= pool->top & ~array->moduloSize;
+    pool->top     &= array->moduloSize;
     pool->topBound = pool->top;
 
     debugTrace(DEBUG_sparks,
@@ -119,7 +126,7 @@ pruneSparkQueue (bool nonmovingMarkFinished, Capability *cap)
 
     ASSERT_WSDEQUE_INVARIANTS(pool);
 
-    elements = (StgClosurePtr *)pool->elements;
+    elements = (StgClosurePtr *)array->elements;
 
     /* We have exclusive access to the structure here, so we can reset
        bottom and top counters, and prune invalid sparks. Contents are
@@ -150,14 +157,14 @@ pruneSparkQueue (bool nonmovingMarkFinished, Capability *cap)
        size range.
     */
     // starting here
-    currInd = (pool->top) & (pool->moduloSize); // mod
+    currInd = (pool->top) & (array->moduloSize); // mod
 
     // copies of evacuated closures go to space from botInd on
     // we keep oldBotInd to know when to stop
-    oldBotInd = botInd = (pool->bottom) & (pool->moduloSize); // mod
+    oldBotInd = botInd = (pool->bottom) & (array->moduloSize); // mod
 
     // on entry to loop, we are within the bounds
-    ASSERT( currInd < pool->size && botInd  < pool->size );
+    ASSERT( currInd < array->size && botInd  < array->size );
 
     while (currInd != oldBotInd ) {
       /* must use != here, wrap-around at size
@@ -250,9 +257,9 @@ pruneSparkQueue (bool nonmovingMarkFinished, Capability *cap)
       currInd++;
 
       // in the loop, we may reach the bounds, and instantly wrap around
-      ASSERT( currInd <= pool->size && botInd <= pool->size );
-      if ( currInd == pool->size ) { currInd = 0; }
-      if ( botInd == pool->size )  { botInd = 0;  }
+      ASSERT( currInd <= array->size && botInd <= array->size );
+      if ( currInd == array->size ) { currInd = 0; }
+      if ( botInd == array->size )  { botInd = 0;  }
 
     } // while-loop over spark pool elements
 
@@ -261,7 +268,7 @@ pruneSparkQueue (bool nonmovingMarkFinished, Capability *cap)
     pool->top = oldBotInd; // where we started writing
     pool->topBound = pool->top;
 
-    pool->bottom = (oldBotInd <= botInd) ? botInd : (botInd + pool->size);
+    pool->bottom = (oldBotInd <= botInd) ? botInd : (botInd + array->size);
     // first free place we did not use (corrected by wraparound)
 
     debugTrace(DEBUG_sparks, "pruned %d sparks", pruned_sparks);
@@ -288,8 +295,8 @@ traverseSparkQueue (evac_fn evac, void *user, Capability *cap)
 
     top = pool->top;
     bottom = pool->bottom;
-    sparkp = (StgClosurePtr*)pool->elements;
-    modMask = pool->moduloSize;
+    sparkp = (StgClosurePtr*)pool->array->elements;
+    modMask = pool->array->moduloSize;
 
     while (top < bottom) {
     /* call evac for all closures in range (wrap-around via modulo)
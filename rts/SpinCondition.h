@@ -0,0 +1,57 @@
+/* -----------------------------------------------------------------------------
+ *
+ * (c) The GHC Team, 2020
+ *
+ * Condition variables that spin for a while before sleeping, used by the
+ * RTS for handing Capabilities to Tasks.  This is RTS-internal: the public
+ * Condition type in rts/OSThreads.h is unchanged.
+ *
+ * ---------------------------------------------------------------------------*/
+
+#pragma once
+
+#include "BeginPrivate.h"
+
+#if defined(THREADED_RTS)
+
+#if defined(linux_HOST_OS)
+
+// Built directly on a futex, see Note [Futex condition variables] in
+// posix/OSThreads.c.
+typedef struct {
+    volatile uint32_t seq;        // bumped by every signal
+    volatile uint32_t parked;     // waiters sleeping in the kernel
+    volatile uint32_t spin_limit; // spin budget, adapted as we go
+} SpinCondition;
+
+void initSpinCondition     ( SpinCondition* pCond );
+void closeSpinCondition    ( SpinCondition* pCond );
+bool signalSpinCondition   ( SpinCondition* pCond );
+bool waitSpinCondition     ( SpinCondition* pCond, Mutex* pMut );
+
+// How many waits were ended by a signal while the waiter was still
+// spinning, and how many had to sleep in the kernel.
+void getSpinConditionStats ( StgWord64 *spun, StgWord64 *parked );
+
+#else
+
+// Elsewhere a SpinCondition is an ordinary Condition, which never spins.
+typedef Condition SpinCondition;
+
+#define initSpinCondition(c)     initCondition(c)
+#define closeSpinCondition(c)    closeCondition(c)
+#define signalSpinCondition(c)   signalCondition(c)
+#define waitSpinCondition(c,m)   waitCondition(c,m)
+
+INLINE_HEADER void
+getSpinConditionStats ( StgWord64 *spun, StgWord64 *parked )
+{
+    *spun = 0;
+    *parked = 0;
+}
+
+#endif /* linux_HOST_OS */
+
+#endif /* THREADED_RTS */
+
+#include "EndPrivate.h"
@@ -16,6 +16,9 @@
 #include "RtsUtils.h"
 #include "Trace.h"
 #include "StableName.h"
+#include "sm/Storage.h"
+#include "sm/HeapAlloc.h"
+#include "sm/CNF.h"
 
 #include <string.h>
 
@@ -38,6 +41,52 @@ static void enlargeStableNameTable(void);
 
 static HashTable *addrToStableHash = NULL;
 
+/* Note [Generational stable names]
+ *
+ * Programs that use StableNames for memoisation can have hundreds of
+ * thousands of them, most of them for long-lived objects, and walking
+ * the whole table at every GC made minor GCs slow.  So, as with stable
+ * pointers (Note [Generational stable pointers] in StablePtr.c), each
+ * in-use entry is filed under a generation, in sn_gens[g], and
+ * sn_info[sn] records where, so it can be unfiled in constant time.
+ *
+ * The invariant is that an entry is filed under a generation no older
+ * than that of its StableName object or of its pointee.  Neither can
+ * die or move unless that generation is collected, so the GC only has
+ * to look at the entries filed under the generations 0..N it collects:
+ * gcStableNameTable() frees the dead ones, and updateStableNameTable()
+ * rehashes the ones whose pointee moved or died and refiles each under
+ * the younger of the generations its two objects are now in.  A new
+ * entry is filed under generation 0.
+ *
+ * The address index addrToStableHash is updated in place, even after a
+ * major GC, rather than rebuilt.  To make that possible, the old field
+ * of an entry always holds the address the entry is hashed under (or
+ * NULL if it is not in the hash table).
+ *
+ * All of this is protected by stable_name_mutex.
+ *
+ * As for stable pointers, stable_name_minor_gc_visits counts the entries
+ * that minor GCs visit, for +RTS -t --machine-readable.
+ */
+
+W_ stable_name_minor_gc_visits = 0;
+
+typedef struct {
+    uint32_t *entries;      // indices into stable_name_table
+    uint32_t n_entries;
+    uint32_t size;          // allocated size of entries[]
+} snGenList;
+
+typedef struct {
+    uint32_t gen;           // generation this entry is filed under
+    uint32_t pos;           // index in sn_gens[gen].entries
+} snInfo;
+
+static snGenList *sn_gens = NULL;
+static uint32_t n_sn_gens = 0;
+static snInfo *sn_info = NULL;
+
 void
 stableNameLock(void)
 {
@@ -71,6 +120,8 @@ initSnEntryFreeList(snEntry *table, uint32_t n, snEntry *free)
 void
 initStableNameTable(void)
 {
+    uint32_t g;
+
     if (SNT_size > 0) return;
     SNT_size = INIT_SNT_SIZE;
     stable_name_table = stgMallocBytes(SNT_size * sizeof(snEntry),
@@ -82,6 +133,16 @@ initStableNameTable(void)
     initSnEntryFreeList(stable_name_table + 1,INIT_SNT_SIZE-1,NULL);
     addrToStableHash = allocHashTable();
 
+    sn_info = stgMallocBytes(SNT_size * sizeof(snInfo), "initStableNameTable");
+    n_sn_gens = RtsFlags.GcFlags.generations;
+    sn_gens = stgMallocBytes(n_sn_gens * sizeof(snGenList),
+                             "initStableNameTable");
+    for (g = 0; g < n_sn_gens; g++) {
+        sn_gens[g].entries = NULL;
+        sn_gens[g].n_entries = 0;
+        sn_gens[g].size = 0;
+    }
+
 #if defined(THREADED_RTS)
     initMutex(&stable_name_mutex);
 #endif
@@ -104,6 +165,62 @@ enlargeStableNameTable(void)
                         "enlargeStableNameTable");
 
     initSnEntryFreeList(stable_name_table + old_SNT_size, old_SNT_size, NULL);
+
+    sn_info = stgReallocBytes(sn_info, SNT_size * sizeof(snInfo),
+                              "enlargeStableNameTable");
+}
+
+/* -----------------------------------------------------------------------------
+ * The per-generation lists; see Note [Generational stable names]
+ * -------------------------------------------------------------------------- */
+
+// Must be holding stable_name_mutex
+static void
+fileSnEntry(uint32_t sn, uint32_t g)
+{
+    snGenList *list = &sn_gens[g];
+
+    if (list->n_entries == list->size) {
+        list->size = list->size ? list->size * 2 : INIT_SNT_SIZE;
+        list->entries = stgReallocBytes(list->entries,
+                                        list->size * sizeof(uint32_t),
+                                        "fileSnEntry");
+    }
+    sn_info[sn].gen = g;
+    sn_info[sn].pos = list->n_entries;
+    list->entries[list->n_entries++] = sn;
+}
+
+// Must be holding stable_name_mutex
+static void
+unfileSnEntry(uint32_t sn)
+{
+    snGenList *list = &sn_gens[sn_info[sn].gen];
+    uint32_t pos = sn_info[sn].pos;
+    uint32_t last;
+
+    ASSERT(list->entries[pos] == sn);
+    last = list->entries[--list->n_entries];
+    list->entries[pos] = last;
+    sn_info[last].pos = pos;
+}
+
+/* The generation of an object, as spTargetGen() in StablePtr.c */
+static uint32_t
+snObjectGen(StgClosure *p)
+{
+    StgClosure *q = UNTAG_CLOSURE(p);
+    bdescr *bd;
+
+    if (!HEAP_ALLOCED_GC(q)) {
+        return oldest_gen->no;
+    }
+    bd = Bdescr((StgPtr)q);
+    if (bd->flags & BF_COMPACT) {
+        // only the first block of a compact region has a generation
+        bd = Bdescr((StgPtr)objectGetCompactBlock(q));
+    }
+    return bd->gen_no;
 }
 
 
@@ -114,6 +231,8 @@ enlargeStableNameTable(void)
 void
 exitStableNameTable(void)
 {
+    uint32_t g;
+
     if (addrToStableHash)
         freeHashTable(addrToStableHash, NULL);
     addrToStableHash = NULL;
@@ -123,6 +242,15 @@ exitStableNameTable(void)
     stable_name_table = NULL;
     SNT_size = 0;
 
+    for (g = 0; g < n_sn_gens; g++) {
+        stgFree(sn_gens[g].entries);
+    }
+    stgFree(sn_gens);
+    sn_gens = NULL;
+    n_sn_gens = 0;
+    stgFree(sn_info);
+    sn_info = NULL;
+
 #if defined(THREADED_RTS)
     closeMutex(&stable_name_mutex);
 #endif
@@ -131,8 +259,13 @@ exitStableNameTable(void)
 void
 freeSnEntry(snEntry *sn)
 {
+  StgWord i = sn - stable_name_table;
+
   ASSERT(sn->sn_obj == NULL);
-  removeHashTable(addrToStableHash, (W_)sn->old, NULL);
+  if (sn->old != NULL) {
+      removeHashTable(addrToStableHash, (W_)sn->old, (void *)i);
+  }
+  unfileSnEntry(i);
   sn->addr = (P_)stable_name_free;
   stable_name_free = sn;
 }
@@ -203,7 +336,9 @@ lookupStableName (StgPtr p)
   sn = stable_name_free - stable_name_table;
   stable_name_free  = (snEntry*)(stable_name_free->addr);
   stable_name_table[sn].addr = p;
+  stable_name_table[sn].old = p;
   stable_name_table[sn].sn_obj = NULL;
+  fileSnEntry(sn, 0);
   /* debugTrace(DEBUG_stable, "new stable name %d at %p\n",sn,p); */
 
   /* add the new stable name to the hash table */
@@ -214,17 +349,6 @@ lookupStableName (StgPtr p)
   return sn;
 }
 
-/* -----------------------------------------------------------------------------
- * Remember old stable name addresses
- * -------------------------------------------------------------------------- */
-
-void
-rememberOldStableNameAddresses(void)
-{
-    /* TODO: Only if !full GC */
-    FOR_EACH_STABLE_NAME(p, p->old = p->addr;);
-}
-
 /* -----------------------------------------------------------------------------
  * Thread the stable name table for compacting GC.
  *
@@ -261,72 +385,96 @@ threadStableNameTable( evac_fn evac, void *user )
  * -------------------------------------------------------------------------- */
 
 void
-gcStableNameTable( void )
+gcStableNameTable( uint32_t max_gen )
 {
+    uint32_t g, i;
+    snEntry *p;
+
     // We must take the stable name lock lest we race with the nonmoving
     // collector (namely nonmovingSweepStableNameTable).
     stableNameLock();
-    FOR_EACH_STABLE_NAME(
-        p, {
-            // FOR_EACH_STABLE_NAME traverses free entries too, so
-            // check sn_obj
-            if (p->sn_obj != NULL) {
-                // Update the pointer to the StableName object, if there is one
-                p->sn_obj = isAlive(p->sn_obj);
-                if (p->sn_obj == NULL) {
-                    // StableName object died
-                    debugTrace(DEBUG_stable, "GC'd StableName %ld (addr=%p)",
-                               (long)(p - stable_name_table), p->addr);
-                    freeSnEntry(p);
-                } else if (p->addr != NULL) {
-                    // sn_obj is alive, update pointee
-                    p->addr = (StgPtr)isAlive((StgClosure *)p->addr);
-                    if (p->addr == NULL) {
-                        // Pointee died
-                        debugTrace(DEBUG_stable, "GC'd pointee %ld",
-                                   (long)(p - stable_name_table));
-                    }
+    for (g = 0; g <= max_gen; g++) {
+        if (max_gen < oldest_gen->no) {
+            stable_name_minor_gc_visits += sn_gens[g].n_entries;
+        }
+        // Backwards, as freeSnEntry() moves the last entry into the place
+        // of the one it frees.
+        for (i = sn_gens[g].n_entries; i-- > 0; ) {
+            p = &stable_name_table[sn_gens[g].entries[i]];
+            if (p->sn_obj == NULL) {
+                continue;
+            }
+            // Update the pointer to the StableName object, if there is one
+            p->sn_obj = isAlive(p->sn_obj);
+            if (p->sn_obj == NULL) {
+                // StableName object died
+                debugTrace(DEBUG_stable, "GC'd StableName %ld (addr=%p)",
+                           (long)(p - stable_name_table), p->addr);
+                freeSnEntry(p);
+            } else if (p->addr != NULL) {
+                // sn_obj is alive, update pointee
+                p->addr = (StgPtr)isAlive((StgClosure *)p->addr);
+                if (p->addr == NULL) {
+                    // Pointee died
+                    debugTrace(DEBUG_stable, "GC'd pointee %ld",
+                               (long)(p - stable_name_table));
                 }
             }
-        });
+        }
+    }
     stableNameUnlock();
 }
 
 /* -----------------------------------------------------------------------------
  * Update the StableName hash table
  *
- * The boolean argument 'full' indicates that a major collection is
- * being done, so we might as well throw away the hash table and build
- * a new one.  For a minor collection, we just re-hash the elements
- * that changed.
+ * After a collection of generations 0..max_gen (and after the compacting
+ * collector, if any, has moved things), re-hash the entries in those
+ * generations whose pointee moved or died, and refile each under the
+ * generation its objects are now in.  See Note [Generational stable names].
  * -------------------------------------------------------------------------- */
 
 void
-updateStableNameTable(bool full)
+updateStableNameTable( uint32_t max_gen )
 {
-    if (full && addrToStableHash != NULL && 0 != keyCountHashTable(addrToStableHash)) {
-        freeHashTable(addrToStableHash,NULL);
-        addrToStableHash = allocHashTable();
-    }
+    uint32_t g, h, i, sn, last;
+    snGenList *list;
+    snEntry *p;
 
-    if(full) {
-        FOR_EACH_STABLE_NAME(
-            p, {
-                if (p->addr != NULL) {
-                    // Target still alive, Re-hash this stable name
-                    insertHashTable(addrToStableHash, (W_)p->addr, (void *)(p - stable_name_table));
+    stableNameLock();
+    // Oldest first, so that an entry refiled under an older generation
+    // that was also collected is not visited twice.
+    for (g = max_gen + 1; g-- > 0; ) {
+        list = &sn_gens[g];
+        for (i = list->n_entries; i-- > 0; ) {
+            sn = list->entries[i];
+            p = &stable_name_table[sn];
+            if (p->addr != p->old) {
+                /* Movement happened: */
+                if (p->old != NULL) {
+                    removeHashTable(addrToStableHash, (W_)p->old, (void *)(W_)sn);
                 }
-            });
-    } else {
-        FOR_EACH_STABLE_NAME(
-            p, {
-                if (p->addr != p->old) {
-                    removeHashTable(addrToStableHash, (W_)p->old, NULL);
-                    /* Movement happened: */
-                    if (p->addr != NULL) {
-                        insertHashTable(addrToStableHash, (W_)p->addr, (void *)(p - stable_name_table));
-                    }
+                if (p->addr != NULL) {
+                    insertHashTable(addrToStableHash, (W_)p->addr, (void *)(W_)sn);
                 }
-            });
+                p->old = p->addr;
+            }
+
+            if (p->sn_obj == NULL) {
+                continue;
+            }
+            h = snObjectGen(p->sn_obj);
+            if (p->addr != NULL) {
+                h = stg_min(h, snObjectGen((StgClosure *)p->addr));
+            }
+            if (h != g) {
+                ASSERT(h > g);
+                last = list->entries[--list->n_entries];
+                list->entries[i] = last;
+                sn_info[last].pos = i;
+                fileSnEntry(sn, h);
+            }
+        }
     }
+    stableNameUnlock();
 }
@@ -15,17 +15,18 @@ void    freeSnEntry           ( snEntry *sn );
 void    exitStableNameTable   ( void );
 StgWord lookupStableName      ( StgPtr p );
 
-void    rememberOldStableNameAddresses ( void );
-
 void    threadStableNameTable ( evac_fn evac, void *user );
-void    gcStableNameTable     ( void );
-void    updateStableNameTable ( bool full );
+void    gcStableNameTable     ( uint32_t max_gen );
+void    updateStableNameTable ( uint32_t max_gen );
 
 void    stableNameLock            ( void );
 void    stableNameUnlock          ( void );
 
 extern unsigned int SNT_size;
 
+// for the +RTS -t --machine-readable stats
+extern W_ stable_name_minor_gc_visits;
+
 #define FOR_EACH_STABLE_NAME(p, CODE)                                   \
     do {                                                                \
         snEntry *p;                                                     \
@@ -16,6 +16,11 @@
 #include "RtsUtils.h"
 #include "Trace.h"
 #include "StablePtr.h"
+#include "Capability.h"
+#include "Task.h"
+#include "sm/Storage.h"
+#include "sm/HeapAlloc.h"
+#include "sm/CNF.h"
 
 #include <string.h>
 
@@ -83,9 +88,10 @@
   reallocated for growth. The table is never shrunk for its space to
   be reclaimed.
 
-  Future plans for stable ptrs include distinguishing them by the
-  generation of the pointed object. See
-  https://gitlab.haskell.org/ghc/ghc/issues/7670 for details.
+  Stable pointers are distinguished by the generation of the pointed
+  object, so that a minor GC needn't look at all of them; see Note
+  [Generational stable pointers] and
+  https://gitlab.haskell.org/ghc/ghc/issues/7670.
 */
 
 spEntry *stable_ptr_table = NULL;
@@ -93,6 +99,67 @@ static spEntry *stable_ptr_free = NULL;
 static unsigned int SPT_size = 0;
 #define INIT_SPT_SIZE 64
 
+/* Note [Generational stable pointers]
+ *
+ * A program can hold millions of long-lived stable pointers, and a minor
+ * GC used to visit every one of them even though hardly any point into
+ * the generations being collected.  So, like the mutable lists, we
+ * remember which stable pointers may point into which generation:
+ *
+ *  - sp_gens[g] is the list of in-use entries (as indices into
+ *    stable_ptr_table) that are filed under generation g.
+ *
+ *  - sp_info[sp] records the generation entry sp is filed under and its
+ *    position in that list, so that freeStablePtr() can remove it in
+ *    constant time by moving the last entry of the list into its place.
+ *
+ * The invariant is that an entry is filed under a generation no older
+ * than that of the object it points to.  A new entry is filed under
+ * generation 0, which saves getStablePtr() from looking up the block
+ * descriptor of its argument.  Objects never move to a younger
+ * generation, so the invariant can only be broken by the GC, which
+ * restores it: gcStablePtrTable() visits just the entries filed under
+ * the generations being collected and refiles each under the generation
+ * its object has been evacuated to, which it reads off the object's
+ * block descriptor.  It goes through the lists oldest first, so an entry
+ * moved to an older generation that is also being collected is not
+ * visited twice.  An entry whose object is not in the heap (a static
+ * closure) is filed under the oldest generation.
+ *
+ * Free slots are never on any list, so the traversals no longer have to
+ * skip over them either.  All of this is protected by stable_ptr_mutex,
+ * like the rest of the table.  The entries a Capability has handed out
+ * without taking the lock are filed later; see Note [Per-Capability
+ * stable pointer batches].
+ *
+ * stable_ptr_minor_gc_visits counts the entries that minor GCs visit,
+ * for +RTS -t --machine-readable, so that the testsuite can check that
+ * it doesn't grow with the number of old stable pointers.
+ */
+
+W_ stable_ptr_minor_gc_visits = 0;
+
+typedef struct {
+    uint32_t *entries;      // indices into stable_ptr_table
+    uint32_t n_entries;
+    uint32_t size;          // allocated size of entries[]
+} spGenList;
+
+typedef struct {
+    uint32_t gen;           // generation this entry is filed under
+    uint32_t pos;           // index in sp_gens[gen].entries
+} spInfo;
+
+static spGenList *sp_gens = NULL;
+static uint32_t n_sp_gens = 0;
+static spInfo *sp_info = NULL;
+
+// sp_info[sp].gen of an entry that is not on any list: reserved by or
+// handed out by a Capability (SP_UNFILED), or freed while in the
+// unfiled batch of a Capability (SP_DEAD).
+#define SP_UNFILED ((uint32_t)-1)
+#define SP_DEAD    ((uint32_t)-2)
+
 /* Each time the stable pointer table is enlarged, we temporarily retain the old
  * version to ensure dereferences are thread-safe (see Note [Enlarging the
  * stable pointer table]).  Since we double the size of the table each time, we
@@ -112,6 +179,10 @@ static uint32_t n_old_SPTs = 0;
 
 #if defined(THREADED_RTS)
 Mutex stable_ptr_mutex;
+
+// Odd while enlargeStablePtrTable() is copying the table; see Note
+// [Per-Capability stable pointer batches].
+static volatile StgWord spt_enlarge_count = 0;
 #endif
 
 static void enlargeStablePtrTable(void);
@@ -152,12 +223,24 @@ initSpEntryFreeList(spEntry *table, uint32_t n, spEntry *free)
 void
 initStablePtrTable(void)
 {
+    uint32_t g;
+
     if (SPT_size > 0) return;
     SPT_size = INIT_SPT_SIZE;
     stable_ptr_table = stgMallocBytes(SPT_size * sizeof(spEntry),
                                       "initStablePtrTable");
     initSpEntryFreeList(stable_ptr_table,INIT_SPT_SIZE,NULL);
 
+    sp_info = stgMallocBytes(SPT_size * sizeof(spInfo), "initStablePtrTable");
+    n_sp_gens = RtsFlags.GcFlags.generations;
+    sp_gens = stgMallocBytes(n_sp_gens * sizeof(spGenList),
+                             "initStablePtrTable");
+    for (g = 0; g < n_sp_gens; g++) {
+        sp_gens[g].entries = NULL;
+        sp_gens[g].n_entries = 0;
+        sp_gens[g].size = 0;
+    }
+
 #if defined(THREADED_RTS)
     initMutex(&stable_ptr_mutex);
 #endif
@@ -183,6 +266,11 @@ enlargeStablePtrTable(void)
     new_stable_ptr_table =
         stgMallocBytes(SPT_size * sizeof(spEntry),
                        "enlargeStablePtrTable");
+#if defined(THREADED_RTS)
+    // Capabilities may be filling in their reserved entries meanwhile
+    spt_enlarge_count++;
+    store_load_barrier();
+#endif
     memcpy(new_stable_ptr_table,
            stable_ptr_table,
            old_SPT_size * sizeof(spEntry));
@@ -194,8 +282,69 @@ enlargeStablePtrTable(void)
      * pointer will always read a valid address.
      */
     stable_ptr_table = new_stable_ptr_table;
+#if defined(THREADED_RTS)
+    write_barrier();
+    spt_enlarge_count++;
+#endif
 
     initSpEntryFreeList(stable_ptr_table + old_SPT_size, old_SPT_size, NULL);
+
+    // Only used with stable_ptr_mutex held, so we can just realloc()
+    sp_info = stgReallocBytes(sp_info, SPT_size * sizeof(spInfo),
+                              "enlargeStablePtrTable");
+}
+
+/* -----------------------------------------------------------------------------
+ * The per-generation lists; see Note [Generational stable pointers]
+ * -------------------------------------------------------------------------- */
+
+// Must be holding stable_ptr_mutex
+static void
+fileSpEntry(uint32_t sp, uint32_t g)
+{
+    spGenList *list = &sp_gens[g];
+
+    if (list->n_entries == list->size) {
+        list->size = list->size ? list->size * 2 : INIT_SPT_SIZE;
+        list->entries = stgReallocBytes(list->entries,
+                                        list->size * sizeof(uint32_t),
+                                        "fileSpEntry");
+    }
+    sp_info[sp].gen = g;
+    sp_info[sp].pos = list->n_entries;
+    list->entries[list->n_entries++] = sp;
+}
+
+// Must be holding stable_ptr_mutex
+static void
+unfileSpEntry(uint32_t sp)
+{
+    spGenList *list = &sp_gens[sp_info[sp].gen];
+    uint32_t pos = sp_info[sp].pos;
+    uint32_t last;
+
+    ASSERT(list->entries[pos] == sp);
+    last = list->entries[--list->n_entries];
+    list->entries[pos] = last;
+    sp_info[last].pos = pos;
+}
+
+/* The generation of the object p points to, after it has been evacuated */
+static uint32_t
+spTargetGen(StgPtr p)
+{
+    StgClosure *q = UNTAG_CLOSURE((StgClosure *)p);
+    bdescr *bd;
+
+    if (!HEAP_ALLOCED_GC(q)) {
+        return oldest_gen->no;
+    }
+    bd = Bdescr((StgPtr)q);
+    if (bd->flags & BF_COMPACT) {
+        // only the first block of a compact region has a generation
+        bd = Bdescr((StgPtr)objectGetCompactBlock(q));
+    }
+    return bd->gen_no;
 }
 
 /* Note [Enlarging the stable pointer table]
@@ -232,11 +381,22 @@ freeOldSPTs(void)
 void
 exitStablePtrTable(void)
 {
+    uint32_t g;
+
     if (stable_ptr_table)
         stgFree(stable_ptr_table);
     stable_ptr_table = NULL;
     SPT_size = 0;
 
+    for (g = 0; g < n_sp_gens; g++) {
+        stgFree(sp_gens[g].entries);
+    }
+    stgFree(sp_gens);
+    sp_gens = NULL;
+    n_sp_gens = 0;
+    stgFree(sp_info);
+    sp_info = NULL;
+
     freeOldSPTs();
 
 #if defined(THREADED_RTS)
@@ -255,12 +415,174 @@ void
 freeStablePtrUnsafe(StgStablePtr sp)
 {
     ASSERT((StgWord)sp < SPT_size);
+    if (sp_info[(StgWord)sp].gen == SP_UNFILED) {
+        // still in the unfiled batch of some Capability, which will free
+        // the slot when it files the batch
+        sp_info[(StgWord)sp].gen = SP_DEAD;
+        return;
+    }
+    unfileSpEntry((StgWord)sp);
     freeSpEntry(&stable_ptr_table[(StgWord)sp]);
 }
 
+/* -----------------------------------------------------------------------------
+ * Per-Capability batches
+ * -------------------------------------------------------------------------- */
+
+/* Note [Per-Capability stable pointer batches]
+ *
+ * FFI callbacks, foreign exports and hs_try_putmvar() create and free
+ * stable pointers at a high rate, often from many Capabilities at once,
+ * and taking stable_ptr_mutex for each of them made it a point of
+ * contention.  So a Task that owns a Capability uses the StablePtrBatch
+ * of that Capability instead, which needs no lock:
+ *
+ *  - getStablePtr() hands out a slot from cap->sp_batch.reserved, and
+ *    records it in cap->sp_batch.unfiled, because it cannot add it to
+ *    the gen-0 list of Note [Generational stable pointers] without the
+ *    lock.
+ *
+ *  - freeStablePtr() just records the slot in cap->sp_batch.freed.  The
+ *    entry still points to its object until the batch is flushed, which
+ *    is fine because nobody may dereference it any more.
+ *
+ * Only when the reserved slots run out, or the freed batch fills up, do
+ * we take the lock, file the unfiled entries, give back the freed ones
+ * and reserve another SP_BATCH_SIZE free slots, all in one go.  The GC
+ * flushes every batch before it looks at the table (the Capabilities are
+ * all stopped then, and it holds the lock), so a freed entry does not
+ * keep its object alive across a GC, and an unfiled one is traced.
+ *
+ * A slot may be freed on a Capability other than the one that handed it
+ * out, or by a Task without a Capability, before it has been filed.  To
+ * tell such slots apart, sp_info[sp].gen is SP_UNFILED from the time a
+ * slot is reserved until it is filed; freeing an unfiled slot just sets
+ * it to SP_DEAD, and whoever files the batch holding it then frees it.
+ * sp_info is only ever touched with the lock held.
+ *
+ * Tasks without a Capability, such as ones in a safe foreign call, take
+ * the lock and use the table directly as before; so do all Tasks in the
+ * non-threaded RTS, where there is nothing to gain.
+ *
+ * The fast path of getStablePtr() writes its entry without the lock, so
+ * enlargeStablePtrTable() may be copying the table at the same moment,
+ * and could copy the entry before it is written.  To guard against this
+ * the enlargement bumps spt_enlarge_count before the copy and again after
+ * installing the new table; the writer reads the count, writes its entry
+ * into the current table and, if the count has changed in the meantime,
+ * writes it again into the new one.  A write into the old table is
+ * harmless, as old tables live until the next GC.
+ */
+
+#if defined(THREADED_RTS)
+
+// The batch of the Capability owned by the current Task, or NULL
+static StablePtrBatch *
+myStablePtrBatch(void)
+{
+    Task *task = myTask();
+
+    if (task != NULL && task->cap != NULL && task->cap->running_task == task) {
+        return &task->cap->sp_batch;
+    }
+    return NULL;
+}
+
+// Write the entry for a slot we have reserved, without the lock
+static void
+setReservedEntry(uint32_t sp, StgPtr p)
+{
+    StgWord count;
+
+    do {
+        while ((count = spt_enlarge_count) & 1) {
+            busy_wait_nop();
+        }
+        load_load_barrier();
+        stable_ptr_table[sp].addr = p;
+        store_load_barrier();
+    } while (spt_enlarge_count != count);
+}
+
+// Must be holding stable_ptr_mutex
+static void
+fileBatch(StablePtrBatch *b)
+{
+    uint32_t i, sp;
+
+    for (i = 0; i < b->n_unfiled; i++) {
+        sp = b->unfiled[i];
+        if (sp_info[sp].gen == SP_DEAD) {
+            freeSpEntry(&stable_ptr_table[sp]);
+        } else {
+            ASSERT(sp_info[sp].gen == SP_UNFILED);
+            fileSpEntry(sp, 0);
+        }
+    }
+    b->n_unfiled = 0;
+}
+
+// Must be holding stable_ptr_mutex
+static void
+flushBatch(StablePtrBatch *b)
+{
+    uint32_t i;
+
+    fileBatch(b);
+    for (i = 0; i < b->n_freed; i++) {
+        freeStablePtrUnsafe((StgStablePtr)(StgWord)b->freed[i]);
+    }
+    b->n_freed = 0;
+}
+
+// Must be holding stable_ptr_mutex
+static void
+refillBatch(StablePtrBatch *b)
+{
+    uint32_t sp;
+
+    fileBatch(b);
+    while (b->n_reserved < SP_BATCH_SIZE) {
+        if (!stable_ptr_free) enlargeStablePtrTable();
+        sp = stable_ptr_free - stable_ptr_table;
+        stable_ptr_free = (spEntry*)(stable_ptr_free->addr);
+        sp_info[sp].gen = SP_UNFILED;
+        b->reserved[b->n_reserved++] = sp;
+    }
+}
+
+#endif /* THREADED_RTS */
+
+// Must be holding stable_ptr_mutex, with all Capabilities stopped
+static void
+flushStablePtrBatches(void)
+{
+#if defined(THREADED_RTS)
+    uint32_t i;
+
+    for (i = 0; i < n_capabilities; i++) {
+        flushBatch(&capabilities[i]->sp_batch);
+    }
+#endif
+}
+
 void
 freeStablePtr(StgStablePtr sp)
 {
+#if defined(THREADED_RTS)
+    StablePtrBatch *b = myStablePtrBatch();
+
+    if (b != NULL) {
+        if (b->n_freed == SP_BATCH_SIZE) {
+            stablePtrLock();
+            flushBatch(b);
+            stablePtrUnlock();
+        }
+        b->freed[b->n_freed++] = (StgWord)sp;
+        return;
+    }
+#endif
+
     stablePtrLock();
     freeStablePtrUnsafe(sp);
     stablePtrUnlock();
@@ -275,11 +597,29 @@ getStablePtr(StgPtr p)
 {
   StgWord sp;
 
+#if defined(THREADED_RTS)
+  StablePtrBatch *b = myStablePtrBatch();
+
+  if (b != NULL) {
+      if (b->n_reserved == 0) {
+          stablePtrLock();
+          refillBatch(b);
+          stablePtrUnlock();
+      }
+      sp = b->reserved[--b->n_reserved];
+      setReservedEntry(sp, p);
+      ASSERT(b->n_unfiled < SP_BATCH_SIZE);
+      b->unfiled[b->n_unfiled++] = sp;
+      return (StgStablePtr)(sp);
+  }
+#endif
+
   stablePtrLock();
   if (!stable_ptr_free) enlargeStablePtrTable();
   sp = stable_ptr_free - stable_ptr_table;
   stable_ptr_free  = (spEntry*)(stable_ptr_free->addr);
   stable_ptr_table[sp].addr = p;
+  fileSpEntry(sp, 0);
   stablePtrUnlock();
   return (StgStablePtr)(sp);
 }
@@ -291,14 +631,14 @@ getStablePtr(StgPtr p)
 #define FOR_EACH_STABLE_PTR(p, CODE)                                    \
     do {                                                                \
         spEntry *p;                                                     \
-        spEntry *__end_ptr = &stable_ptr_table[SPT_size];               \
-        for (p = stable_ptr_table; p < __end_ptr; p++) {                \
-            /* Internal pointers are free slots. NULL is last in free */ \
-            /* list. */                                                 \
-            if (p->addr &&                                              \
-                (p->addr < (P_)stable_ptr_table || p->addr >= (P_)__end_ptr)) \
-            {                                                           \
-                do { CODE } while(0);                                   \
+        uint32_t __g, __i;                                              \
+        /* Free slots are not on the lists */                           \
+        for (__g = 0; __g < n_sp_gens; __g++) {                         \
+            for (__i = 0; __i < sp_gens[__g].n_entries; __i++) {        \
+                p = &stable_ptr_table[sp_gens[__g].entries[__i]];       \
+                if (p->addr) {                                          \
+                    do { CODE } while(0);                               \
+                }                                                       \
             }                                                           \
         }                                                               \
     } while(0)
@@ -306,12 +646,70 @@ getStablePtr(StgPtr p)
 void
 markStablePtrTable(evac_fn evac, void *user)
 {
+#if defined(THREADED_RTS)
+    uint32_t i, j;
+    StablePtrBatch *b;
+#endif
+
     /* Since no other thread can currently be dereferencing a stable pointer, it
      * is safe to free the old versions of the table.
      */
     freeOldSPTs();
 
     FOR_EACH_STABLE_PTR(p, evac(user, (StgClosure **)&p->addr););
+
+#if defined(THREADED_RTS)
+    // The retainer profiler calls us without the lock, so we can only
+    // look at the unfiled entries, not file them.
+    for (i = 0; i < n_capabilities; i++) {
+        b = &capabilities[i]->sp_batch;
+        for (j = 0; j < b->n_unfiled; j++) {
+            evac(user, (StgClosure **)&stable_ptr_table[b->unfiled[j]].addr);
+        }
+    }
+#endif
+}
+
+/* -----------------------------------------------------------------------------
+ * Like markStablePtrTable(), but only for the entries that may point into
+ * generations 0..max_gen, which are then refiled under the generation of
+ * their (evacuated) object.  evac must be the copying GC's mark_root.
+ * See Note [Generational stable pointers].
+ * -------------------------------------------------------------------------- */
+
+void
+gcStablePtrTable(evac_fn evac, void *user, uint32_t max_gen)
+{
+    uint32_t g, h, i, sp, last;
+    spGenList *list;
+
+    freeOldSPTs();
+    flushStablePtrBatches();
+
+    for (g = max_gen + 1; g-- > 0; ) {
+        list = &sp_gens[g];
+        if (max_gen < oldest_gen->no) {
+            stable_ptr_minor_gc_visits += list->n_entries;
+        }
+        // Backwards, so that moving the last entry into the place of one
+        // that leaves the list only moves one we have already visited.
+        for (i = list->n_entries; i-- > 0; ) {
+            sp = list->entries[i];
+            if (stable_ptr_table[sp].addr == NULL) {
+                h = oldest_gen->no;
+            } else {
+                evac(user, (StgClosure **)&stable_ptr_table[sp].addr);
+                h = spTargetGen(stable_ptr_table[sp].addr);
+            }
+            if (h != g) {
+                ASSERT(h > g);
+                last = list->entries[--list->n_entries];
+                list->entries[i] = last;
+                sp_info[last].pos = i;
+                fileSpEntry(sp, h);
+            }
+        }
+    }
 }
 
 /* -----------------------------------------------------------------------------
@@ -18,6 +18,21 @@
 
 #include "BeginPrivate.h"
 
+/* Stable pointer table slots owned by a Capability, so that the common
+ * getStablePtr() and freeStablePtr() need not take stable_ptr_mutex.
+ * See Note [Per-Capability stable pointer batches] in StablePtr.c.
+ */
+#define SP_BATCH_SIZE 32
+
+typedef struct {
+    uint32_t reserved[SP_BATCH_SIZE];   // free slots taken from the table
+    uint32_t n_reserved;
+    uint32_t unfiled[SP_BATCH_SIZE];    // in use, not on any sp_gens list
+    uint32_t n_unfiled;
+    uint32_t freed[SP_BATCH_SIZE];      // freed, not yet given back
+    uint32_t n_freed;
+} StablePtrBatch;
+
 void    freeStablePtr         ( StgStablePtr sp );
 
 /* Use the "Unsafe" one after only when manually locking and
@@ -33,11 +48,19 @@ void    exitStablePtrTable      ( void );
  */
 void    markStablePtrTable    ( evac_fn evac, void *user );
 
+/* As markStablePtrTable, but only the stable ptrs that may point into
+ * generations 0..max_gen; used by the copying GC.
+ */
+void    gcStablePtrTable      ( evac_fn evac, void *user, uint32_t max_gen );
+
 void    threadStablePtrTable  ( evac_fn evac, void *user );
 
 void    stablePtrLock         ( void );
 void    stablePtrUnlock       ( void );
 
+// for the +RTS -t --machine-readable stats
+extern W_ stable_ptr_minor_gc_visits;
+
 #if defined(THREADED_RTS)
 // needed by Schedule.c:forkProcess()
 extern Mutex stable_ptr_mutex;
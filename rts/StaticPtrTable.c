@@ -21,7 +21,7 @@ static Mutex spt_lock;
 #endif
 
 /// Hash function for the SPT.
-STATIC_INLINE int hashFingerprint(const HashTable *table, StgWord key) {
+STATIC_INLINE StgWord hashFingerprint(const HashTable *table, StgWord key) {
   const StgWord64* ptr = (StgWord64*) key;
   // Take half of the key to compute the hash.
   return hashWord(table, *(ptr + 1));
@@ -18,11 +18,15 @@
 #include "sm/Storage.h"
 #include "sm/GCThread.h"
 #include "sm/BlockAlloc.h"
+#include "sm/OSMem.h"
 
 // for spin/yield counters
 #include "sm/GC.h"
 #include "ThreadPaused.h"
 #include "Messages.h"
+#include "SpinCondition.h"
+#include "StablePtr.h"
+#include "StableName.h"
 
 #include <string.h> // for memset
 
@@ -818,10 +822,23 @@ static void report_summary(const RTSSummaryStats* sum)
     statsPrintf("%16s bytes maximum slop\n", temp);
 
     statsPrintf("%16" FMT_Word64 " MiB total memory in use (%"
-                FMT_Word64 " MB lost due to fragmentation)\n\n",
+                FMT_Word64 " MB lost due to fragmentation)\n",
                 stats.max_mem_in_use_bytes  / (1024 * 1024),
                 sum->fragmentation_bytes / (1024 * 1024));
 
+    showStgWord64(sum->free_list_bytes, temp, true/*commas*/);
+    statsPrintf("%16s bytes free in %" FMT_Word64 " block groups at exit"
+                " (largest %" FMT_Word64 " bytes, %" FMT_Word64
+                " free megablocks)\n",
+                temp, sum->free_list_groups, sum->largest_free_group_bytes,
+                sum->free_mblocks);
+
+    if (RtsFlags.GcFlags.hugePages) {
+        showStgWord64(sum->huge_page_bytes, temp, true/*commas*/);
+        statsPrintf("%16s bytes of heap in huge pages at exit\n", temp);
+    }
+    statsPrintf("\n");
+
     /* Print garbage collections in each gen */
     statsPrintf("                                     Tot time (elapsed)  Avg pause  Max pause\n");
     for (g = 0; g < RtsFlags.GcFlags.generations; g++) {
@@ -877,6 +894,26 @@ static void report_summary(const RTSSummaryStats* sum)
                 sum->sparks.converted, sum->sparks.overflowed,
                 sum->sparks.dud, sum->sparks.gcd,
                 sum->sparks.fizzled);
+
+    statsPrintf("  MIGRATIONS: %" FMT_Word64 " threads (%" FMT_Word64
+                " to another NUMA node)\n\n",
+                sum->thread_migrations, sum->remote_thread_migrations);
+
+    statsPrintf("  CONDITION WAITS: %" FMT_Word64 " ended while spinning, %"
+                FMT_Word64 " parked\n\n",
+                sum->cond_waits_spun, sum->cond_waits_parked);
+
+    statsPrintf("  WORK QUEUES: %" FMT_Word64 " spark pool resizes, %"
+                FMT_Word64 " GC todo queue resizes (%" FMT_Word64
+                " overflowed)\n\n",
+                sum->spark_pool_resizes,
+                sum->todo_q_resizes, sum->todo_q_overflows);
+
+    if (RtsFlags.ParFlags.parGcEnabled) {
+        statsPrintf("  GC STEALS: %" FMT_Word64 " (%" FMT_Word64
+                    " from another NUMA node)\n\n",
+                    sum->gc_steals, sum->gc_remote_steals);
+    }
 #endif
 
     statsPrintf("  INIT    time  %7.3fs  (%7.3fs elapsed)\n",
@@ -1098,6 +1135,16 @@ static void report_machine_readable (const RTSSummaryStats * sum)
     MR_STAT("gc_wall_percent", "f", sum->gc_cpu_percent);
 #endif
     MR_STAT("fragmentation_bytes", FMT_Word64, sum->fragmentation_bytes);
+    MR_STAT("free_list_bytes", FMT_Word64, sum->free_list_bytes);
+    MR_STAT("free_list_groups", FMT_Word64, sum->free_list_groups);
+    MR_STAT("largest_free_group_bytes", FMT_Word64,
+            sum->largest_free_group_bytes);
+    MR_STAT("free_mblocks", FMT_Word64, sum->free_mblocks);
+    MR_STAT("huge_page_bytes", FMT_Word64, sum->huge_page_bytes);
+    MR_STAT("stable_ptr_minor_gc_visits", FMT_Word64,
+            sum->stable_ptr_minor_gc_visits);
+    MR_STAT("stable_name_minor_gc_visits", FMT_Word64,
+            sum->stable_name_minor_gc_visits);
     // average_bytes_used is done above
     MR_STAT("alloc_rate", FMT_Word64, sum->alloc_rate);
     MR_STAT("productivity_cpu_percent", "f", sum->productivity_cpu_percent);
@@ -1115,6 +1162,16 @@ static void report_machine_readable (const RTSSummaryStats * sum)
     MR_STAT("sparks_gcd", FMT_Word, sum->sparks.gcd);
     MR_STAT("sparks_fizzled", FMT_Word, sum->sparks.fizzled);
     MR_STAT("work_balance", "f", sum->work_balance);
+    MR_STAT("spark_pool_resizes", FMT_Word64, sum->spark_pool_resizes);
+    MR_STAT("todo_q_resizes", FMT_Word64, sum->todo_q_resizes);
+    MR_STAT("todo_q_overflows", FMT_Word64, sum->todo_q_overflows);
+    MR_STAT("gc_steals", FMT_Word64, sum->gc_steals);
+    MR_STAT("gc_remote_steals", FMT_Word64, sum->gc_remote_steals);
+    MR_STAT("thread_migrations", FMT_Word64, sum->thread_migrations);
+    MR_STAT("remote_thread_migrations", FMT_Word64,
+            sum->remote_thread_migrations);
+    MR_STAT("cond_waits_spun", FMT_Word64, sum->cond_waits_spun);
+    MR_STAT("cond_waits_parked", FMT_Word64, sum->cond_waits_parked);
 
     // next, globals (other than internal counters)
     MR_STAT("n_capabilities", FMT_Word32, n_capabilities);
@@ -1347,6 +1404,27 @@ stat_exit (void)
                 + sum.sparks.dud
                 + sum.sparks.overflowed;
 
+            getSpinConditionStats(&sum.cond_waits_spun,
+                                  &sum.cond_waits_parked);
+
+            for (uint32_t i = 0; i < n_capabilities; i++) {
+                sum.thread_migrations +=
+                    capabilities[i]->thread_migrations;
+                sum.remote_thread_migrations +=
+                    capabilities[i]->remote_thread_migrations;
+            }
+
+            for (uint32_t i = 0; i < n_capabilities; i++) {
+                sum.spark_pool_resizes += capabilities[i]->sparks->resizes;
+                for (uint32_t g = 0; g < RtsFlags.GcFlags.generations; g++) {
+                    const WSDeque *todo_q = gc_threads[i]->gens[g].todo_q;
+                    sum.todo_q_resizes   += todo_q->resizes;
+                    sum.todo_q_overflows += todo_q->overflows;
+                }
+                sum.gc_steals        += gc_threads[i]->steals;
+                sum.gc_remote_steals += gc_threads[i]->remote_steals;
+            }
+
             if (RtsFlags.ParFlags.parGcEnabled && stats.par_copied_bytes > 0) {
                 // See Note [Work Balance]
                 sum.work_balance =
@@ -1371,6 +1449,21 @@ stat_exit (void)
                          - hw_alloc_blocks * BLOCK_SIZE_W)
                 / (uint64_t)sizeof(W_);
 
+            {
+                FreeListStats fl;
+                getFreeListStats(&fl);
+                sum.free_list_bytes = (uint64_t)fl.free_blocks * BLOCK_SIZE;
+                sum.free_list_groups = fl.free_groups;
+                sum.largest_free_group_bytes =
+                    (uint64_t)fl.largest_free_group * BLOCK_SIZE;
+                sum.free_mblocks = fl.free_mblocks;
+            }
+
+            sum.huge_page_bytes = osHeapHugePageBytes();
+
+            sum.stable_ptr_minor_gc_visits = stable_ptr_minor_gc_visits;
+            sum.stable_name_minor_gc_visits = stable_name_minor_gc_visits;
+
             sum.average_bytes_used = stats.major_gcs == 0 ? 0 :
                  stats.cumulative_live_bytes/stats.major_gcs,
 
@@ -104,11 +104,37 @@ typedef struct RTSSummaryStats_ {
     uint64_t sparks_count;
     SparkCounters sparks;
     double work_balance;
+    // See Note [Growable WSDeque] in WSDeque.c
+    uint64_t spark_pool_resizes;
+    uint64_t todo_q_resizes;
+    uint64_t todo_q_overflows;
+    // See Note [NUMA-aware work stealing] in GCUtils.c
+    uint64_t gc_steals;
+    uint64_t gc_remote_steals;
+    // threads moved between capabilities, and how many crossed nodes
+    uint64_t thread_migrations;
+    uint64_t remote_thread_migrations;
+    // condition variable waits ended while spinning / after parking,
+    // see Note [Futex condition variables] in posix/OSThreads.c
+    uint64_t cond_waits_spun;
+    uint64_t cond_waits_parked;
 #else // THREADED_RTS
     double gc_cpu_percent;
     double gc_elapsed_percent;
 #endif
     uint64_t fragmentation_bytes;
+    // free block groups smaller than a megablock, at exit
+    uint64_t free_list_bytes;
+    uint64_t free_list_groups;
+    uint64_t largest_free_group_bytes;
+    // free megablocks not yet returned to the OS, at exit
+    uint64_t free_mblocks;
+    // heap memory backed by transparent huge pages, at exit
+    uint64_t huge_page_bytes;
+    // stable pointer table entries visited by minor GCs
+    uint64_t stable_ptr_minor_gc_visits;
+    // stable name table entries visited by minor GCs
+    uint64_t stable_name_minor_gc_visits;
     uint64_t average_bytes_used; // This is not shown in the '+RTS -s' report
     uint64_t alloc_rate;
     double productivity_cpu_percent;
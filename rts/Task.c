@@ -183,7 +183,7 @@ freeTask (Task *task)
     // a foreign call while we are attempting to shut down the
     // RTS (see conc059).
 #if defined(THREADED_RTS)
-    closeCondition(&task->cond);
+    closeSpinCondition(&task->cond);
     closeMutex(&task->lock);
 #endif
 
@@ -218,7 +218,7 @@ newTask (bool worker)
     task->preferred_capability = -1;
 
 #if defined(THREADED_RTS)
-    initCondition(&task->cond);
+    initSpinCondition(&task->cond);
     initMutex(&task->lock);
     task->id = 0;
     task->wakeup = false;
@@ -365,7 +365,7 @@ discardTasksExcept (Task *keep)
             // them). To avoid this, we re-initialize both the condition
             // variable and the mutex before calling `freeTask` (we do
             // precisely the same for all global locks in `forkProcess`).
-            initCondition(&task->cond);
+            initSpinCondition(&task->cond);
             initMutex(&task->lock);
 #endif
 
@@ -12,6 +12,7 @@
 #pragma once
 
 #include "GetTime.h"
+#include "SpinCondition.h"
 
 #include "BeginPrivate.h"
 
@@ -120,7 +121,7 @@ typedef struct Task_ {
     // rts_setInCallCapability().
     uint32_t node;
 
-    Condition cond;             // used for sleeping & waking up this task
+    SpinCondition cond;         // used for sleeping & waking up this task
     Mutex lock;                 // lock for the condition variable
 
     // this flag tells the task whether it should wait on task->cond
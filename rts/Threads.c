@@ -358,6 +358,9 @@ void
 migrateThread (Capability *from, StgTSO *tso, Capability *to)
 {
     traceEventMigrateThread (from, tso, to->no);
+#if defined(THREADED_RTS)
+    countMigration(from, to);
+#endif
     // ThreadMigrating tells the target cap that it needs to be added to
     // the run queue when it receives the MSG_TRY_WAKEUP.
     tso->why_blocked = ThreadMigrating;
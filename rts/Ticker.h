@@ -17,4 +17,10 @@ void startTicker (void);
 void stopTicker  (void);
 void exitTicker  (bool wait);
 
+// Deliver the next tick after the given timeout (> 0) rather than after
+// the usual interval, then carry on ticking at the usual rate.  A
+// startTicker() in the meantime cancels the delay.  Only called while
+// the ticker is running; see Note [Tickless idle] in Timer.c.
+void idleTicker  (Time timeout);
+
 #include "EndPrivate.h"
@@ -81,6 +81,129 @@ static int idle_ticks_to_gc = 0;
 /* - countdown for minimum time *between* idle GCs (set by -Iw) */
 static int inter_gc_ticks_to_gc = 0;
 
+/*
+ Note [Tickless idle]
+ --------------------
+
+ By default the ticker fires every -V interval for as long as the timer is
+ enabled, and each tick context-switches every capability.  A process that
+ has nothing to do therefore still wakes up 100 times a second until the
+ idle GC has run (or forever, with -I0 -Iw<n> or while profiling), which
+ adds up when many mostly-idle RTS processes share a host.
+
+ With +RTS --tickless the timer behaves differently in two ways:
+
+  * Preemption uses a per-capability deadline.  When a Task starts running
+    a Haskell thread it calls armPreemptionTimer(), which sets
+    cap->preempt_at to ctxtSwitchTicks ticks from now.  handle_tick() only
+    context-switches the capabilities that are running Haskell code and
+    whose deadline has passed, so a capability that has just picked up a
+    new thread gets its full time slice and idle capabilities are left
+    alone.
+
+  * When no capability is running Haskell code, handle_tick() does not wait
+    for the idle GC countdowns tick by tick.  Instead it asks the ticker
+    (idleTicker()) to deliver the next tick only once both countdowns will
+    have expired, and records the number of ticks that covers in
+    idle_tick_length; when that tick arrives the countdowns are advanced
+    by that many ticks at once.  If the idle GC is disabled the timer is stopped altogether,
+    as it is after an idle GC (see Note [GC During Idle Time]).
+
+ The ticker must be back at its regular rate as soon as Haskell code runs
+ again.  handle_tick() and armPreemptionTimer() synchronise on timer_idle
+ like this:
+
+     handle_tick                           armPreemptionTimer
+     -----------                           ------------------
+     idleTicker(wait)                      cap->in_haskell = true (earlier)
+     timer_idle = 1                        store_load_barrier()
+     store_load_barrier()                  if (timer_idle) resumeTimer()
+     if (any cap->in_haskell)
+         resumeTimer()
+
+ so at least one side sees the other's write, and resumeTimer() clears
+ timer_idle with a CAS so that only one of them calls startTicker().  At
+ worst the idle tick is followed by a redundant startTicker(), which is
+ harmless.
+
+ The time slice is measured in ticks, so it is only as accurate as the
+ tick interval; with -C0 there is no preemption at all, as before.  Heap
+ and cost-centre profiling need every tick, so in a profiled program
+ that is collecting samples the ticker never goes idle.
+*/
+
+/* - ticks delivered since initTimer(), used for preemption deadlines */
+static volatile StgWord timer_ticks = 0;
+
+/* - 1 if we asked the ticker for a single tick after idle_tick_length ticks */
+static volatile StgWord timer_idle = 0;
+static StgWord idle_tick_length = 0;
+
+static bool anyCapabilityInHaskell (void)
+{
+    uint32_t i;
+    for (i = 0; i < n_capabilities; i++) {
+        if (capabilities[i]->in_haskell) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void preemptCapabilities (void)
+{
+    uint32_t i;
+    Capability *cap;
+
+    for (i = 0; i < n_capabilities; i++) {
+        cap = capabilities[i];
+        if (cap->in_haskell
+            && (StgInt)(timer_ticks - cap->preempt_at) >= 0) {
+            contextSwitchCapability(cap);
+        }
+    }
+}
+
+/* Nothing is running Haskell code: stop ticking until the next idle GC
+ * countdown expires.  See Note [Tickless idle]. */
+static void tickerIdle (void)
+{
+    int wait;
+
+#if defined(PROFILING)
+    if (RtsFlags.ProfFlags.doHeapProfile || RtsFlags.CcFlags.doCostCentres) {
+        return;
+    }
+#endif
+
+    switch (recent_activity) {
+    case ACTIVITY_MAYBE_NO:
+        if (!RtsFlags.GcFlags.doIdleGC) {
+            recent_activity = ACTIVITY_DONE_GC;
+            stopTimer();
+            return;
+        }
+        wait = stg_max(idle_ticks_to_gc, inter_gc_ticks_to_gc);
+        if (wait <= 1) {
+            // the next regular tick will do
+            return;
+        }
+        break;
+    default:
+        // either we're waiting for the scheduler to do the idle GC, or
+        // the timer is about to be stopped.
+        return;
+    }
+
+    idle_tick_length = wait;
+    idleTicker(wait * RtsFlags.MiscFlags.tickInterval);
+    timer_idle = 1;
+    store_load_barrier();
+    if (anyCapabilityInHaskell()) {
+        resumeTimer();
+    }
+}
+
 /*
  * Function: handle_tick()
  *
@@ -91,8 +214,19 @@ static
 void
 handle_tick(int unused STG_UNUSED)
 {
+  int elapsed = 1;
+
   handleProfTick();
-  if (RtsFlags.ConcFlags.ctxtSwitchTicks > 0) {
+
+  if (RtsFlags.MiscFlags.tickless) {
+      if (timer_idle && cas(&timer_idle, 1, 0) == 1) {
+          elapsed = idle_tick_length;
+      }
+      timer_ticks += elapsed;
+      if (RtsFlags.ConcFlags.ctxtSwitchTicks > 0) {
+          preemptCapabilities();
+      }
+  } else if (RtsFlags.ConcFlags.ctxtSwitchTicks > 0) {
       ticks_to_ctxt_switch--;
       if (ticks_to_ctxt_switch <= 0) {
           ticks_to_ctxt_switch = RtsFlags.ConcFlags.ctxtSwitchTicks;
@@ -113,6 +247,11 @@ handle_tick(int unused STG_UNUSED)
                          RtsFlags.MiscFlags.tickInterval;
       break;
   case ACTIVITY_MAYBE_NO:
+      if (elapsed > 1) {
+          // we slept through the countdowns; see Note [Tickless idle]
+          idle_ticks_to_gc = stg_max(idle_ticks_to_gc - elapsed, 0);
+          inter_gc_ticks_to_gc = stg_max(inter_gc_ticks_to_gc - elapsed, 0);
+      }
       if (idle_ticks_to_gc == 0 && inter_gc_ticks_to_gc == 0) {
           if (RtsFlags.GcFlags.doIdleGC) {
               recent_activity = ACTIVITY_INACTIVE;
@@ -146,6 +285,10 @@ handle_tick(int unused STG_UNUSED)
   default:
       break;
   }
+
+  if (RtsFlags.MiscFlags.tickless && !anyCapabilityInHaskell()) {
+      tickerIdle();
+  }
 }
 
 // This global counter is used to allow multiple threads to stop the
@@ -172,6 +315,7 @@ startTimer(void)
 {
     if (atomic_dec(&timer_disabled) == 0) {
         if (RtsFlags.MiscFlags.tickInterval != 0) {
+            timer_idle = 0;
             startTicker();
         }
     }
@@ -187,6 +331,26 @@ stopTimer(void)
     }
 }
 
+/* Return to regular ticks after tickerIdle().  See Note [Tickless idle]. */
+void
+resumeTimer(void)
+{
+    if (cas(&timer_idle, 1, 0) == 1 && timer_disabled == 0) {
+        startTicker();
+    }
+}
+
+/* Called when cap starts running Haskell code, with --tickless. */
+void
+armPreemptionTimer(Capability *cap)
+{
+    cap->preempt_at = timer_ticks + RtsFlags.ConcFlags.ctxtSwitchTicks;
+    store_load_barrier();
+    if (timer_idle) {
+        resumeTimer();
+    }
+}
+
 void
 exitTimer (bool wait)
 {
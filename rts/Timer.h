@@ -10,3 +10,7 @@
 
 RTS_PRIVATE void initTimer (void);
 RTS_PRIVATE void exitTimer (bool wait);
+
+// Only used with --tickless; see Note [Tickless idle] in Timer.c
+RTS_PRIVATE void resumeTimer (void);
+RTS_PRIVATE void armPreemptionTimer (Capability *cap);
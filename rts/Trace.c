@@ -550,6 +550,23 @@ void traceSparkCounters_ (Capability *cap,
     }
 }
 
+void traceMessageCounters_ (Capability *cap,
+                            StgWord64 sent,
+                            StgWord64 batches,
+                            StgWord64 max_batch)
+{
+#if defined(DEBUG)
+    if (RtsFlags.TraceFlags.tracing == TRACE_STDERR) {
+        debugBelch("cap %d: sent %" FMT_Word64 " messages in %" FMT_Word64
+                   " batches, largest batch %" FMT_Word64 "\n",
+                   cap->no, sent, batches, max_batch);
+    } else
+#endif
+    {
+        postMessageCountersEvent(cap, sent, batches, max_batch);
+    }
+}
+
 void traceTaskCreate_ (Task       *task,
                        Capability *cap)
 {
@@ -805,16 +822,16 @@ void traceThreadLabel_(Capability *cap,
     }
 }
 
-void traceConcMarkBegin()
+void traceConcMarkBegin(StgWord32 worker)
 {
     if (eventlog_enabled)
-        postEventNoCap(EVENT_CONC_MARK_BEGIN);
+        postConcMarkBegin(worker);
 }
 
-void traceConcMarkEnd(StgWord32 marked_obj_count)
+void traceConcMarkEnd(StgWord32 worker, StgWord32 marked_obj_count)
 {
     if (eventlog_enabled)
-        postConcMarkEnd(marked_obj_count);
+        postConcMarkEnd(worker, marked_obj_count);
 }
 
 void traceConcSyncBegin()
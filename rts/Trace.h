@@ -281,6 +281,11 @@ void traceSparkCounters_ (Capability *cap,
                           SparkCounters counters,
                           StgWord remaining);
 
+void traceMessageCounters_ (Capability *cap,
+                            StgWord64 sent,
+                            StgWord64 batches,
+                            StgWord64 max_batch);
+
 void traceTaskCreate_ (Task       *task,
                        Capability *cap);
 
@@ -310,8 +315,8 @@ void traceProfSampleCostCentre(Capability *cap,
 void traceProfBegin(void);
 #endif /* PROFILING */
 
-void traceConcMarkBegin(void);
-void traceConcMarkEnd(StgWord32 marked_obj_count);
+void traceConcMarkBegin(StgWord32 worker);
+void traceConcMarkEnd(StgWord32 worker, StgWord32 marked_obj_count);
 void traceConcSyncBegin(void);
 void traceConcSyncEnd(void);
 void traceConcSweepBegin(void);
@@ -349,6 +354,7 @@ void flushTrace(void);
 #define traceWallClockTime_() /* nothing */
 #define traceOSProcessInfo_() /* nothing */
 #define traceSparkCounters_(cap, counters, remaining) /* nothing */
+#define traceMessageCounters_(cap, sent, batches, max_batch) /* nothing */
 #define traceTaskCreate_(taskID, cap) /* nothing */
 #define traceTaskMigrate_(taskID, cap, new_cap) /* nothing */
 #define traceTaskDelete_(taskID) /* nothing */
@@ -360,8 +366,8 @@ void flushTrace(void);
 #define traceHeapProfSampleCostCentre(profile_id, stack, residency) /* nothing */
 #define traceHeapProfSampleString(profile_id, label, residency) /* nothing */
 
-#define traceConcMarkBegin() /* nothing */
-#define traceConcMarkEnd(marked_obj_count) /* nothing */
+#define traceConcMarkBegin(worker) /* nothing */
+#define traceConcMarkEnd(worker, marked_obj_count) /* nothing */
 #define traceConcSyncBegin() /* nothing */
 #define traceConcSyncEnd() /* nothing */
 #define traceConcSweepBegin() /* nothing */
@@ -828,6 +834,16 @@ INLINE_HEADER void traceSparkCounters(Capability *cap STG_UNUSED)
 #endif
 }
 
+INLINE_HEADER void traceMessageCounters(Capability *cap STG_UNUSED)
+{
+#if defined(THREADED_RTS)
+    if (RTS_UNLIKELY(TRACE_sched)) {
+        traceMessageCounters_(cap, cap->messages_sent, cap->message_batches,
+                              cap->max_message_batch);
+    }
+#endif
+}
+
 INLINE_HEADER void traceEventSparkCreate(Capability *cap STG_UNUSED)
 {
     traceSparkEvent(cap, EVENT_SPARK_CREATE);
@@ -13,10 +13,11 @@
  *
  * Author: Jost Berthold MSRC 07-09/2008
  *
- * The DeQue is held as a circular array with known length. Positions
- * of top (read-end) and bottom (write-end) always increase, and the
- * array is accessed with indices modulo array-size. While this bears
- * the risk of overflow, we assume that (with 64 bit indices), a
+ * The DeQue is held as a circular array, which is replaced by one of
+ * twice the size when it fills up (see Note [Growable WSDeque]).
+ * Positions of top (read-end) and bottom (write-end) always increase,
+ * and the array is accessed with indices modulo array-size. While this
+ * bears the risk of overflow, we assume that (with 64 bit indices), a
  * program must run very long to reach that point.
  *
  * The write end of the queue (position bottom) can only be used with
@@ -46,6 +47,42 @@
 
 #define CASTOP(addr,old,new) ((old) == cas(((StgPtr)addr),(old),(new)))
 
+/* Note [Growable WSDeque]
+   ~~~~~~~~~~~~~~~~~~~~~~~
+   As in the Chase-Lev paper, a full deque is not an error: the owner
+   allocates an array of twice the size, copies the live elements
+   [top, bottom) across (at the same logical indices), and publishes
+   the new array before it publishes the element it is pushing.
+
+   Thieves may be running concurrently with a resize. This is safe
+   because
+
+    * The size and mask travel with the array (WSDequeArray), so a
+      thief that loaded the old array pointer indexes it consistently.
+
+    * The owner never writes to an array after it has been replaced, so
+      an element read from the old array is the same element that the
+      new array holds at that index. Whether the thief actually owns it
+      is decided by the cas on top, exactly as before.
+
+    * A thief loads top, then bottom, then the array pointer. If it
+      sees a bottom that covers an element pushed after the resize then
+      (because pushWSDeque issues a write barrier between publishing
+      the array and writing bottom) it also sees the new array.
+
+   Since a thief may still be reading a replaced array, we cannot free
+   it straight away. Instead it is put on the deque's retired list,
+   which freeWSDequeRetired() releases at a point where no stealing can
+   be in progress: at the end of each GC for the GC's todo queues, and
+   in pruneSparkQueue() for spark pools.
+
+   A deque may be given a maximum size, beyond which pushWSDeque fails
+   and the caller must deal with the element itself (the GC pushes the
+   block onto the workspace's todo_overflow list). The number of
+   resizes and failed pushes is recorded in the deque, and reported by
+   the '+RTS -s' summary.
+*/
+
 /* -----------------------------------------------------------------------------
  * newWSDeque
  * -------------------------------------------------------------------------- */
@@ -68,8 +105,21 @@ roundUp2(StgWord val)
     return rounded;
 }
 
+static WSDequeArray *
+allocWSDequeArray (StgWord size)
+{
+    WSDequeArray *a;
+
+    a = stgMallocBytes(sizeof(WSDequeArray) + size * sizeof(void *),
+                       "allocWSDequeArray");
+    a->size = size;  /* power of 2 */
+    a->moduloSize = size - 1; /* n % size == n & moduloSize  */
+    a->retired_link = NULL;
+    return a;
+}
+
 WSDeque *
-newWSDeque (uint32_t size)
+newWSDeque (uint32_t size, uint32_t max_size)
 {
     StgWord realsize;
     WSDeque *q;
@@ -78,14 +128,20 @@ newWSDeque (uint32_t size)
 
     q = (WSDeque*) stgMallocBytes(sizeof(WSDeque),   /* admin fields */
                                   "newWSDeque");
-    q->elements = stgMallocBytes(realsize * sizeof(StgClosurePtr), /* dataspace */
-                                 "newWSDeque:data space");
     q->top=0;
     q->bottom=0;
     q->topBound=0; /* read by writer, updated each time top is read */
 
-    q->size = realsize;  /* power of 2 */
-    q->moduloSize = realsize - 1; /* n % size == n & moduloSize  */
+    if (max_size == 0) {
+        q->maxSize = 0;
+    } else {
+        q->maxSize = stg_max(roundUp2(max_size), realsize);
+    }
+
+    q->array = allocWSDequeArray(realsize);
+    q->retired = NULL;
+    q->resizes = 0;
+    q->overflows = 0;
 
     ASSERT_WSDEQUE_INVARIANTS(q);
     return q;
@@ -95,13 +151,63 @@ newWSDeque (uint32_t size)
  * freeWSDeque
  * -------------------------------------------------------------------------- */
 
+void
+freeWSDequeRetired (WSDeque *q)
+{
+    WSDequeArray *a, *next;
+
+    for (a = q->retired; a != NULL; a = next) {
+        next = a->retired_link;
+        stgFree(a);
+    }
+    q->retired = NULL;
+}
+
 void
 freeWSDeque (WSDeque *q)
 {
-    stgFree(q->elements);
+    freeWSDequeRetired(q);
+    stgFree(q->array);
     stgFree(q);
 }
 
+/* -----------------------------------------------------------------------------
+ * growWSDeque: replace the array of a full deque by one of twice the
+ * size, holding the elements between t and b.  Returns false if the
+ * deque has already reached its maximum size.  Called by the owner only.
+ * See Note [Growable WSDeque].
+ * -------------------------------------------------------------------------- */
+
+static bool
+growWSDeque (WSDeque *q, StgWord t, StgWord b)
+{
+    WSDequeArray *old, *new;
+    StgWord i;
+
+    old = q->array;
+    if (q->maxSize != 0 && old->size * 2 > q->maxSize) {
+        return false;
+    }
+
+    new = allocWSDequeArray(old->size * 2);
+
+    // Thieves may advance top while we copy; copying elements they
+    // have already taken is harmless.
+    for (i = t; i != b; i++) {
+        new->elements[i & new->moduloSize] = old->elements[i & old->moduloSize];
+    }
+
+    // the copied elements must be visible before the new array is
+    write_barrier();
+    q->array = new;
+
+    old->retired_link = q->retired;
+    q->retired = old;
+    q->resizes++;
+
+    return true;
+}
+
 /* -----------------------------------------------------------------------------
  *
  * popWSDeque: remove an element from the write end of the queue.
@@ -123,6 +229,7 @@ popWSDeque (WSDeque *q)
     StgWord t, b;
     long  currSize;
     void * removed;
+    WSDequeArray *a;
 
     ASSERT_WSDEQUE_INVARIANTS(q);
 
@@ -147,8 +254,10 @@ popWSDeque (WSDeque *q)
         return NULL;
     }
 
-    // read the element at b
-    removed = q->elements[b & q->moduloSize];
+    // read the element at b; only we replace the array, so q->array
+    // is current
+    a = q->array;
+    removed = a->elements[b & a->moduloSize];
 
     if (currSize > 0) { /* no danger, still elements in buffer after b-- */
         // debugBelch("popWSDeque: t=%ld b=%ld = %ld\n", t, b, removed);
@@ -179,6 +288,7 @@ stealWSDeque_ (WSDeque *q)
 {
     void * stolen;
     StgWord b,t;
+    WSDequeArray *a;
 
 // Can't do this on someone else's spark pool:
 // ASSERT_WSDEQUE_INVARIANTS(q);
@@ -196,11 +306,13 @@ stealWSDeque_ (WSDeque *q)
         return NULL; /* already looks empty, abort */
     }
     // NB. the load of q->bottom must be ordered before the load of
-    // q->elements[t & q-> moduloSize]. See comment "KG:..." below
-    // and Ticket #13633.
+    // q->array and q->array->elements[t & moduloSize]. See comment
+    // "KG:..." below, Ticket #13633, and Note [Growable WSDeque].
+    load_load_barrier();
+    a = q->array;
     load_load_barrier();
     /* now access array, see pushBottom() */
-    stolen = q->elements[t & q->moduloSize];
+    stolen = a->elements[t & a->moduloSize];
 
     /* now decide whether we have won */
     if ( !(CASTOP(&(q->top),t,t+1)) ) {
@@ -228,20 +340,66 @@ stealWSDeque (WSDeque *q)
     return stolen;
 }
 
+/* Note [Stealing half a WSDeque]
+   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+   A thief that takes a single element has to come back to the victim
+   for every further one, so when one thread has lots of work and the
+   others have none (the usual shape of a parList), the others spend
+   their time stealing one element each from the same deque.  Taking
+   half of the elements instead lets the thief start its own supply of
+   work, which further thieves can then steal from in turn.
+
+   We cannot claim the whole batch with a single cas of top from t to
+   t+n: popWSDeque() only synchronises with thieves when it takes the
+   last element, on the assumption that top moves one element at a
+   time, so the owner could pop an element in [t, t+n) while we claim
+   it too.  Instead stealHalfWSDeque() sizes the batch from one
+   snapshot of top and bottom and then claims its elements one at a
+   time with stealWSDeque_(), stopping early if the deque empties or
+   it loses a race with another thief.
+*/
+
+uint32_t
+stealHalfWSDeque (WSDeque *q, void **out, uint32_t max)
+{
+    StgWord b,t;
+    long n;
+    uint32_t i;
+    void *stolen;
+
+    t = q->top;
+    load_load_barrier();
+    b = q->bottom;
+
+    // round up, so that we take the last element of a deque too
+    n = ((long)b - (long)t + 1) / 2;
+    if (n > (long)max) {
+        n = max;
+    }
+
+    for (i = 0; i < n; i++) {
+        stolen = stealWSDeque_(q);
+        if (stolen == NULL) {
+            break;
+        }
+        out[i] = stolen;
+    }
+
+    return i;
+}
+
 /* -----------------------------------------------------------------------------
  * pushWSQueue
  * -------------------------------------------------------------------------- */
 
-#define DISCARD_NEW
-
-/* enqueue an element. Should always succeed by resizing the array
-   (not implemented yet, silently fails in that case). */
+/* enqueue an element. Grows the array if it is full, and fails only if
+   the deque has reached its maximum size. */
 bool
 pushWSDeque (WSDeque* q, void * elem)
 {
     StgWord t;
     StgWord b;
-    StgWord sz = q->moduloSize;
+    WSDequeArray *a = q->array;
 
     ASSERT_WSDEQUE_INVARIANTS(q);
 
@@ -251,37 +409,27 @@ pushWSDeque (WSDeque* q, void * elem)
     */
     b = q->bottom;
     t = q->topBound;
-    if ( (StgInt)b - (StgInt)t >= (StgInt)sz ) {
-        /* NB. 1. sz == q->size - 1, thus ">="
+    if ( (StgInt)b - (StgInt)t >= (StgInt)a->moduloSize ) {
+        /* NB. 1. moduloSize == size - 1, thus ">="
            2. signed comparison, it is possible that t > b
         */
         /* could be full, check the real top value in this case */
         t = q->top;
         q->topBound = t;
-        if (b - t >= sz) { /* really no space left :-( */
-            /* reallocate the array, copying the values. Concurrent steal()s
-               will in the meantime use the old one and modify only top.
-               This means: we cannot safely free the old space! Can keep it
-               on a free list internally here...
-
-               Potential bug in combination with steal(): if array is
-               replaced, it is unclear which one concurrent steal operations
-               use. Must read the array base address in advance in steal().
-            */
-#if defined(DISCARD_NEW)
-            ASSERT_WSDEQUE_INVARIANTS(q);
-            return false; // we didn't push anything
-#else
-            /* could make room by incrementing the top position here.  In
-             * this case, should use CASTOP. If this fails, someone else has
-             * removed something, and new room will be available.
-             */
-            ASSERT_WSDEQUE_INVARIANTS(q);
-#endif
+        if (b - t >= a->moduloSize) {
+            /* really no space left: replace the array by a bigger
+               one. Concurrent steal()s may in the meantime use the
+               old one; see Note [Growable WSDeque]. */
+            if (!growWSDeque(q, t, b)) {
+                q->overflows++;
+                ASSERT_WSDEQUE_INVARIANTS(q);
+                return false; // we didn't push anything
+            }
+            a = q->array;
         }
     }
 
-    q->elements[b & sz] = elem;
+    a->elements[b & a->moduloSize] = elem;
     /*
        KG: we need to put write barrier here since otherwise we might
        end with elem not added to q->elements, but q->bottom already
@@ -8,12 +8,24 @@
 
 #pragma once
 
-typedef struct WSDeque_ {
+// The circular array holding the elements of a WSDeque. The size lives
+// alongside the elements, so that a thief which has loaded a (possibly
+// stale) array pointer always indexes it with the matching mask. See
+// Note [Growable WSDeque] in WSDeque.c.
+typedef struct WSDequeArray_ {
     // Size of elements array. Used for modulo calculation: we round up
     // to powers of 2 and use the dyadic log (modulo == bitwise &)
     StgWord size;
     StgWord moduloSize; /* bitmask for modulo */
 
+    // Link for the deque's list of retired arrays
+    struct WSDequeArray_ *retired_link;
+
+    // The elements
+    void *elements[];
+} WSDequeArray;
+
+typedef struct WSDeque_ {
     // top, index where multiple readers steal() (protected by a cas)
     volatile StgWord top;
 
@@ -29,12 +41,22 @@ typedef struct WSDeque_ {
     // inside pushBottom
     volatile StgWord topBound;
 
-    // The elements array
-    void ** elements;
+    // The current elements array. Replaced (never modified in place
+    // after being replaced) by pushWSDeque when the deque is full.
+    WSDequeArray * volatile array;
 
-    //  Please note: the dataspace cannot follow the admin fields
-    //  immediately, as it should be possible to enlarge it without
-    //  disposing the old one automatically (as realloc would)!
+    // The size beyond which the array is not grown, or 0 for no limit.
+    StgWord maxSize;
+
+    // Arrays replaced by a resize. Concurrent thieves may still be
+    // reading these, so they are only freed by freeWSDequeRetired()
+    // when no stealing is going on.
+    WSDequeArray *retired;
+
+    // Counters, updated by the owner only
+    StgWord resizes;    // number of times the array was grown
+    StgWord overflows;  // number of pushes that failed because the
+                        // deque was full and could not grow
 
 } WSDeque;
 
@@ -45,12 +67,14 @@ typedef struct WSDeque_ {
    current thread, or (b) when there's only one thread running, or no
    stealing going on (e.g. during GC).
 */
-#define ASSERT_WSDEQUE_INVARIANTS(p)         \
-  ASSERT((p)->size > 0);                        \
-  ASSERT((p)->topBound <= (p)->top);            \
-  ASSERT((p)->elements != NULL);                \
-  ASSERT(*((p)->elements) || 1);                \
-  ASSERT(*((p)->elements - 1  + ((p)->size)) || 1);
+#define ASSERT_WSDEQUE_INVARIANTS(p)                                    \
+  ASSERT((p)->array != NULL);                                           \
+  ASSERT((p)->array->size > 0);                                         \
+  ASSERT((p)->array->moduloSize == (p)->array->size - 1);               \
+  ASSERT((p)->maxSize == 0 || (p)->array->size <= (p)->maxSize);        \
+  ASSERT((p)->topBound <= (p)->top);                                    \
+  ASSERT(*((p)->array->elements) || 1);                                 \
+  ASSERT(*((p)->array->elements - 1  + ((p)->array->size)) || 1);
 
 // No: it is possible that top > bottom when using pop()
 //  ASSERT((p)->bottom >= (p)->top);
@@ -61,20 +85,28 @@ typedef struct WSDeque_ {
  *
  * A WSDeque has an *owner* thread.  The owner can perform any operation;
  * other threads are only allowed to call stealWSDeque_(),
- * stealWSDeque(), looksEmptyWSDeque(), and dequeElements().
+ * stealWSDeque(), stealHalfWSDeque(), looksEmptyWSDeque(), and
+ * dequeElements().
  *
  * -------------------------------------------------------------------------- */
 
-// Allocation, deallocation
-WSDeque * newWSDeque  (uint32_t size);
+// Allocation, deallocation. The deque starts with room for size
+// elements and grows on demand up to max_size elements (0 means the
+// deque may grow without limit).
+WSDeque * newWSDeque  (uint32_t size, uint32_t max_size);
 void      freeWSDeque (WSDeque *q);
 
+// Free the arrays retired by earlier resizes.  Must only be called
+// when no thread can be stealing from the deque (e.g. during GC).
+void      freeWSDequeRetired (WSDeque *q);
+
 // Take an element from the "write" end of the pool.  Can be called
 // by the pool owner only.
 void* popWSDeque (WSDeque *q);
 
-// Push onto the "write" end of the pool.  Return true if the push
-// succeeded, or false if the deque is full.
+// Push onto the "write" end of the pool, growing the deque if
+// necessary.  Return true if the push succeeded, or false if the
+// deque is full and has already reached its maximum size.
 bool pushWSDeque (WSDeque *q, void *elem);
 
 // Removes all elements from the deque
@@ -89,6 +121,11 @@ void * stealWSDeque_ (WSDeque *q);
 // NULL if the pool is empty.
 void * stealWSDeque (WSDeque *q);
 
+// Removes up to half of the elements of the deque (and at most max)
+// from the "read" end into out[], returning how many were removed.
+// See Note [Stealing half a WSDeque].
+uint32_t stealHalfWSDeque (WSDeque *q, void **out, uint32_t max);
+
 // "guesses" whether a deque is empty. Can return false negatives in
 //  presence of concurrent steal() calls, and false positives in
 //  presence of a concurrent pushBottom().
@@ -119,7 +119,8 @@ char *EventDesc[] = {
   [EVENT_CONC_SWEEP_BEGIN]       = "Begin concurrent sweep",
   [EVENT_CONC_SWEEP_END]         = "End concurrent sweep",
   [EVENT_CONC_UPD_REM_SET_FLUSH] = "Update remembered set flushed",
-  [EVENT_NONMOVING_HEAP_CENSUS]  = "Nonmoving heap census"
+  [EVENT_NONMOVING_HEAP_CENSUS]  = "Nonmoving heap census",
+  [EVENT_MESSAGE_COUNTERS]       = "Message counters"
 };
 
 // Event type.
@@ -466,7 +467,6 @@ init_event_types(void)
             eventTypes[t].size = EVENT_SIZE_DYNAMIC;
             break;
 
-        case EVENT_CONC_MARK_BEGIN:
         case EVENT_CONC_SYNC_BEGIN:
         case EVENT_CONC_SYNC_END:
         case EVENT_CONC_SWEEP_BEGIN:
@@ -474,10 +474,14 @@ init_event_types(void)
             eventTypes[t].size = 0;
             break;
 
-        case EVENT_CONC_MARK_END:
+        case EVENT_CONC_MARK_BEGIN: // (worker)
             eventTypes[t].size = 4;
             break;
 
+        case EVENT_CONC_MARK_END: // (worker, marked_obj_count)
+            eventTypes[t].size = 8;
+            break;
+
         case EVENT_CONC_UPD_REM_SET_FLUSH: // (cap)
             eventTypes[t].size =
                 sizeof(EventCapNo);
@@ -487,6 +491,10 @@ init_event_types(void)
             eventTypes[t].size = 13;
             break;
 
+        case EVENT_MESSAGE_COUNTERS: // (cap, 3*counter)
+            eventTypes[t].size = 3 * sizeof(StgWord64);
+            break;
+
         default:
             continue; /* ignore deprecated events */
         }
@@ -783,6 +791,22 @@ postSparkCountersEvent (Capability *cap,
     postWord64(eb,remaining);
 }
 
+void
+postMessageCountersEvent (Capability *cap,
+                          StgWord64 sent,
+                          StgWord64 batches,
+                          StgWord64 max_batch)
+{
+    EventsBuf *eb = &capEventBuf[cap->no];
+    ensureRoomForEvent(eb, EVENT_MESSAGE_COUNTERS);
+
+    postEventHeader(eb, EVENT_MESSAGE_COUNTERS);
+    /* EVENT_MESSAGE_COUNTERS (sent, batches, max_batch) */
+    postWord64(eb,sent);
+    postWord64(eb,batches);
+    postWord64(eb,max_batch);
+}
+
 void
 postCapEvent (EventTypeNum  tag,
               EventCapNo    capno)
@@ -1229,11 +1253,21 @@ void postConcUpdRemSetFlush(Capability *cap)
     postCapNo(eb, cap->no);
 }
 
-void postConcMarkEnd(StgWord32 marked_obj_count)
+void postConcMarkBegin(StgWord32 worker)
+{
+    ACQUIRE_LOCK(&eventBufMutex);
+    ensureRoomForEvent(&eventBuf, EVENT_CONC_MARK_BEGIN);
+    postEventHeader(&eventBuf, EVENT_CONC_MARK_BEGIN);
+    postWord32(&eventBuf, worker);
+    RELEASE_LOCK(&eventBufMutex);
+}
+
+void postConcMarkEnd(StgWord32 worker, StgWord32 marked_obj_count)
 {
     ACQUIRE_LOCK(&eventBufMutex);
     ensureRoomForEvent(&eventBuf, EVENT_CONC_MARK_END);
     postEventHeader(&eventBuf, EVENT_CONC_MARK_END);
+    postWord32(&eventBuf, worker);
     postWord32(&eventBuf, marked_obj_count);
     RELEASE_LOCK(&eventBufMutex);
 }
@@ -98,6 +98,15 @@ void postSparkCountersEvent (Capability *cap,
                              SparkCounters counters,
                              StgWord remaining);
 
+/*
+ * Post an event with the counters of messages sent to other Capabilities
+ * (see Note [Batched messages] in Messages.c)
+ */
+void postMessageCountersEvent (Capability *cap,
+                               StgWord64 sent,
+                               StgWord64 batches,
+                               StgWord64 max_batch);
+
 /*
  * Post an event to annotate a thread with a label
  */
@@ -169,7 +178,8 @@ void postProfBegin(void);
 #endif /* PROFILING */
 
 void postConcUpdRemSetFlush(Capability *cap);
-void postConcMarkEnd(StgWord32 marked_obj_count);
+void postConcMarkBegin(StgWord32 worker);
+void postConcMarkEnd(StgWord32 worker, StgWord32 marked_obj_count);
 void postNonmovingHeapCensus(int log_blk_size,
                              const struct NonmovingAllocCensus *census);
 
@@ -939,11 +939,14 @@ ocGetNames_ELF ( ObjectCode* oc )
                        if (isWeak == HS_BOOL_TRUE) {
                            setWeakSymbol(oc, nm);
                        }
-                       if (!ghciInsertSymbolTable(oc->fileName, symhash,
-                                                  nm, symbol->addr, isWeak, oc)
+                       StgWord hash = strHash(nm);
+                       if (!ghciInsertSymbolTableHashed(oc->fileName, symhash,
+                                                        nm, hash, symbol->addr,
+                                                        isWeak, oc)
                            ) {
                            goto fail;
                        }
+                       oc->symbols[curSymbol].hash = hash;
                        oc->symbols[curSymbol++].name = nm;
                        oc->symbols[curSymbol].addr = symbol->addr;
                    }
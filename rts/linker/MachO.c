@@ -1338,7 +1338,7 @@ ocGetNames_MachO(ObjectCode* oc)
      */
     IF_DEBUG(linker, debugBelch("ocGetNames_MachO: %d external symbols\n",
                                 oc->n_symbols));
-    oc->symbols = stgMallocBytes(oc->n_symbols * sizeof(Symbol_t),
+    oc->symbols = stgCallocBytes(oc->n_symbols, sizeof(Symbol_t),
                                    "ocGetNames_MachO(oc->symbols)");
 
     if (oc->info->symCmd) {
@@ -1361,16 +1361,19 @@ ocGetNames_MachO(ObjectCode* oc)
                     {
                             IF_DEBUG(linker, debugBelch("ocGetNames_MachO: inserting %s\n", nm));
                             SymbolAddr* addr = oc->info->macho_symbols[i].addr;
+                            StgWord hash = strHash(nm);
 
-                            ghciInsertSymbolTable( oc->fileName
-                                                 , symhash
-                                                 , nm
-                                                 , addr
-                                                 , HS_BOOL_FALSE
-                                                 , oc);
+                            ghciInsertSymbolTableHashed( oc->fileName
+                                                       , symhash
+                                                       , nm
+                                                       , hash
+                                                       , addr
+                                                       , HS_BOOL_FALSE
+                                                       , oc);
 
                             oc->symbols[curSymbol].name = nm;
                             oc->symbols[curSymbol].addr = addr;
+                            oc->symbols[curSymbol].hash = hash;
                             curSymbol++;
                     }
                 }
@@ -1405,10 +1408,13 @@ ocGetNames_MachO(ObjectCode* oc)
                 oc->info->macho_symbols[i].addr = (void*)commonCounter;
 
                 IF_DEBUG(linker, debugBelch("ocGetNames_MachO: inserting common symbol: %s\n", nm));
-                ghciInsertSymbolTable(oc->fileName, symhash, nm,
-                                       (void*)commonCounter, HS_BOOL_FALSE, oc);
+                StgWord hash = strHash(nm);
+                ghciInsertSymbolTableHashed(oc->fileName, symhash, nm, hash,
+                                            (void*)commonCounter,
+                                            HS_BOOL_FALSE, oc);
                 oc->symbols[curSymbol].name = nm;
                 oc->symbols[curSymbol].addr = oc->info->macho_symbols[i].addr;
+                oc->symbols[curSymbol].hash = hash;
                 curSymbol++;
 
                 commonCounter += sz;
@@ -1763,8 +1763,9 @@ ocGetNames_PEi386 ( ObjectCode* oc )
              setWeakSymbol(oc, sname);
          }
 
-         if (! ghciInsertSymbolTable(oc->fileName, symhash, sname, addr,
-                                     isWeak, oc))
+         if (! ghciInsertSymbolTableHashed(oc->fileName, symhash, sname,
+                                           symbolHash(&oc->symbols[i]), addr,
+                                           isWeak, oc))
              return false;
       } else {
           /* We're skipping the symbol, but if we ever load this
@@ -0,0 +1,654 @@
+/* -----------------------------------------------------------------------------
+ *
+ * (c) The GHC Team, 2020
+ *
+ * Per-Capability io_uring rings.
+ *
+ * See Note [io_uring IO manager].
+ *
+ * ---------------------------------------------------------------------------*/
+
+#include "PosixSource.h"
+
+#if defined(linux_HOST_OS)
+/* for syscall() and MAP_POPULATE */
+#define _GNU_SOURCE 1
+#endif
+
+#include "Rts.h"
+
+#include "RtsUtils.h"
+#include "Capability.h"
+#include "Task.h"
+#include "Threads.h"
+#include "Prelude.h"
+#include "StablePtr.h"
+#include "IOUring.h"
+
+#include <errno.h>
+
+#if defined(RTS_IO_URING)
+
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <string.h>
+
+/* Note [io_uring IO manager]
+   ~~~~~~~~~~~~~~~~~~~~~~~~~~
+   In the threaded RTS on Linux each Capability can have an io_uring,
+   created the first time a thread running on it calls ioUringPollFd or
+   ioUringTimeout.  A request names an MVar (through a StablePtr, as with
+   hs_try_putmvar), and when it completes the RTS does tryPutMVar on it
+   and frees the StablePtr.  The Haskell side is therefore just
+
+       sp <- newStablePtrPrimMVar mvar
+       ioUringPollFd fd events sp   -- an unsafe foreign call
+       takeMVar mvar
+
+   and the thread is woken directly by the RTS, with no IO manager
+   thread or timer manager thread in between.
+
+   Submission is batched.  A request made by the Task that owns the
+   Capability only fills in a submission queue entry; the scheduler
+   passes everything queued to the kernel with one io_uring_enter call
+   in processIOUringCompletions, which it runs next to
+   scheduleProcessInbox, and which also reaps completions.  It waits for
+   ring->lock only when it has requests to submit; otherwise, if the
+   completion thread holds the lock, it leaves the reaping to that.  Reaping only
+   reads the completion ring in shared memory, so it costs no system call
+   when nothing has completed, and a woken thread goes straight onto the
+   run queue with performTryPutMVar.  A request made from anywhere else
+   (a safe foreign call, or a cancellation aimed at another Capability's
+   ring) is submitted at once, because that Capability may be idle.
+
+   An idle Capability doesn't run the scheduler loop, so each ring also
+   has a completion thread that sleeps in io_uring_enter waiting for a
+   completion.  Whichever of the scheduler and the completion thread gets
+   to a completion first delivers it; the completion thread uses
+   hs_try_putmvar, which runs the tryPutMVar immediately when the
+   Capability is free.  ring->lock serialises the two consumers, and all
+   producers, so any OS thread may use any ring.
+
+   Each request is identified by a 64-bit id, which is also the
+   user_data of its submission: the ring's Capability number, the index
+   of the request's slot in ring->ops, and a generation number that
+   changes whenever a slot is reused, so a stale id can never cancel a
+   later request.  Cancellation is asynchronous: the cancelled request
+   completes (with -ECANCELED) and its MVar is filled as usual, so a
+   woken thread should always check whether what it waited for has
+   actually happened, just as with threadWaitRead.
+*/
+
+#define IO_URING_ENTRIES 256
+
+// Most completions that we deliver in one go without holding ring->lock.
+#define IO_URING_REAP_BATCH 64
+
+// user_data of requests whose completion we ignore (cancellations, and
+// the request that wakes a completion thread up to stop it)
+#define IO_URING_NO_ID 0
+
+#define ID_SLOT(id)       ((uint32_t)((id) & 0xffffffff))
+#define ID_CAP(id)        ((uint32_t)(((id) >> 32) & 0xffff))
+#define ID_GENERATION(id) ((uint16_t)((id) >> 48))
+#define MK_ID(gen,cap,slot) \
+    (((StgWord64)(gen) << 48) | ((StgWord64)(cap) << 32) | (StgWord64)(slot))
+
+#define NO_FREE_OP 0xffffffff
+
+typedef struct {
+    HsStablePtr mvar;        // NULL when the slot is free
+    uint32_t    next_free;
+    uint16_t    generation;
+} IOUringOp;
+
+typedef struct IOUring_ {
+    Capability *cap;
+    int         fd;
+    // The completion thread; exitIOUrings joins it.
+    pthread_t   thread;
+
+    // Protects everything below, including the rings themselves.
+    Mutex       lock;
+    bool        stopping;
+
+    // Submission queue, shared with the kernel
+    void       *sq_ring;
+    size_t      sq_ring_size;
+    volatile uint32_t *sq_head;
+    volatile uint32_t *sq_tail;
+    uint32_t    sq_mask;
+    uint32_t    sq_entries;
+    uint32_t   *sq_array;
+    struct io_uring_sqe *sqes;
+    size_t      sqes_size;
+    // The kernel reads a timeout's timespec when the request is
+    // submitted, so we keep one per submission queue entry.
+    struct __kernel_timespec *sq_timeouts;
+    uint32_t    to_submit;
+
+    // Completion queue, shared with the kernel
+    void       *cq_ring;
+    size_t      cq_ring_size;
+    volatile uint32_t *cq_head;
+    volatile uint32_t *cq_tail;
+    uint32_t    cq_mask;
+    struct io_uring_cqe *cqes;
+
+    // Outstanding requests
+    IOUringOp  *ops;
+    uint32_t    n_ops;
+    uint32_t    free_op;
+} IOUring;
+
+static int io_uring_setup_ (uint32_t entries, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int io_uring_enter_ (int fd, uint32_t to_submit,
+                            uint32_t min_complete, uint32_t flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+                        flags, NULL, 0);
+}
+
+static void freeIOUring (IOUring *ring)
+{
+    if (ring->sqes != NULL && ring->sqes != MAP_FAILED) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_ring != NULL && ring->cq_ring != MAP_FAILED
+        && ring->cq_ring != ring->sq_ring) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    if (ring->sq_ring != NULL && ring->sq_ring != MAP_FAILED) {
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    }
+    if (ring->fd >= 0) {
+        close(ring->fd);
+    }
+    if (ring->sq_timeouts != NULL) {
+        stgFree(ring->sq_timeouts);
+    }
+    if (ring->ops != NULL) {
+        stgFree(ring->ops);
+    }
+    closeMutex(&ring->lock);
+    stgFree(ring);
+}
+
+/*
+ * Hand the queued submissions to the kernel.  Called with ring->lock held.
+ */
+static void submitIOUring (IOUring *ring)
+{
+    int r;
+
+    while (ring->to_submit > 0) {
+        r = io_uring_enter_(ring->fd, ring->to_submit, 0, 0);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            // EAGAIN/EBUSY: the kernel is short of resources, or the
+            // completion ring is full.  Try again on the next call.
+            if (errno == EAGAIN || errno == EBUSY) return;
+            sysErrorBelch("io_uring_enter");
+            stg_exit(EXIT_FAILURE);
+        }
+        ring->to_submit -= r;
+    }
+}
+
+static HsStablePtr takeOp (IOUring *ring, StgWord64 id)
+{
+    IOUringOp *op;
+    HsStablePtr mvar;
+    uint32_t slot = ID_SLOT(id);
+
+    if (id == IO_URING_NO_ID || slot >= ring->n_ops) return NULL;
+    op = &ring->ops[slot];
+    if (op->mvar == NULL || op->generation != ID_GENERATION(id)) return NULL;
+
+    mvar = op->mvar;
+    op->mvar = NULL;
+    op->next_free = ring->free_op;
+    ring->free_op = slot;
+    return mvar;
+}
+
+/*
+ * Take up to max completed requests off the completion ring.  Called
+ * with ring->lock held.
+ */
+static uint32_t reapIOUring (IOUring *ring, HsStablePtr *mvars, uint32_t max)
+{
+    uint32_t head, tail, n = 0;
+    HsStablePtr mvar;
+
+    head = *ring->cq_head;
+    tail = *ring->cq_tail;
+    load_load_barrier();
+
+    while (head != tail && n < max) {
+        mvar = takeOp(ring, ring->cqes[head & ring->cq_mask].user_data);
+        if (mvar != NULL) {
+            mvars[n++] = mvar;
+        }
+        head++;
+    }
+
+    // the kernel mustn't reuse the entries until we've read them
+    store_load_barrier();
+    *ring->cq_head = head;
+    return n;
+}
+
+static void *ioUringCompletionThread (void *arg)
+{
+    IOUring *ring = (IOUring *)arg;
+    HsStablePtr mvars[IO_URING_REAP_BATCH];
+    uint32_t i, n;
+    int r;
+
+    for (;;) {
+        r = io_uring_enter_(ring->fd, 0, 1, IORING_ENTER_GETEVENTS);
+        if (r < 0 && errno != EINTR) {
+            sysErrorBelch("io_uring_enter");
+            stg_exit(EXIT_FAILURE);
+        }
+
+        ACQUIRE_LOCK(&ring->lock);
+        if (ring->stopping) {
+            RELEASE_LOCK(&ring->lock);
+            break;
+        }
+        n = reapIOUring(ring, mvars, IO_URING_REAP_BATCH);
+        RELEASE_LOCK(&ring->lock);
+
+        for (i = 0; i < n; i++) {
+            hs_try_putmvar(ring->cap->no, mvars[i]);
+        }
+    }
+
+    freeMyTask();
+    return NULL;
+}
+
+static IOUring *newIOUring (Capability *cap)
+{
+    struct io_uring_params p;
+    IOUring *ring;
+    int fd;
+
+    memset(&p, 0, sizeof(p));
+    fd = io_uring_setup_(IO_URING_ENTRIES, &p);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    ring = stgCallocBytes(1, sizeof(IOUring), "newIOUring");
+    ring->cap = cap;
+    ring->fd = fd;
+    ring->free_op = NO_FREE_OP;
+    initMutex(&ring->lock);
+
+    ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+    ring->cq_ring_size = p.cq_off.cqes
+        + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_size > ring->sq_ring_size) {
+            ring->sq_ring_size = ring->cq_ring_size;
+        }
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) goto fail;
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) goto fail;
+    }
+
+    ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) goto fail;
+
+    ring->sq_head    = (uint32_t *)((char *)ring->sq_ring + p.sq_off.head);
+    ring->sq_tail    = (uint32_t *)((char *)ring->sq_ring + p.sq_off.tail);
+    ring->sq_mask    = *(uint32_t *)((char *)ring->sq_ring + p.sq_off.ring_mask);
+    ring->sq_entries = p.sq_entries;
+    ring->sq_array   = (uint32_t *)((char *)ring->sq_ring + p.sq_off.array);
+    ring->sq_timeouts = stgCallocBytes(p.sq_entries,
+                                       sizeof(struct __kernel_timespec),
+                                       "newIOUring");
+
+    ring->cq_head = (uint32_t *)((char *)ring->cq_ring + p.cq_off.head);
+    ring->cq_tail = (uint32_t *)((char *)ring->cq_ring + p.cq_off.tail);
+    ring->cq_mask = *(uint32_t *)((char *)ring->cq_ring + p.cq_off.ring_mask);
+    ring->cqes    = (struct io_uring_cqe *)((char *)ring->cq_ring
+                                            + p.cq_off.cqes);
+
+    // Not createOSThread, which detaches the thread: exitIOUrings must be
+    // able to join it.
+    if (pthread_create(&ring->thread, NULL, ioUringCompletionThread,
+                       ring) != 0) {
+        goto fail;
+    }
+#if defined(HAVE_PTHREAD_SETNAME_NP)
+    pthread_setname_np(ring->thread, "ghc_io_uring");
+#endif
+    return ring;
+
+fail:
+    freeIOUring(ring);
+    return NULL;
+}
+
+/*
+ * The ring of the Capability that the calling Task owns, created if
+ * necessary, or NULL with errno set.  *own is set if the caller owns the
+ * Capability, so that submission can be left to the scheduler.
+ */
+static IOUring *myIOUring (bool *own)
+{
+    Task *task = myTask();
+    Capability *cap;
+    IOUring *ring;
+
+    if (task == NULL || task->cap == NULL) {
+        cap = capabilities[0];
+        *own = false;
+    } else {
+        cap = task->cap;
+        *own = cap->running_task == task;
+    }
+
+    ring = cap->io_uring;
+    if (ring != NULL) {
+        return ring;
+    }
+    if (!*own) {
+        // Only the owner may install the ring, so that two Tasks don't
+        // race to do it.
+        errno = EAGAIN;
+        return NULL;
+    }
+
+    ring = newIOUring(cap);
+    if (ring == NULL) {
+        if (errno == 0) errno = ENOSYS;
+        return NULL;
+    }
+    write_barrier();
+    cap->io_uring = ring;
+    return ring;
+}
+
+/*
+ * Get a free submission queue entry, or NULL.  Called with ring->lock
+ * held.
+ */
+static struct io_uring_sqe *getSqe (IOUring *ring, uint32_t *idx)
+{
+    uint32_t tail = *ring->sq_tail;
+
+    if (tail - *ring->sq_head >= ring->sq_entries) {
+        // full: hand what we have to the kernel and look again
+        submitIOUring(ring);
+        load_load_barrier();
+        if (tail - *ring->sq_head >= ring->sq_entries) {
+            return NULL;
+        }
+    }
+    *idx = tail & ring->sq_mask;
+    memset(&ring->sqes[*idx], 0, sizeof(struct io_uring_sqe));
+    return &ring->sqes[*idx];
+}
+
+/*
+ * Publish the entry filled in by getSqe.  Called with ring->lock held.
+ */
+static void pushSqe (IOUring *ring, uint32_t idx, bool own)
+{
+    ring->sq_array[idx] = idx;
+    write_barrier();
+    *ring->sq_tail = *ring->sq_tail + 1;
+    ring->to_submit++;
+    if (!own) {
+        submitIOUring(ring);
+    }
+}
+
+static StgWord64 newOp (IOUring *ring, HsStablePtr mvar)
+{
+    IOUringOp *op;
+    uint32_t slot;
+
+    if (ring->free_op == NO_FREE_OP) {
+        uint32_t i, n = ring->n_ops == 0 ? 64 : ring->n_ops * 2;
+        ring->ops = stgReallocBytes(ring->ops, n * sizeof(IOUringOp),
+                                    "ioUring newOp");
+        for (i = ring->n_ops; i < n; i++) {
+            ring->ops[i].mvar = NULL;
+            ring->ops[i].generation = 0;
+            ring->ops[i].next_free = i + 1 < n ? i + 1 : NO_FREE_OP;
+        }
+        ring->free_op = ring->n_ops;
+        ring->n_ops = n;
+    }
+
+    slot = ring->free_op;
+    op = &ring->ops[slot];
+    ring->free_op = op->next_free;
+    op->mvar = mvar;
+    // generation 0 is never used, so that no id is IO_URING_NO_ID
+    op->generation++;
+    if (op->generation == 0) op->generation = 1;
+    return MK_ID(op->generation, ring->cap->no, slot);
+}
+
+static StgWord64 submitOp (uint8_t opcode, int fd, uint32_t poll_events,
+                           StgWord64 usecs, HsStablePtr mvar)
+{
+    IOUring *ring;
+    struct io_uring_sqe *sqe;
+    uint32_t idx;
+    StgWord64 id;
+    bool own;
+
+    ring = myIOUring(&own);
+    if (ring == NULL) {
+        return 0;
+    }
+
+    ACQUIRE_LOCK(&ring->lock);
+    sqe = getSqe(ring, &idx);
+    if (sqe == NULL) {
+        RELEASE_LOCK(&ring->lock);
+        errno = EBUSY;
+        return 0;
+    }
+    id = newOp(ring, mvar);
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->user_data = id;
+    if (opcode == IORING_OP_POLL_ADD) {
+        sqe->poll_events = (uint16_t)poll_events;
+    } else {
+        ring->sq_timeouts[idx].tv_sec  = usecs / 1000000;
+        ring->sq_timeouts[idx].tv_nsec = (usecs % 1000000) * 1000;
+        sqe->addr = (uint64_t)(uintptr_t)&ring->sq_timeouts[idx];
+        sqe->len = 1;
+    }
+    pushSqe(ring, idx, own);
+    RELEASE_LOCK(&ring->lock);
+    return id;
+}
+
+StgWord64 ioUringPollFd (int fd, uint32_t events, HsStablePtr mvar)
+{
+    return submitOp(IORING_OP_POLL_ADD, fd, events, 0, mvar);
+}
+
+StgWord64 ioUringTimeout (StgWord64 usecs, HsStablePtr mvar)
+{
+    return submitOp(IORING_OP_TIMEOUT, -1, 0, usecs, mvar);
+}
+
+int ioUringCancel (StgWord64 id)
+{
+    IOUring *ring;
+    struct io_uring_sqe *sqe;
+    uint32_t idx;
+    Task *task = myTask();
+    bool own;
+
+    if (ID_CAP(id) >= n_capabilities) {
+        errno = EINVAL;
+        return -1;
+    }
+    ring = capabilities[ID_CAP(id)]->io_uring;
+    if (ring == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    own = task != NULL && task->cap == ring->cap
+        && ring->cap->running_task == task;
+
+    ACQUIRE_LOCK(&ring->lock);
+    sqe = getSqe(ring, &idx);
+    if (sqe == NULL) {
+        RELEASE_LOCK(&ring->lock);
+        errno = EBUSY;
+        return -1;
+    }
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = id;
+    sqe->user_data = IO_URING_NO_ID;
+    pushSqe(ring, idx, own);
+    RELEASE_LOCK(&ring->lock);
+    return 0;
+}
+
+void processIOUringCompletions (Capability *cap)
+{
+    IOUring *ring = cap->io_uring;
+    HsStablePtr mvars[IO_URING_REAP_BATCH];
+    uint32_t i, n;
+
+    if (ring == NULL) {
+        return;
+    }
+
+    do {
+        // Don't wait for the completion thread just to reap: we'll look
+        // again later.  But if we have queued requests we must submit
+        // them now, because nothing else will: the completion thread only
+        // waits for completions, and this Capability may be about to go
+        // idle.  Only this Task adds to to_submit for its own requests,
+        // so the unlocked read sees all of them.
+        if (TRY_ACQUIRE_LOCK(&ring->lock) != 0) {
+            if (ring->to_submit == 0) {
+                return;
+            }
+            ACQUIRE_LOCK(&ring->lock);
+        }
+        submitIOUring(ring);
+        n = reapIOUring(ring, mvars, IO_URING_REAP_BATCH);
+        RELEASE_LOCK(&ring->lock);
+
+        for (i = 0; i < n; i++) {
+            performTryPutMVar(cap, (StgMVar*)deRefStablePtr(mvars[i]),
+                              Unit_closure);
+            freeStablePtr(mvars[i]);
+        }
+    } while (n == IO_URING_REAP_BATCH);
+}
+
+void exitIOUrings (void)
+{
+    IOUring *ring;
+    struct io_uring_sqe *sqe;
+    uint32_t i, idx;
+
+    for (i = 0; i < n_capabilities; i++) {
+        ring = capabilities[i]->io_uring;
+        if (ring == NULL) continue;
+        capabilities[i]->io_uring = NULL;
+
+        // Tell the completion thread to stop, and wake it with a no-op
+        // request.  If the submission queue is full the kernel is still
+        // catching up, so keep trying until the request gets in.
+        for (;;) {
+            ACQUIRE_LOCK(&ring->lock);
+            ring->stopping = true;
+            sqe = getSqe(ring, &idx);
+            if (sqe != NULL) {
+                sqe->opcode = IORING_OP_NOP;
+                sqe->user_data = IO_URING_NO_ID;
+                pushSqe(ring, idx, false);
+            }
+            RELEASE_LOCK(&ring->lock);
+            if (sqe != NULL) break;
+            yieldThread();
+        }
+
+        // The completion thread may be in the middle of hs_try_putmvar,
+        // so it must be gone before hs_exit frees the Capabilities.
+        if (pthread_join(ring->thread, NULL) != 0) {
+            sysErrorBelch("exitIOUrings: failed to join completion thread");
+        }
+        freeIOUring(ring);
+    }
+}
+
+void resetIOUringsAfterFork (void)
+{
+    IOUring *ring;
+    uint32_t i;
+
+    // The rings are shared with the parent and their completion threads
+    // don't exist in the child.  Drop our mappings of them without
+    // touching them, and let the child make new ones when it needs them.
+    for (i = 0; i < n_capabilities; i++) {
+        ring = capabilities[i]->io_uring;
+        if (ring == NULL) continue;
+        capabilities[i]->io_uring = NULL;
+        initMutex(&ring->lock);
+        freeIOUring(ring);
+    }
+}
+
+#else /* !RTS_IO_URING */
+
+StgWord64 ioUringPollFd (int fd STG_UNUSED, uint32_t events STG_UNUSED,
+                         HsStablePtr mvar STG_UNUSED)
+{
+    errno = ENOSYS;
+    return 0;
+}
+
+StgWord64 ioUringTimeout (StgWord64 usecs STG_UNUSED,
+                          HsStablePtr mvar STG_UNUSED)
+{
+    errno = ENOSYS;
+    return 0;
+}
+
+int ioUringCancel (StgWord64 id STG_UNUSED)
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+#endif /* RTS_IO_URING */
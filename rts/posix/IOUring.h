@@ -0,0 +1,35 @@
+/* -----------------------------------------------------------------------------
+ *
+ * (c) The GHC Team, 2020
+ *
+ * Per-Capability io_uring rings, for waking Haskell threads blocked on I/O
+ * readiness and timeouts straight from the scheduler.
+ *
+ * ---------------------------------------------------------------------------*/
+
+#pragma once
+
+#include "BeginPrivate.h"
+
+// HAVE_IO_URING is only defined by configure when linux/io_uring.h is
+// recent enough (IORING_OP_ASYNC_CANCEL, IORING_FEAT_SINGLE_MMAP and
+// struct __kernel_timespec, i.e. Linux 5.5 or later).
+#if defined(THREADED_RTS) && defined(HAVE_IO_URING)
+
+#define RTS_IO_URING 1
+
+// Submit queued requests and wake the threads whose requests have
+// completed.  Called from the scheduler loop; cap must be owned by the
+// calling Task.
+void processIOUringCompletions (Capability *cap);
+
+// Called by hs_exit(): stop the completion threads and release the rings.
+void exitIOUrings (void);
+
+// Called in the child of forkProcess, where the rings are shared with the
+// parent and must not be used.
+void resetIOUringsAfterFork (void);
+
+#endif
+
+#include "EndPrivate.h"
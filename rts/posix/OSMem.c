@@ -74,9 +74,100 @@
 
 static void *next_request = 0;
 
+/* -----------------------------------------------------------------------------
+   Transparent huge pages
+
+   Note [Transparent huge pages]
+   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+   With large nurseries most TLB misses, in the mutator and in the GC,
+   can be avoided by backing the heap with huge pages (2MB on x86-64),
+   which Linux provides transparently for memory madvise()d with
+   MADV_HUGEPAGE.  +RTS --huge-pages asks for this.
+
+   The kernel only uses a huge page for an aligned huge-page-sized
+   range that lies entirely within one mapping with the right
+   attributes, and freeing part of a huge page splits it back into
+   small pages.  MBlocks are smaller than huge pages, so when huge
+   pages are in use (huge_page_size != 0):
+
+    - the heap reservation is aligned to huge_page_size, and the whole
+      of it is madvise()d with MADV_HUGEPAGE (osReserveHeapMemory);
+
+    - committing memory rounds the range out to whole huge pages, and
+      uses mprotect() rather than mmap(MAP_FIXED), so that rounding
+      out over memory that is already in use is harmless and the
+      MADV_HUGEPAGE advice is kept (osCommitMemory);
+
+    - decommitMBlocks() (MBlock.c) only decommits the huge pages that
+      are entirely free, so returning memory to the OS never splits a
+      huge page that is partly in use.  A part of a huge page can
+      therefore stay resident while free, at most one huge page per
+      free range.
+
+   Without USE_LARGE_ADDRESS_SPACE, we can only madvise() each chunk
+   that we get from osGetMBlocks().
+
+   The amount of heap that actually ended up in huge pages is read from
+   /proc/self/smaps by osHeapHugePageBytes() and shown by +RTS -s.
+   -------------------------------------------------------------------------- */
+
+// The size of a huge page, or 0 if we are not using huge pages.
+static W_ huge_page_size = 0;
+
+#if defined(MADV_HUGEPAGE)
+static W_
+getHugePageSize (void)
+{
+    FILE *f;
+    char buf[64];
+    W_ size = 0;
+
+    // huge pages are disabled altogether if "[never]" is selected
+    f = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    if (f != NULL) {
+        if (fgets(buf, sizeof(buf), f) != NULL && strstr(buf, "[never]")) {
+            fclose(f);
+            return 0;
+        }
+        fclose(f);
+    }
+
+    f = fopen("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "r");
+    if (f != NULL) {
+        if (fgets(buf, sizeof(buf), f) != NULL) {
+            size = strtoul(buf, NULL, 10);
+        }
+        fclose(f);
+    }
+
+    // must be a power of two; if in doubt assume the common 2MB
+    if (size == 0 || (size & (size - 1)) != 0) {
+        size = 2 * 1024 * 1024;
+    }
+    return size;
+}
+#endif
+
+W_ osHugePageSize(void)
+{
+    return huge_page_size;
+}
+
 void osMemInit(void)
 {
     next_request = (void *)RtsFlags.GcFlags.heapBase;
+
+    if (RtsFlags.GcFlags.hugePages) {
+#if defined(MADV_HUGEPAGE)
+        huge_page_size = getHugePageSize();
+        if (huge_page_size == 0) {
+            errorBelch("warning: --huge-pages: transparent huge pages are "
+                       "disabled on this system");
+        }
+#else
+        errorBelch("warning: --huge-pages is not supported on this platform");
+#endif
+    }
 }
 
 /* -----------------------------------------------------------------------------
@@ -353,6 +444,13 @@ osGetMBlocks(uint32_t n)
   // ToDo: check that we haven't already grabbed the memory at next_request
   next_request = (char *)ret + size;
 
+#if defined(MADV_HUGEPAGE)
+  // See Note [Transparent huge pages]
+  if (huge_page_size != 0) {
+      madvise(ret, size, MADV_HUGEPAGE);
+  }
+#endif
+
   return ret;
 }
 
@@ -476,23 +574,26 @@ osTryReserveHeapMemory (W_ len, void *hint)
 {
     void *base, *top;
     void *start, *end;
+    // huge pages need a more strictly aligned heap,
+    // see Note [Transparent huge pages]
+    W_ align = stg_max(MBLOCK_SIZE, huge_page_size);
 
     ASSERT((len & ~MBLOCK_MASK) == len);
 
-    /* We try to allocate len + MBLOCK_SIZE,
-       because we need memory which is MBLOCK_SIZE aligned,
-       and then we discard what we don't need */
+    /* We try to allocate len + align,
+       because we need memory which is aligned to align (normally
+       MBLOCK_SIZE), and then we discard what we don't need */
 
-    base = my_mmap(hint, len + MBLOCK_SIZE, MEM_RESERVE);
+    base = my_mmap(hint, len + align, MEM_RESERVE);
     if (base == NULL)
         return NULL;
 
-    top = (void*)((W_)base + len + MBLOCK_SIZE);
+    top = (void*)((W_)base + len + align);
 
-    if (((W_)base & MBLOCK_MASK) != 0) {
-        start = MBLOCK_ROUND_UP(base);
-        end = MBLOCK_ROUND_DOWN(top);
-        ASSERT(((W_)end - (W_)start) == len);
+    if (((W_)base & (align - 1)) != 0) {
+        start = (void*)roundUpToAlign((W_)base, align);
+        end = (void*)((W_)start + len);
+        ASSERT((W_)end <= (W_)top);
 
         if (munmap(base, (W_)start-(W_)base) < 0) {
             sysErrorBelch("unable to release slop before heap");
@@ -591,11 +692,31 @@ void *osReserveHeapMemory(void *startAddressPtr, W_ *len)
         attempt++;
     }
 
+#if defined(MADV_HUGEPAGE)
+    // See Note [Transparent huge pages]
+    if (huge_page_size != 0 && madvise(at, *len, MADV_HUGEPAGE) != 0) {
+        sysErrorBelch("warning: --huge-pages: madvise(MADV_HUGEPAGE)");
+        huge_page_size = 0;
+    }
+#endif
+
     return at;
 }
 
 void osCommitMemory(void *at, W_ size)
 {
+    if (huge_page_size != 0) {
+        // See Note [Transparent huge pages]
+        W_ start = (W_)at & ~(huge_page_size - 1);
+        W_ end = stg_min(roundUpToAlign((W_)at + size, huge_page_size),
+                         mblock_address_space.end);
+        if (mprotect((void*)start, end - start, PROT_READ | PROT_WRITE) != 0) {
+            barf("Unable to commit %" FMT_Word " bytes of memory", size);
+        }
+        post_mmap_madvise(MEM_COMMIT, end - start, (void*)start);
+        return;
+    }
+
     void *r = my_mmap(at, size, MEM_COMMIT);
     if (r == NULL) {
         barf("Unable to commit %" FMT_Word " bytes of memory", size);
@@ -677,6 +798,39 @@ void osReleaseHeapMemory(void)
 
 #endif
 
+// How much of the heap is backed by huge pages right now, according to
+// the kernel.  See Note [Transparent huge pages].
+W_ osHeapHugePageBytes(void)
+{
+#if defined(linux_HOST_OS) && defined(USE_LARGE_ADDRESS_SPACE)
+    FILE *f;
+    char line[256];
+    unsigned long lo, hi, kb;
+    bool in_heap = false;
+    W_ total = 0;
+
+    if (huge_page_size == 0) return 0;
+
+    f = fopen("/proc/self/smaps", "r");
+    if (f == NULL) return 0;
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (sscanf(line, "%lx-%lx ", &lo, &hi) == 2) {
+            // the header line of a mapping
+            in_heap = lo < mblock_address_space.end
+                   && hi > mblock_address_space.begin;
+        } else if (in_heap &&
+                   sscanf(line, "AnonHugePages: %lu kB", &kb) == 1) {
+            total += (W_)kb * 1024;
+        }
+    }
+    fclose(f);
+    return total;
+#else
+    return 0;
+#endif
+}
+
 bool osBuiltWithNumaSupport(void)
 {
 #if HAVE_LIBNUMA
@@ -9,6 +9,11 @@
 
 #include "PosixSource.h"
 
+#if defined(linux_HOST_OS)
+/* for PTHREAD_MUTEX_ADAPTIVE_NP */
+#define _GNU_SOURCE 1
+#endif
+
 #if defined(freebsd_HOST_OS) || defined(dragonfly_HOST_OS)
 /* Inclusion of system headers usually requires __BSD_VISIBLE on FreeBSD and
  * DragonflyBSD, because of some specific types, like u_char, u_int, etc. */
@@ -21,11 +26,13 @@
 #endif
 
 #include "Rts.h"
+#include "SpinCondition.h"
 
 #if defined(linux_HOST_OS)
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/syscall.h>
+#include <linux/futex.h>
 #endif
 
 #if defined(HAVE_PTHREAD_H)
@@ -117,6 +124,138 @@ waitCondition ( Condition* pCond, Mutex* pMut )
   return (pthread_cond_wait(pCond,pMut) == 0);
 }
 
+#if defined(THREADED_RTS) && defined(linux_HOST_OS)
+
+/*
+  Note [Futex condition variables]
+  ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+  Handing a Capability to a sleeping Task (giveCapabilityToTask(), and
+  the waits in waitForWorkerCapability() and waitForReturnCapability())
+  is a signal on the Task's condition variable.  With pthread_cond_wait
+  the waiter always goes to sleep in the kernel, so every handoff costs
+  a futex wait and a futex wake plus the scheduling latency of the
+  woken thread, even when the Capability comes back a microsecond
+  later, which is typical of a program making lots of short safe
+  foreign calls.
+
+  So task->cond is a SpinCondition (see SpinCondition.h), which on
+  Linux we implement ourselves on top of a futex:
+
+    * seq is bumped by every signal.  A waiter reads it while it still
+      holds the mutex, releases the mutex, and then waits for seq to
+      change.
+
+    * The waiter first spins, watching seq, for up to spin_limit
+      iterations.  Only if no signal arrives does it register itself
+      in parked and sleep with FUTEX_WAIT on seq, which returns at once
+      if seq has already moved on.
+
+    * A signaller bumps seq and only makes the FUTEX_WAKE system call
+      if some waiter is parked.  Both sides update their own word with
+      an atomic (full barrier) before reading the other's, so either
+      the signaller sees the parked waiter or the waiter sees the new
+      seq.
+
+  spin_limit adapts: it doubles (up to COND_SPIN_MAX) each time
+  spinning caught the signal and halves each time the waiter had to
+  park, so conditions that are signalled only rarely soon stop
+  wasting CPU time.  We never spin on a single-processor machine.
+
+  As with pthreads, waits may end spuriously: a signal wakes every
+  waiter that is spinning on the same condition.  All of our callers
+  wait in a loop that re-checks their predicate.
+
+  Condition itself stays a pthread condition variable, because it is
+  part of the RTS's public API.  The Mutex stays a pthread mutex too,
+  which glibc already implements on a futex with an uncontended fast
+  path; outside DEBUG builds we ask for the adaptive (spinning) kind,
+  see initMutex().
+
+  The number of waits that were ended while spinning, and the number
+  that had to park, are reported by +RTS -s.
+*/
+
+#define COND_SPIN_MIN     64
+#define COND_SPIN_MAX  16384
+
+static volatile StgWord cond_waits_spun = 0;
+static volatile StgWord cond_waits_parked = 0;
+
+static long
+futex (volatile uint32_t *addr, int op, uint32_t val)
+{
+    return syscall(SYS_futex, addr, op, val, NULL, NULL, 0);
+}
+
+void
+initSpinCondition( SpinCondition* pCond )
+{
+    pCond->seq = 0;
+    pCond->parked = 0;
+    pCond->spin_limit = getNumberOfProcessors() > 1 ? COND_SPIN_MIN : 0;
+}
+
+void
+closeSpinCondition( SpinCondition* pCond STG_UNUSED )
+{
+}
+
+bool
+signalSpinCondition ( SpinCondition* pCond )
+{
+    __sync_add_and_fetch(&pCond->seq, 1);
+    if (pCond->parked != 0) {
+        futex(&pCond->seq, FUTEX_WAKE_PRIVATE, 1);
+    }
+    return true;
+}
+
+bool
+waitSpinCondition ( SpinCondition* pCond, Mutex* pMut )
+{
+    uint32_t seq = pCond->seq;
+    uint32_t limit = pCond->spin_limit;
+    uint32_t i;
+
+    pthread_mutex_unlock(pMut);
+
+    for (i = 0; i < limit; i++) {
+        if (pCond->seq != seq) {
+            if (limit < COND_SPIN_MAX) {
+                pCond->spin_limit = limit * 2;
+            }
+            atomic_inc(&cond_waits_spun, 1);
+            goto done;
+        }
+        busy_wait_nop();
+    }
+
+    if (limit > COND_SPIN_MIN) {
+        pCond->spin_limit = limit / 2;
+    }
+    atomic_inc(&cond_waits_parked, 1);
+
+    __sync_add_and_fetch(&pCond->parked, 1);
+    while (pCond->seq == seq) {
+        // returns at once (EAGAIN) if seq has changed since we read it
+        futex(&pCond->seq, FUTEX_WAIT_PRIVATE, seq);
+    }
+    __sync_sub_and_fetch(&pCond->parked, 1);
+
+done:
+    pthread_mutex_lock(pMut);
+    return true;
+}
+
+void
+getSpinConditionStats ( StgWord64 *spun, StgWord64 *parked )
+{
+    *spun = cond_waits_spun;
+    *parked = cond_waits_parked;
+}
+
+#endif /* THREADED_RTS && linux_HOST_OS */
+
 void
 yieldThread(void)
 {
@@ -166,6 +305,12 @@ initMutex(Mutex* pMut)
     pthread_mutexattr_init(&attr);
     pthread_mutexattr_settype(&attr,PTHREAD_MUTEX_ERRORCHECK);
     pthread_mutex_init(pMut,&attr);
+#elif defined(linux_HOST_OS)
+    // spin briefly before sleeping, see Note [Futex condition variables]
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr,PTHREAD_MUTEX_ADAPTIVE_NP);
+    pthread_mutex_init(pMut,&attr);
 #else
     pthread_mutex_init(pMut,NULL);
 #endif
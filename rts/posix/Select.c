@@ -19,6 +19,7 @@
 #include "RtsUtils.h"
 #include "Capability.h"
 #include "Select.h"
+#include "Threads.h"
 #include "AwaitEvent.h"
 #include "Stats.h"
 #include "GetTime.h"
@@ -31,6 +32,13 @@
 #  include <sys/types.h>
 # endif
 
+# if defined(HAVE_SYS_EPOLL_H)
+#  include <sys/epoll.h>
+#  include <limits.h>
+#  include <unistd.h>
+#  define USE_EPOLL 1
+# endif
+
 #include <errno.h>
 #include <string.h>
 
@@ -93,17 +101,204 @@ LowResTime getDelayTarget (HsInt us)
  * if this is true, then our time has expired.
  * (idea due to Andy Gill).
  */
+STATIC_INLINE bool targetBefore (LowResTime a, LowResTime b)
+{
+    return (StgInt)(a - b) < 0;
+}
+
+/* Note [The sleeping heap]
+   ~~~~~~~~~~~~~~~~~~~~~~~~
+   Threads blocked in threadDelay# are kept in a binary min-heap ordered
+   by their wake-up time (tso->block_info.target, compared with the
+   wrap-around trick above).  Blocking a thread and waking the earliest
+   sleeper are both O(log n); the sorted list threaded through
+   tso->_link that this replaces made every threadDelay# walk past all
+   the threads due to wake before it.
+
+   A TSO has no spare field in which to record its position in the heap,
+   so removal is lazy: when a sleeping thread is woken early (by throwTo,
+   see removeFromQueues) it is just made runnable and its entry is left
+   behind.  An entry is live only while its TSO is still BlockedOnDelay
+   with the same target.  Stale entries are discarded when they reach the
+   top of the heap, and all at once by pruneSleepingThreads, which we run
+   before growing the heap.  Waking a thread whose target has passed is
+   always correct, so a stale entry that happens to match a later
+   threadDelay# with the same target is harmless.
+
+   anySleepingThreads drops stale entries from the top until it finds a
+   live one, so deadlock detection and the awaitEvent timeout never wait
+   on a thread that is no longer asleep.
+
+   The TSO pointers in the heap are GC roots (markScheduler), but only
+   live entries should keep their TSO alive, so markSleepingThreads
+   discards the stale entries with pruneSleepingThreads before it marks
+   the rest.  It is called with the mutator stopped and before the
+   collector has moved any of these TSOs: first by GarbageCollect, then by
+   the non-moving collector when it marks its roots (the first call has
+   already updated the pointers), and by the compacting collector when it
+   threads the roots.  By then the first call has already pruned the heap,
+   and all the remaining entries are live.  For a BlockedOnDelay TSO,
+   threading changes neither why_blocked nor block_info, so the check
+   gives the same answer again.
+*/
+
+typedef struct {
+    StgTSO     *tso;
+    LowResTime  target;
+} SleepingThread;
+
+#define SLEEPING_HEAP_INIT_SIZE 64
+
+static SleepingThread *sleeping_heap = NULL;
+static uint32_t n_sleeping = 0;
+static uint32_t sleeping_heap_size = 0;
+
+static bool sleeperIsLive (SleepingThread *s)
+{
+    return s->tso->why_blocked == BlockedOnDelay
+        && (LowResTime)s->tso->block_info.target == s->target;
+}
+
+static void siftUpSleeping (uint32_t i)
+{
+    SleepingThread s = sleeping_heap[i];
+    while (i > 0) {
+        uint32_t parent = (i - 1) / 2;
+        if (!targetBefore(s.target, sleeping_heap[parent].target)) break;
+        sleeping_heap[i] = sleeping_heap[parent];
+        i = parent;
+    }
+    sleeping_heap[i] = s;
+}
+
+static void siftDownSleeping (uint32_t i)
+{
+    SleepingThread s = sleeping_heap[i];
+    for (;;) {
+        uint32_t child = 2 * i + 1;
+        if (child >= n_sleeping) break;
+        if (child + 1 < n_sleeping &&
+            targetBefore(sleeping_heap[child + 1].target,
+                         sleeping_heap[child].target)) {
+            child++;
+        }
+        if (!targetBefore(sleeping_heap[child].target, s.target)) break;
+        sleeping_heap[i] = sleeping_heap[child];
+        i = child;
+    }
+    sleeping_heap[i] = s;
+}
+
+static void popSleepingThread (void)
+{
+    n_sleeping--;
+    if (n_sleeping > 0) {
+        sleeping_heap[0] = sleeping_heap[n_sleeping];
+        siftDownSleeping(0);
+    }
+}
+
+/*
+ * Add a thread blocked in threadDelay# to the sleeping heap.  The caller
+ * has already set why_blocked and block_info.target.  Called from
+ * stg_delayzh.
+ */
+void insertSleepingThread (StgTSO *tso)
+{
+    ASSERT(tso->why_blocked == BlockedOnDelay);
+
+    if (n_sleeping == sleeping_heap_size) {
+        pruneSleepingThreads();
+        // Only grow if pruning didn't free a reasonable amount of room,
+        // otherwise a heap full of stale entries would prune on every
+        // insertion.
+        if (n_sleeping >= sleeping_heap_size / 2) {
+            sleeping_heap_size = sleeping_heap_size == 0
+                ? SLEEPING_HEAP_INIT_SIZE : sleeping_heap_size * 2;
+            sleeping_heap = stgReallocBytes(
+                sleeping_heap, sleeping_heap_size * sizeof(SleepingThread),
+                "insertSleepingThread");
+        }
+    }
+
+    sleeping_heap[n_sleeping].tso    = tso;
+    sleeping_heap[n_sleeping].target = (LowResTime)tso->block_info.target;
+    siftUpSleeping(n_sleeping);
+    n_sleeping++;
+}
+
+/*
+ * Are there any threads still blocked in threadDelay#?  Discards stale
+ * entries from the top of the heap as a side effect.
+ */
+bool anySleepingThreads (void)
+{
+    while (n_sleeping > 0) {
+        if (sleeperIsLive(&sleeping_heap[0])) {
+            return true;
+        }
+        popSleepingThread();
+    }
+    return false;
+}
+
+/*
+ * Discard every stale entry and rebuild the heap.
+ */
+void pruneSleepingThreads (void)
+{
+    uint32_t i, n = 0;
+
+    for (i = 0; i < n_sleeping; i++) {
+        if (sleeperIsLive(&sleeping_heap[i])) {
+            sleeping_heap[n++] = sleeping_heap[i];
+        }
+    }
+    n_sleeping = n;
+    for (i = n_sleeping / 2; i > 0; i--) {
+        siftDownSleeping(i - 1);
+    }
+}
+
+void markSleepingThreads (evac_fn evac, void *user)
+{
+    uint32_t i;
+
+    // don't keep threads that are no longer asleep alive; see
+    // Note [The sleeping heap]
+    pruneSleepingThreads();
+
+    for (i = 0; i < n_sleeping; i++) {
+        evac(user, (StgClosure **)(void *)&sleeping_heap[i].tso);
+    }
+}
+
+void freeSleepingThreads (void)
+{
+    if (sleeping_heap != NULL) {
+        stgFree(sleeping_heap);
+        sleeping_heap = NULL;
+    }
+    n_sleeping = 0;
+    sleeping_heap_size = 0;
+}
+
 static bool wakeUpSleepingThreads (LowResTime now)
 {
     StgTSO *tso;
+    bool live;
     bool flag = false;
 
-    while (sleeping_queue != END_TSO_QUEUE) {
-        tso = sleeping_queue;
-        if (((long)now - (long)tso->block_info.target) < 0) {
+    while (n_sleeping > 0) {
+        if (targetBefore(now, sleeping_heap[0].target)) {
             break;
         }
-        sleeping_queue = tso->_link;
+        tso = sleeping_heap[0].tso;
+        live = sleeperIsLive(&sleeping_heap[0]);
+        popSleepingThread();
+        if (!live) {
+            continue;
+        }
         tso->why_blocked = NotBlocked;
         tso->_link = END_TSO_QUEUE;
         IF_DEBUG(scheduler, debugBelch("Waking up sleeping thread %lu\n",
@@ -115,6 +310,457 @@ static bool wakeUpSleepingThreads (LowResTime now)
     return flag;
 }
 
+#if defined(USE_EPOLL)
+
+/* Note [Waiting for I/O with epoll]
+   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+   Where epoll is available, threads blocked in waitRead#/waitWrite# are
+   not put on blocked_queue.  insertIOWaiter records each one in a table
+   indexed by file descriptor, and awaitEvent (re-)registers the
+   descriptor with a long-lived epoll instance before it next waits.
+   After that awaitEvent only looks at the descriptors that epoll reports
+   ready, so a pass through the scheduler with nothing to do costs one
+   epoll_wait call however many threads are blocked, and there is no
+   FD_SETSIZE limit.
+
+   Registration is level-triggered, for the union of the events wanted by
+   the fd's waiters.  Whenever an fd gains or loses a waiter it goes on a
+   dirty list, and updateIOWaiters brings the kernel's view up to date
+   with epoll_ctl.  An fd that has gained a waiter is re-registered even
+   if its event mask is unchanged: the kernel silently drops a
+   registration when the descriptor is closed, and the number may since
+   have been reused.
+
+   The kernel only drops it, though, when the last descriptor of the open
+   file is closed.  If the fd was dup'ed and then closed, EPOLL_CTL_DEL
+   fails with EBADF, and neither can we change the mask through another
+   descriptor, so the registration would stay live and, being
+   level-triggered, make every epoll_wait return at once.  Hence we
+   register with EPOLLONESHOT: the kernel disables the registration once
+   it has reported an event, and awaitEvent puts the fd back on the dirty
+   list so that it is re-armed if it still has waiters (or deleted if not).
+   A stale registration thus reports at most one event, which finds no
+   waiters, or spuriously wakes those of the fd's new incarnation; they
+   retry their I/O and block again.
+
+   epoll refuses descriptors that can't be polled, such as regular files,
+   with EPERM.  select() reports those as always ready, so we wake their
+   waiters straight away.  A closed descriptor (EBADF) gets the
+   blockedOnBadFD exception, as in the select() version (#4934).
+
+   The TSO pointers in the table are GC roots (markScheduler), and
+   removeFromQueues calls removeIOWaiter when a blocked thread receives an
+   exception.  The child of forkProcess shares the parent's epoll
+   instance, so resetIOWaitersAfterFork drops the child's reference to it
+   before any waiters are removed, and the child starts a fresh one.
+*/
+
+typedef struct {
+    StgTSO   **tsos;        // threads blocked on this fd
+    uint32_t   n_tsos;
+    uint32_t   size;
+    uint32_t   registered;  // events registered with epoll_fd
+    bool       fresh;       // gained a waiter since the last epoll_ctl
+    bool       dirty;       // on dirty_fds
+} IOWaiters;
+
+// The number of events we collect from one epoll_wait call.  Any others
+// are reported by the next call, as registration is level-triggered.
+#define AWAIT_EPOLL_EVENTS 64
+
+static int        epoll_fd = -1;
+static IOWaiters *io_waiters = NULL;     // indexed by fd
+static int        io_waiters_size = 0;
+static uint32_t   n_io_waiters = 0;      // threads blocked on I/O in total
+static int       *dirty_fds = NULL;      // io_waiters_size entries
+static uint32_t   n_dirty_fds = 0;
+
+static void growIOWaiters (int fd)
+{
+    int new_size = io_waiters_size == 0 ? 64 : io_waiters_size;
+
+    while (new_size <= fd) {
+        new_size *= 2;
+    }
+    io_waiters = stgReallocBytes(io_waiters, new_size * sizeof(IOWaiters),
+                                 "growIOWaiters");
+    memset(&io_waiters[io_waiters_size], 0,
+           (new_size - io_waiters_size) * sizeof(IOWaiters));
+    dirty_fds = stgReallocBytes(dirty_fds, new_size * sizeof(int),
+                                "growIOWaiters");
+    io_waiters_size = new_size;
+}
+
+static void markIOWaitersDirty (int fd)
+{
+    if (!io_waiters[fd].dirty) {
+        io_waiters[fd].dirty = true;
+        dirty_fds[n_dirty_fds++] = fd;
+    }
+}
+
+STATIC_INLINE uint32_t waiterEvents (StgTSO *tso)
+{
+    return tso->why_blocked == BlockedOnRead ? EPOLLIN : EPOLLOUT;
+}
+
+/*
+ * Record a thread blocked in waitRead# or waitWrite#.  The caller has
+ * already set why_blocked and block_info.fd.  Called from stg_waitReadzh
+ * and stg_waitWritezh.
+ */
+void insertIOWaiter (StgTSO *tso)
+{
+    int fd = (int)tso->block_info.fd;
+    IOWaiters *w;
+
+    ASSERT(tso->why_blocked == BlockedOnRead ||
+           tso->why_blocked == BlockedOnWrite);
+
+    if (fd < 0) {
+        errorBelch("invalid file descriptor %d in waitRead#/waitWrite#", fd);
+        stg_exit(EXIT_FAILURE);
+    }
+    if (fd >= io_waiters_size) {
+        growIOWaiters(fd);
+    }
+
+    w = &io_waiters[fd];
+    if (w->n_tsos == w->size) {
+        w->size = w->size == 0 ? 4 : w->size * 2;
+        w->tsos = stgReallocBytes(w->tsos, w->size * sizeof(StgTSO *),
+                                  "insertIOWaiter");
+    }
+    w->tsos[w->n_tsos++] = tso;
+    w->fresh = true;
+    n_io_waiters++;
+    markIOWaitersDirty(fd);
+}
+
+void removeIOWaiter (Capability *cap STG_UNUSED, StgTSO *tso)
+{
+    int fd = (int)tso->block_info.fd;
+    IOWaiters *w = &io_waiters[fd];
+    uint32_t i;
+
+    for (i = 0; i < w->n_tsos; i++) {
+        if (w->tsos[i] == tso) {
+            w->tsos[i] = w->tsos[--w->n_tsos];
+            n_io_waiters--;
+            markIOWaitersDirty(fd);
+            return;
+        }
+    }
+    barf("removeIOWaiter: thread %lu not blocked on fd %d",
+         (unsigned long)tso->id, fd);
+}
+
+bool anyIOWaiters (void)
+{
+    return n_io_waiters > 0;
+}
+
+void markIOWaiters (evac_fn evac, void *user)
+{
+    int fd;
+    uint32_t i;
+
+    for (fd = 0; fd < io_waiters_size; fd++) {
+        for (i = 0; i < io_waiters[fd].n_tsos; i++) {
+            evac(user, (StgClosure **)(void *)&io_waiters[fd].tsos[i]);
+        }
+    }
+}
+
+void resetIOWaitersAfterFork (void)
+{
+    int fd;
+
+    if (epoll_fd >= 0) {
+        close(epoll_fd);
+        epoll_fd = -1;
+    }
+    for (fd = 0; fd < io_waiters_size; fd++) {
+        io_waiters[fd].registered = 0;
+    }
+}
+
+void freeIOWaiters (void)
+{
+    int fd;
+
+    if (epoll_fd >= 0) {
+        close(epoll_fd);
+        epoll_fd = -1;
+    }
+    for (fd = 0; fd < io_waiters_size; fd++) {
+        if (io_waiters[fd].tsos != NULL) {
+            stgFree(io_waiters[fd].tsos);
+        }
+    }
+    if (io_waiters != NULL) {
+        stgFree(io_waiters);
+        stgFree(dirty_fds);
+    }
+    io_waiters = NULL;
+    dirty_fds = NULL;
+    io_waiters_size = 0;
+    n_io_waiters = 0;
+    n_dirty_fds = 0;
+}
+
+/*
+ * Wake the threads blocked on fd for any of the given events.
+ */
+static void wakeIOWaiters (int fd, uint32_t ready)
+{
+    IOWaiters *w = &io_waiters[fd];
+    StgTSO *tso;
+    uint32_t i = 0;
+
+    while (i < w->n_tsos) {
+        tso = w->tsos[i];
+        if ((waiterEvents(tso) & ready) == 0) {
+            i++;
+            continue;
+        }
+        w->tsos[i] = w->tsos[--w->n_tsos];
+        n_io_waiters--;
+        IF_DEBUG(scheduler,
+            debugBelch("Waking up blocked thread %lu\n",
+                       (unsigned long)tso->id));
+        tso->why_blocked = NotBlocked;
+        tso->_link = END_TSO_QUEUE;
+        pushOnRunQueue(&MainCapability,tso);
+        markIOWaitersDirty(fd);
+    }
+}
+
+/*
+ * Raise blockedOnBadFD in every thread blocked on fd.
+ */
+static void killIOWaiters (int fd)
+{
+    IOWaiters *w = &io_waiters[fd];
+    StgTSO *tso;
+
+    while (w->n_tsos > 0) {
+        tso = w->tsos[--w->n_tsos];
+        n_io_waiters--;
+        IF_DEBUG(scheduler,
+            debugBelch("Killing blocked thread %lu on bad fd=%i\n",
+                       (unsigned long)tso->id, fd));
+        raiseAsync(&MainCapability, tso,
+            (StgClosure *)blockedOnBadFD_closure, false, NULL);
+    }
+}
+
+static int epollCtl (int op, int fd, uint32_t events)
+{
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events  = events;
+    ev.data.fd = fd;
+    return epoll_ctl(epoll_fd, op, fd, &ev);
+}
+
+/*
+ * Bring the epoll registrations of the dirty fds up to date.
+ */
+static void updateIOWaiters (void)
+{
+    uint32_t d, i, want;
+    int fd, op, r;
+    IOWaiters *w;
+
+    if (epoll_fd < 0) {
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd < 0) {
+            sysErrorBelch("epoll_create1");
+            stg_exit(EXIT_FAILURE);
+        }
+    }
+
+    for (d = 0; d < n_dirty_fds; d++) {
+        fd = dirty_fds[d];
+        w = &io_waiters[fd];
+
+        want = 0;
+        for (i = 0; i < w->n_tsos; i++) {
+            want |= waiterEvents(w->tsos[i]);
+        }
+
+        if (want == 0) {
+            if (w->registered != 0) {
+                // fails if the fd has been closed meanwhile; see Note
+                // [Waiting for I/O with epoll] for why that is harmless
+                (void)epollCtl(EPOLL_CTL_DEL, fd, 0);
+                w->registered = 0;
+            }
+        } else if (want != w->registered || w->fresh) {
+            op = w->registered != 0 ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+            r = epollCtl(op, fd, want | EPOLLONESHOT);
+            if (r < 0 && (errno == ENOENT || errno == EEXIST)) {
+                op = op == EPOLL_CTL_MOD ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+                r = epollCtl(op, fd, want | EPOLLONESHOT);
+            }
+            if (r == 0) {
+                w->registered = want;
+            } else {
+                w->registered = 0;
+                switch (errno) {
+                case EPERM: wakeIOWaiters(fd, EPOLLIN | EPOLLOUT); break;
+                case EBADF: killIOWaiters(fd); break;
+                default:
+                    sysErrorBelch("epoll_ctl");
+                    stg_exit(EXIT_FAILURE);
+                }
+            }
+        }
+        // cleared last, so that waking the fd's threads above doesn't
+        // put it back on the list
+        w->fresh = false;
+        w->dirty = false;
+    }
+    n_dirty_fds = 0;
+}
+
+/* Argument 'wait' says whether to wait for I/O to become available,
+ * or whether to just check and return immediately.  If there are
+ * other threads ready to run, we normally do the non-waiting variety,
+ * otherwise we wait (see Schedule.c).
+ *
+ * See Note [Waiting for I/O with epoll].
+ */
+void
+awaitEvent(bool wait)
+{
+    struct epoll_event events[AWAIT_EPOLL_EVENTS];
+    int numFound, i, fd, timeout;
+    uint32_t ready;
+    LowResTime now;
+
+    IF_DEBUG(scheduler,
+             debugBelch("scheduler: checking for threads blocked on I/O");
+             if (wait) {
+                 debugBelch(" (waiting)");
+             }
+             debugBelch("\n");
+             );
+
+    do {
+
+      now = getLowResTimeOfDay();
+      if (wakeUpSleepingThreads(now)) {
+          return;
+      }
+
+      updateIOWaiters();
+
+      if (!wait || !emptyRunQueue(&MainCapability)) {
+          // just poll
+          timeout = 0;
+      } else if (anySleepingThreads()) {
+          Time min = LowResTimeToTime(sleeping_heap[0].target - now);
+          // round up, so that we don't wake up just before the target
+          Time ms = TimeToMS(min + MSToTime(1) - 1);
+          timeout = ms > INT_MAX ? INT_MAX : (int)ms;
+      } else {
+          timeout = -1;
+      }
+
+      /* Check for any interesting events */
+
+      while ((numFound = epoll_wait(epoll_fd, events, AWAIT_EPOLL_EVENTS,
+                                    timeout)) < 0) {
+          if (errno != EINTR) {
+              sysErrorBelch("epoll_wait");
+              stg_exit(EXIT_FAILURE);
+          }
+
+          /* We got a signal; could be one of ours.  If so, we need
+           * to start up the signal handler straight away, otherwise
+           * we could block for a long time before the signal is
+           * serviced.
+           */
+#if defined(RTS_USER_SIGNALS)
+          if (RtsFlags.MiscFlags.install_signal_handlers && signals_pending()) {
+              startSignalHandlers(&MainCapability);
+              return; /* still hold the lock */
+          }
+#endif
+
+          /* we were interrupted, return to the scheduler immediately.
+           */
+          if (sched_state >= SCHED_INTERRUPTING) {
+              return; /* still hold the lock */
+          }
+
+          /* check for threads that need waking up
+           */
+          wakeUpSleepingThreads(getLowResTimeOfDay());
+
+          /* If new runnable threads have arrived, stop waiting for
+           * I/O and run them.
+           */
+          if (!emptyRunQueue(&MainCapability)) {
+              return; /* still hold the lock */
+          }
+      }
+
+      for (i = 0; i < numFound; i++) {
+          fd = events[i].data.fd;
+          ready = events[i].events;
+          // an error or hang-up completes both reads and writes
+          if (ready & (EPOLLERR | EPOLLHUP)) {
+              ready |= EPOLLIN | EPOLLOUT;
+          }
+          // the registration is one-shot, so have updateIOWaiters re-arm
+          // it for the waiters that remain
+          io_waiters[fd].fresh = true;
+          markIOWaitersDirty(fd);
+          wakeIOWaiters(fd, ready);
+      }
+
+    } while (wait && sched_state == SCHED_RUNNING
+             && emptyRunQueue(&MainCapability));
+}
+
+#else /* !USE_EPOLL */
+
+/*
+ * Without epoll, threads blocked on I/O live on blocked_queue, and
+ * awaitEvent polls all of them with select().
+ */
+void insertIOWaiter (StgTSO *tso)
+{
+    appendToBlockedQueue(tso);
+}
+
+void removeIOWaiter (Capability *cap, StgTSO *tso)
+{
+    removeThreadFromDeQueue(cap, &blocked_queue_hd, &blocked_queue_tl, tso);
+}
+
+bool anyIOWaiters (void)
+{
+    return !emptyQueue(blocked_queue_hd);
+}
+
+// blocked_queue itself is marked by markScheduler
+void markIOWaiters (evac_fn evac STG_UNUSED, void *user STG_UNUSED)
+{
+}
+
+void resetIOWaitersAfterFork (void)
+{
+}
+
+void freeIOWaiters (void)
+{
+}
+
 static void GNUC3_ATTRIBUTE(__noreturn__)
 fdOutOfRange (int fd)
 {
@@ -298,7 +944,7 @@ awaitEvent(bool wait)
           tv.tv_sec  = 0;
           tv.tv_usec = 0;
           ptv = &tv;
-      } else if (sleeping_queue != END_TSO_QUEUE) {
+      } else if (anySleepingThreads()) {
           /* SUSv2 allows implementations to have an implementation defined
            * maximum timeout for select(2). The standard requires
            * implementations to silently truncate values exceeding this maximum
@@ -317,7 +963,7 @@ awaitEvent(bool wait)
            */
           const time_t max_seconds = 2678400; // 31 * 24 * 60 * 60
 
-          Time min = LowResTimeToTime(sleeping_queue->block_info.target - now);
+          Time min = LowResTimeToTime(sleeping_heap[0].target - now);
           tv.tv_sec  = TimeToSeconds(min);
           if (tv.tv_sec < max_seconds) {
               tv.tv_usec = TimeToUS(min) % 1000000;
@@ -455,4 +1101,6 @@ awaitEvent(bool wait)
              && emptyRunQueue(&MainCapability));
 }
 
+#endif /* USE_EPOLL */
+
 #endif /* THREADED_RTS */
@@ -96,30 +96,32 @@ static Condition start_cond;
 static Mutex mutex;
 static OSThreadId thread;
 
-static void *itimer_thread_func(void *_handle_tick)
-{
-    TickProc handle_tick = _handle_tick;
-    uint64_t nticks;
-    int timerfd = -1;
+// Set by idleTicker(): the time of the next tick, if the regular ticks
+// are suspended, or 0.  Writers must hold the mutex.
+static volatile Time idle_deadline = 0;
 
 #if defined(USE_TIMERFD_FOR_ITIMER) && USE_TIMERFD_FOR_ITIMER
+static int timerfd = -1;
+
+static void setTimerfd(Time first)
+{
     struct itimerspec it;
-    it.it_value.tv_sec  = TimeToSeconds(itimer_interval);
-    it.it_value.tv_nsec = TimeToNS(itimer_interval) % 1000000000;
-    it.it_interval = it.it_value;
+    it.it_value.tv_sec  = TimeToSeconds(first);
+    it.it_value.tv_nsec = TimeToNS(first) % 1000000000;
+    it.it_interval.tv_sec  = TimeToSeconds(itimer_interval);
+    it.it_interval.tv_nsec = TimeToNS(itimer_interval) % 1000000000;
 
-    timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
-    if (timerfd == -1) {
-        barf("timerfd_create: %s", strerror(errno));
-    }
-    if (!TFD_CLOEXEC) {
-        fcntl(timerfd, F_SETFD, FD_CLOEXEC);
-    }
     if (timerfd_settime(timerfd, 0, &it, NULL)) {
         barf("timerfd_settime: %s", strerror(errno));
     }
+}
 #endif
 
+static void *itimer_thread_func(void *_handle_tick)
+{
+    TickProc handle_tick = _handle_tick;
+    uint64_t nticks;
+
     while (!exited) {
         if (USE_TIMERFD_FOR_ITIMER) {
             ssize_t r = read(timerfd, &nticks, sizeof(nticks));
@@ -139,6 +141,17 @@ static void *itimer_thread_func(void *_handle_tick)
             if (rtsSleep(itimer_interval) != 0) {
                 sysErrorBelch("ITimer: sleep failed: %s", strerror(errno));
             }
+            // Without a timerfd we can't be woken early by startTicker(),
+            // so keep waking up at the regular rate and just skip the
+            // ticks until the deadline.
+            if (idle_deadline != 0) {
+                if (getProcessElapsedTime() < idle_deadline) {
+                    continue;
+                }
+                OS_ACQUIRE_LOCK(&mutex);
+                idle_deadline = 0;
+                OS_RELEASE_LOCK(&mutex);
+            }
         }
 
         // first try a cheap test
@@ -154,8 +167,9 @@ static void *itimer_thread_func(void *_handle_tick)
         }
     }
 
-    if (USE_TIMERFD_FOR_ITIMER)
-        close(timerfd);
+#if defined(USE_TIMERFD_FOR_ITIMER) && USE_TIMERFD_FOR_ITIMER
+    close(timerfd);
+#endif
     return NULL;
 }
 
@@ -169,6 +183,17 @@ initTicker (Time interval, TickProc handle_tick)
     initCondition(&start_cond);
     initMutex(&mutex);
 
+#if defined(USE_TIMERFD_FOR_ITIMER) && USE_TIMERFD_FOR_ITIMER
+    timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (timerfd == -1) {
+        barf("timerfd_create: %s", strerror(errno));
+    }
+    if (!TFD_CLOEXEC) {
+        fcntl(timerfd, F_SETFD, FD_CLOEXEC);
+    }
+    setTimerfd(itimer_interval);
+#endif
+
     /*
      * We can't use the RTS's createOSThread here as we need to remain attached
      * to the thread we create so we can later join to it if requested
@@ -186,11 +211,29 @@ void
 startTicker(void)
 {
     OS_ACQUIRE_LOCK(&mutex);
+    if (idle_deadline != 0) {
+        idle_deadline = 0;
+#if defined(USE_TIMERFD_FOR_ITIMER) && USE_TIMERFD_FOR_ITIMER
+        setTimerfd(itimer_interval);
+#endif
+    }
     stopped = 0;
     signalCondition(&start_cond);
     OS_RELEASE_LOCK(&mutex);
 }
 
+/* Called from handle_tick(), i.e. on the ticker thread itself */
+void
+idleTicker(Time timeout)
+{
+    OS_ACQUIRE_LOCK(&mutex);
+    idle_deadline = getProcessElapsedTime() + timeout;
+#if defined(USE_TIMERFD_FOR_ITIMER) && USE_TIMERFD_FOR_ITIMER
+    setTimerfd(timeout);
+#endif
+    OS_RELEASE_LOCK(&mutex);
+}
+
 /* There may be at most one additional tick fired after a call to this */
 void
 stopTicker(void)
@@ -57,6 +57,22 @@ startTicker(void)
     }
 }
 
+void
+idleTicker(Time timeout)
+{
+    struct itimerval it;
+
+    it.it_value.tv_sec = TimeToSeconds(timeout);
+    it.it_value.tv_usec = TimeToUS(timeout) % 1000000;
+    it.it_interval.tv_sec = TimeToSeconds(itimer_interval);
+    it.it_interval.tv_usec = TimeToUS(itimer_interval) % 1000000;
+
+    if (setitimer(ITIMER_REAL, &it, NULL) != 0) {
+        sysErrorBelch("setitimer");
+        stg_exit(EXIT_FAILURE);
+    }
+}
+
 void
 stopTicker(void)
 {
@@ -60,6 +60,22 @@ startTicker(void)
     }
 }
 
+void
+idleTicker(Time timeout)
+{
+    struct itimerspec it;
+
+    it.it_value.tv_sec  = TimeToSeconds(timeout);
+    it.it_value.tv_nsec = TimeToNS(timeout) % 1000000000;
+    it.it_interval.tv_sec  = TimeToSeconds(itimer_interval);
+    it.it_interval.tv_nsec = TimeToNS(itimer_interval) % 1000000000;
+
+    if (timer_settime(timer, 0, &it, NULL) != 0) {
+        sysErrorBelch("timer_settime");
+        stg_exit(EXIT_FAILURE);
+    }
+}
+
 void
 stopTicker(void)
 {
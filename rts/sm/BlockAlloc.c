@@ -82,22 +82,26 @@ static void  initMBlock(void *mblock, uint32_t node);
   coalesce in O(1) time.  Every free bgroup must have its head and tail
   bdescrs initialised, the rest don't matter.
 
-  We keep the free list in buckets, using a heap-sort strategy.
-  Bucket N contains blocks with sizes 2^N - 2^(N+1)-1.  The list of
-  blocks in each bucket is doubly-linked, so that if a block is
-  coalesced we can easily remove it from its current free list.
-
-  To allocate a new block of size S, grab a block from bucket
-  log2ceiling(S) (i.e. log2() rounded up), in which all blocks are at
-  least as big as S, and split it if necessary.  If there are no
-  blocks in that bucket, look at bigger buckets until a block is found
-  Allocation is therefore O(logN) time.
+  We keep the free list in segregated buckets.  Groups smaller than
+  EXACT_FREE_LIST_LIMIT blocks have a bucket per size; bigger groups
+  are bucketed by log2, so bucket N holds sizes 2^N - 2^(N+1)-1.  The
+  list of blocks in each bucket is doubly-linked, so that if a block
+  is coalesced we can easily remove it from its current free list.
+  A bitmap per NUMA node records which buckets are non-empty.
+
+  To allocate a new block of size S, find the first non-empty bucket
+  in which all blocks are at least as big as S, using the bitmap, and
+  split the block if necessary.  For small S this is the best fit: an
+  exact-size block is used when there is one, and otherwise the
+  smallest bigger one, which keeps mid-sized holes from being carved
+  up.  Allocation is therefore O(1) time.
 
   To free a block:
     - coalesce it with neighbours.
     - remove coalesced neighbour(s) from free list(s)
     - add the new (coalesced) block to the front of the appropriate
-      bucket, given by log2(S) where S is the size of the block.
+      bucket, given by free_list_index(S) where S is the size of the
+      block.
 
   Free is O(1).
 
@@ -145,20 +149,38 @@ static void  initMBlock(void *mblock, uint32_t node);
 
   --------------------------------------------------------------------------- */
 
-// free_list[i] contains blocks that are at least size 2^i, and at
-// most size 2^(i+1) - 1.
+// free_list[i] for i < EXACT_FREE_LIST_LIMIT-1 contains blocks of
+// exactly size i+1.  The remaining free lists contain blocks that are
+// at least size 2^k, and at most size 2^(k+1) - 1, for
+// k = EXACT_FREE_LIST_SHIFT, EXACT_FREE_LIST_SHIFT+1, ...
 //
-// To find the free list in which to place a block, use log_2(size).
-// To find a free block of the right size, use log_2_ceil(size).
+// To find the free list in which to place a block, use
+// free_list_index(size).  To find a free list all of whose blocks are
+// big enough, use free_list_index_ceil(size).
 //
 // The largest free list (free_list[NUM_FREE_LISTS-1]) needs to contain sizes
 // from half a megablock up to (but not including) a full megablock.
 
-#define NUM_FREE_LISTS (MBLOCK_SHIFT-BLOCK_SHIFT)
+#define LOG_MBLOCK_BLOCKS (MBLOCK_SHIFT-BLOCK_SHIFT)
+
+#define EXACT_FREE_LIST_SHIFT 6
+#define EXACT_FREE_LIST_LIMIT (1 << EXACT_FREE_LIST_SHIFT)
+
+#if LOG_MBLOCK_BLOCKS <= EXACT_FREE_LIST_SHIFT
+#error "EXACT_FREE_LIST_SHIFT is too large for this block size"
+#endif
+
+#define NUM_FREE_LISTS \
+    (EXACT_FREE_LIST_LIMIT - 1 + LOG_MBLOCK_BLOCKS - EXACT_FREE_LIST_SHIFT)
+
+#define FREE_LIST_BITMAP_WORDS \
+    ((NUM_FREE_LISTS + BITS_IN(W_) - 1) / BITS_IN(W_))
 
 // In THREADED_RTS mode, the free list is protected by sm_mutex.
 
 static bdescr *free_list[MAX_NUMA_NODES][NUM_FREE_LISTS];
+// bit i is set iff free_list[node][i] is non-empty
+static W_ free_list_bitmap[MAX_NUMA_NODES][FREE_LIST_BITMAP_WORDS];
 static bdescr *free_mblock_list[MAX_NUMA_NODES];
 
 W_ n_alloc_blocks;   // currently allocated blocks
@@ -177,6 +199,9 @@ void initBlockAllocator(void)
         for (i=0; i < NUM_FREE_LISTS; i++) {
             free_list[node][i] = NULL;
         }
+        for (i=0; i < FREE_LIST_BITMAP_WORDS; i++) {
+            free_list_bitmap[node][i] = 0;
+        }
         free_mblock_list[node] = NULL;
         n_alloc_blocks_by_node[node] = 0;
     }
@@ -237,15 +262,17 @@ initGroup(bdescr *head)
 
 #if SIZEOF_VOID_P == SIZEOF_LONG
 #define CLZW(n) (__builtin_clzl(n))
+#define CTZW(n) (__builtin_ctzl(n))
 #else
 #define CLZW(n) (__builtin_clzll(n))
+#define CTZW(n) (__builtin_ctzll(n))
 #endif
 
-// log base 2 (floor), needs to support up to (2^NUM_FREE_LISTS)-1
+// log base 2 (floor), needs to support up to (2^LOG_MBLOCK_BLOCKS)-1
 STATIC_INLINE uint32_t
 log_2(W_ n)
 {
-    ASSERT(n > 0 && n < (1<<NUM_FREE_LISTS));
+    ASSERT(n > 0 && n < (1<<LOG_MBLOCK_BLOCKS));
 #if defined(__GNUC__)
     return CLZW(n) ^ (sizeof(StgWord)*8 - 1);
     // generates good code on x86.  __builtin_clz() compiles to bsr+xor, but
@@ -253,42 +280,90 @@ log_2(W_ n)
 #else
     W_ i, x;
     x = n;
-    for (i=0; i < NUM_FREE_LISTS; i++) {
+    for (i=0; i < LOG_MBLOCK_BLOCKS; i++) {
         x = x >> 1;
         if (x == 0) return i;
     }
-    return NUM_FREE_LISTS;
+    return LOG_MBLOCK_BLOCKS;
 #endif
 }
 
-// log base 2 (ceiling), needs to support up to (2^NUM_FREE_LISTS)-1
+// log base 2 (ceiling), needs to support up to (2^LOG_MBLOCK_BLOCKS)-1
 STATIC_INLINE uint32_t
 log_2_ceil(W_ n)
 {
-    ASSERT(n > 0 && n < (1<<NUM_FREE_LISTS));
+    ASSERT(n > 0 && n < (1<<LOG_MBLOCK_BLOCKS));
 #if defined(__GNUC__)
     uint32_t r = log_2(n);
     return (n & (n-1)) ? r+1 : r;
 #else
     W_ i, x;
     x = 1;
-    for (i=0; i < MAX_FREE_LIST; i++) {
+    for (i=0; i < LOG_MBLOCK_BLOCKS; i++) {
         if (x >= n) return i;
         x = x << 1;
     }
-    return MAX_FREE_LIST;
+    return LOG_MBLOCK_BLOCKS;
 #endif
 }
 
-STATIC_INLINE void
-free_list_insert (uint32_t node, bdescr *bd)
+// the free list that a free group of n blocks belongs on
+STATIC_INLINE uint32_t
+free_list_index(W_ n)
 {
-    uint32_t ln;
+    if (n < EXACT_FREE_LIST_LIMIT) return n - 1;
+    return EXACT_FREE_LIST_LIMIT - 1 + log_2(n) - EXACT_FREE_LIST_SHIFT;
+}
 
-    ASSERT(bd->blocks < BLOCKS_PER_MBLOCK);
-    ln = log_2(bd->blocks);
+// the first free list all of whose groups have at least n blocks
+STATIC_INLINE uint32_t
+free_list_index_ceil(W_ n)
+{
+    if (n < EXACT_FREE_LIST_LIMIT) return n - 1;
+    return EXACT_FREE_LIST_LIMIT - 1 + log_2_ceil(n) - EXACT_FREE_LIST_SHIFT;
+}
+
+// the first non-empty free list at or after ln, or NUM_FREE_LISTS if
+// there is none
+STATIC_INLINE uint32_t
+free_list_search (uint32_t node, uint32_t ln)
+{
+    uint32_t w;
+    W_ bits;
 
+    if (ln >= NUM_FREE_LISTS) return NUM_FREE_LISTS;
+
+    w = ln / BITS_IN(W_);
+    bits = free_list_bitmap[node][w] & ((W_)-1 << (ln % BITS_IN(W_)));
+    while (bits == 0) {
+        if (++w == FREE_LIST_BITMAP_WORDS) return NUM_FREE_LISTS;
+        bits = free_list_bitmap[node][w];
+    }
+    return w * BITS_IN(W_) + CTZW(bits);
+}
+
+STATIC_INLINE void
+free_list_push (uint32_t node, uint32_t ln, bdescr *bd)
+{
     dbl_link_onto(bd, &free_list[node][ln]);
+    free_list_bitmap[node][ln / BITS_IN(W_)] |= (W_)1 << (ln % BITS_IN(W_));
+}
+
+STATIC_INLINE void
+free_list_remove (uint32_t node, uint32_t ln, bdescr *bd)
+{
+    dbl_link_remove(bd, &free_list[node][ln]);
+    if (free_list[node][ln] == NULL) {
+        free_list_bitmap[node][ln / BITS_IN(W_)] &=
+            ~((W_)1 << (ln % BITS_IN(W_)));
+    }
+}
+
+STATIC_INLINE void
+free_list_insert (uint32_t node, bdescr *bd)
+{
+    ASSERT(bd->blocks < BLOCKS_PER_MBLOCK);
+    free_list_push(node, free_list_index(bd->blocks), bd);
 }
 
 // After splitting a group, the last block of each group must have a
@@ -310,18 +385,17 @@ setup_tail (bdescr *bd)
 // Take a free block group bd, and split off a group of size n from
 // it.  Adjust the free list as necessary, and return the new group.
 static bdescr *
-split_free_block (bdescr *bd, uint32_t node, W_ n, uint32_t ln /* log_2_ceil(n) */)
+split_free_block (bdescr *bd, uint32_t node, W_ n, uint32_t ln /* bd's free list */)
 {
     bdescr *fg; // free group
 
     ASSERT(bd->blocks > n);
-    dbl_link_remove(bd, &free_list[node][ln]);
+    free_list_remove(node, ln, bd);
     fg = bd + bd->blocks - n; // take n blocks off the end
     fg->blocks = n;
     bd->blocks -= n;
     setup_tail(bd);
-    ln = log_2(bd->blocks);
-    dbl_link_onto(bd, &free_list[node][ln]);
+    free_list_insert(node, bd);
     return fg;
 }
 
@@ -450,11 +524,7 @@ allocGroupOnNode (uint32_t node, W_ n)
 
     recordAllocatedBlocks(node, n);
 
-    ln = log_2_ceil(n);
-
-    while (ln < NUM_FREE_LISTS && free_list[node][ln] == NULL) {
-        ln++;
-    }
+    ln = free_list_search(node, free_list_index_ceil(n));
 
     if (ln == NUM_FREE_LISTS) {
 #if 0  /* useful for debugging fragmentation */
@@ -481,7 +551,7 @@ allocGroupOnNode (uint32_t node, W_ n)
 
     if (bd->blocks == n)                // exactly the right size!
     {
-        dbl_link_remove(bd, &free_list[node][ln]);
+        free_list_remove(node, ln, bd);
         initGroup(bd);
     }
     else if (bd->blocks >  n)            // block too big...
@@ -648,20 +718,17 @@ bdescr* allocLargeChunkOnNode (uint32_t node, W_ min, W_ max)
         return allocGroupOnNode(node,max);
     }
 
-    ln = log_2_ceil(min);
-    lnmax = log_2_ceil(max);
+    ln = free_list_search(node, free_list_index_ceil(min));
+    lnmax = free_list_index_ceil(max);
 
-    while (ln < NUM_FREE_LISTS && ln < lnmax && free_list[node][ln] == NULL) {
-        ln++;
-    }
-    if (ln == NUM_FREE_LISTS || ln == lnmax) {
+    if (ln == NUM_FREE_LISTS || ln >= lnmax) {
         return allocGroupOnNode(node,max);
     }
     bd = free_list[node][ln];
 
     if (bd->blocks <= max)              // exactly the right size!
     {
-        dbl_link_remove(bd, &free_list[node][ln]);
+        free_list_remove(node, ln, bd);
         initGroup(bd);
     }
     else   // block too big...
@@ -723,6 +790,86 @@ allocBlockOnNode_lock(uint32_t node)
     return bd;
 }
 
+/* -----------------------------------------------------------------------------
+   Per-capability block caches
+
+   Note [Per-capability block caches]
+   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+   Every allocation from the free lists takes sm_mutex, and the mutator
+   allocates blocks at a high rate in some workloads: pinned object blocks
+   (ByteString and friends), small large objects, nursery extensions and
+   mutable list blocks.  With many capabilities the lock becomes a
+   bottleneck.
+
+   So each Capability has a BlockCache holding free groups of
+   1..BLOCK_CACHE_MAX_GROUP blocks on its own NUMA node.  When the list
+   for a size is empty, allocGroupCached() takes sm_mutex once and
+   fetches BLOCK_CACHE_REFILL_BLOCKS blocks' worth of groups; later
+   requests are served without any lock.  Only the owner of the
+   Capability may touch its cache, the same rule as for cap->mut_lists.
+
+   The blocks in a cache have been taken off the free lists with
+   allocGroupOnNode(), so they are accounted as allocated, on the right
+   node, by recordAllocatedBlocks() and look like allocated groups to
+   freeGroup()'s coalescing.  At the start of each GC the caches are
+   drained back onto the free lists in one go by flushBlockCache()
+   (sm_mutex held), so the GC's heap sizing, returnMemoryToOS() and
+   memInventory() all see an empty cache.
+   -------------------------------------------------------------------------- */
+
+void
+initBlockCache (BlockCache *cache, uint32_t node)
+{
+    uint32_t i;
+
+    cache->node = node;
+    for (i = 0; i < BLOCK_CACHE_MAX_GROUP; i++) {
+        cache->groups[i] = NULL;
+    }
+}
+
+// Allocate n blocks on the cache's node.  The caller must own the cache
+// and must not hold sm_mutex.
+bdescr *
+allocGroupCached (BlockCache *cache, W_ n)
+{
+    bdescr *bd;
+    uint32_t i, batch;
+
+    if (n > BLOCK_CACHE_MAX_GROUP) {
+        return allocGroupOnNode_lock(cache->node, n);
+    }
+
+    i = n - 1;
+    if (cache->groups[i] == NULL) {
+        batch = stg_max(1, BLOCK_CACHE_REFILL_BLOCKS / n);
+        ACQUIRE_SM_LOCK;
+        for (; batch > 0; batch--) {
+            bd = allocGroupOnNode(cache->node, n);
+            bd->link = cache->groups[i];
+            cache->groups[i] = bd;
+        }
+        RELEASE_SM_LOCK;
+    }
+
+    bd = cache->groups[i];
+    cache->groups[i] = bd->link;
+    bd->link = NULL;
+    return bd;
+}
+
+// Return all the cached groups to the free lists.  Requires sm_mutex.
+void
+flushBlockCache (BlockCache *cache)
+{
+    uint32_t i;
+
+    for (i = 0; i < BLOCK_CACHE_MAX_GROUP; i++) {
+        freeChain(cache->groups[i]);
+        cache->groups[i] = NULL;
+    }
+}
+
 /* -----------------------------------------------------------------------------
    De-Allocation
    -------------------------------------------------------------------------- */
@@ -825,8 +972,8 @@ freeGroup(bdescr *p)
       if (next <= LAST_BDESCR(MBLOCK_ROUND_DOWN(p)) && next->free == (P_)-1)
       {
           p->blocks += next->blocks;
-          ln = log_2(next->blocks);
-          dbl_link_remove(next, &free_list[node][ln]);
+          ln = free_list_index(next->blocks);
+          free_list_remove(node, ln, next);
           if (p->blocks == BLOCKS_PER_MBLOCK)
           {
               free_mega_group(p);
@@ -845,8 +992,8 @@ freeGroup(bdescr *p)
 
       if (prev->free == (P_)-1)
       {
-          ln = log_2(prev->blocks);
-          dbl_link_remove(prev, &free_list[node][ln]);
+          ln = free_list_index(prev->blocks);
+          free_list_remove(node, ln, prev);
           prev->blocks += p->blocks;
           if (prev->blocks >= BLOCKS_PER_MBLOCK)
           {
@@ -946,10 +1093,13 @@ countAllocdBlocks(bdescr *bd)
     return n;
 }
 
-void returnMemoryToOS(uint32_t n /* megablocks */)
+// Returns the number of megablocks actually released, which may be
+// fewer than n if the free megablock lists don't hold that many.
+uint32_t returnMemoryToOS(uint32_t n /* megablocks */)
 {
     bdescr *bd;
     uint32_t node;
+    uint32_t wanted = n;
     StgWord size;
 
     // ToDo: not fair, we free all the memory starting with node 0.
@@ -990,6 +1140,233 @@ void returnMemoryToOS(uint32_t n /* megablocks */)
                        n);
         }
     );
+
+    return wanted - n;
+}
+
+/* -----------------------------------------------------------------------------
+   Gradual return of memory to the OS
+   -------------------------------------------------------------------------- */
+
+/*
+  Note [Gradual return of memory to the OS]
+  ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+  At the end of a major GC we work out how many megablocks the heap
+  needs to keep (see the end of GarbageCollect()); anything above that
+  is surplus.  By default the surplus is handed back to the OS straight
+  away.  That is the right thing for a program whose live data has
+  shrunk for good, but a program whose residency goes up and down
+  (a server handling bursts of requests, say) ends up unmapping memory
+  at one major GC and mapping it again a few GCs later, paying for the
+  page faults and zeroing every time.
+
+  With --memory-return-window=<sec> we instead hold on to the surplus
+  and release it gradually: megablocks that have been surplus for t
+  seconds may keep at most (1 - t/window) of their original number
+  alive, so a surplus is gone entirely once it has been idle for the
+  whole window, and memory that is only briefly idle is never returned.
+
+  We track the surplus in "cohorts", one per major GC at which the
+  surplus grew, each remembering when its megablocks became idle.  If
+  the mutator uses surplus memory again (mblocks_allocated grows back
+  towards the target) we forget the most recently idle megablocks
+  first, so the oldest idle memory is still released on schedule.
+  When cohorts run out we merge the two oldest, which can only make
+  release happen sooner.
+
+  The schedule is advanced by returnIdleMemoryToOS(), which is called
+  at the end of every GC and from doIdleGCWork() when a capability is
+  idle.  Once the whole program is idle, the idle GC is the last chance
+  to run it before the timer is stopped, so that GC releases whatever
+  surplus remains.
+
+  All of this state is protected by sm_mutex.
+*/
+
+#define RETURN_COHORTS 8
+
+// Advance the schedule at most this many times per window, except at
+// a GC, so that idle capabilities don't fight over sm_mutex.
+#define RETURN_STEPS_PER_WINDOW 32
+
+typedef struct {
+    Time since;     // when these megablocks became surplus
+    W_   initial;   // how many megablocks became surplus then
+    W_   retained;  // how many of them we are still holding on to
+} ReturnCohort;
+
+static ReturnCohort return_cohorts[RETURN_COHORTS];
+static uint32_t n_return_cohorts = 0;
+
+// megablocks wanted by the heap, as computed by the last major GC
+static W_ return_target = 0;
+
+static Time last_return_step = 0;
+
+static W_
+retainedSurplus (void)
+{
+    W_ n = 0;
+    uint32_t i;
+    for (i = 0; i < n_return_cohorts; i++) {
+        n += return_cohorts[i].retained;
+    }
+    return n;
+}
+
+static W_
+currentSurplus (void)
+{
+    return mblocks_allocated > return_target
+        ? mblocks_allocated - return_target : 0;
+}
+
+// Forget about surplus megablocks that have been reused, newest first,
+// and drop cohorts that have become empty.
+static void
+trimReturnCohorts (W_ surplus)
+{
+    W_ held = retainedSurplus();
+    uint32_t i, j;
+
+    for (i = n_return_cohorts; i > 0 && held > surplus; i--) {
+        ReturnCohort *c = &return_cohorts[i-1];
+        W_ drop = stg_min(c->retained, held - surplus);
+        c->retained -= drop;
+        held -= drop;
+    }
+
+    for (i = 0, j = 0; i < n_return_cohorts; i++) {
+        if (return_cohorts[i].retained > 0) {
+            return_cohorts[j++] = return_cohorts[i];
+        }
+    }
+    n_return_cohorts = j;
+}
+
+// Called at the end of a major GC with the number of megablocks that
+// the heap should keep.  Must hold sm_mutex.
+void
+scheduleReturnMemoryToOS (W_ need /* megablocks */)
+{
+    W_ surplus, held;
+
+    if (RtsFlags.GcFlags.memoryReturnWindow == 0) {
+        if (mblocks_allocated > need) {
+            returnMemoryToOS(mblocks_allocated - need);
+        }
+        return;
+    }
+
+    return_target = need;
+    surplus = currentSurplus();
+    held = retainedSurplus();
+
+    if (surplus <= held) {
+        trimReturnCohorts(surplus);
+        return;
+    }
+
+    if (n_return_cohorts == RETURN_COHORTS) {
+        return_cohorts[0].initial  += return_cohorts[1].initial;
+        return_cohorts[0].retained += return_cohorts[1].retained;
+        memmove(&return_cohorts[1], &return_cohorts[2],
+                (RETURN_COHORTS - 2) * sizeof(ReturnCohort));
+        n_return_cohorts--;
+    }
+
+    return_cohorts[n_return_cohorts].since    = getProcessElapsedTime();
+    return_cohorts[n_return_cohorts].initial  = surplus - held;
+    return_cohorts[n_return_cohorts].retained = surplus - held;
+    n_return_cohorts++;
+}
+
+bool
+memoryReturnPending (void)
+{
+    return n_return_cohorts > 0;
+}
+
+// Release the surplus megablocks whose time is up, or all of them if
+// 'all' is set.  Must hold sm_mutex.
+void
+returnIdleMemoryToOS (bool all)
+{
+    Time now, window = RtsFlags.GcFlags.memoryReturnWindow;
+    W_ excess[RETURN_COHORTS];
+    W_ n = 0, released;
+    uint32_t i;
+
+    if (n_return_cohorts == 0) return;
+
+    trimReturnCohorts(currentSurplus());
+
+    now = getProcessElapsedTime();
+    if (!all && now - last_return_step < window / RETURN_STEPS_PER_WINDOW) {
+        return;
+    }
+    last_return_step = now;
+
+    for (i = 0; i < n_return_cohorts; i++) {
+        ReturnCohort *c = &return_cohorts[i];
+        Time age = now - c->since;
+        W_ allowed;
+
+        if (all || age >= window) {
+            allowed = 0;
+        } else {
+            allowed = (W_)((double)c->initial * (window - age) / window);
+        }
+        excess[i] = c->retained > allowed ? c->retained - allowed : 0;
+        n += excess[i];
+    }
+
+    if (n == 0) return;
+
+    released = returnMemoryToOS(n);
+
+    // charge what we released to the oldest cohorts first
+    for (i = 0; i < n_return_cohorts && released > 0; i++) {
+        W_ r = stg_min(excess[i], released);
+        return_cohorts[i].retained -= r;
+        released -= r;
+    }
+    trimReturnCohorts(currentSurplus());
+}
+
+/* -----------------------------------------------------------------------------
+   Fragmentation statistics, for the +RTS -s report
+   -------------------------------------------------------------------------- */
+
+// Free groups smaller than a megablock are memory that we can neither
+// give back to the OS nor use for a large allocation, so they are what
+// we report as fragmentation.  Must be called with sm_mutex held (or
+// with no other threads running).
+void
+getFreeListStats (FreeListStats *stats)
+{
+    bdescr *bd;
+    uint32_t node, ln;
+
+    stats->free_blocks = 0;
+    stats->free_groups = 0;
+    stats->largest_free_group = 0;
+    stats->free_mblocks = 0;
+
+    for (node = 0; node < n_numa_nodes; node++) {
+        for (ln = 0; ln < NUM_FREE_LISTS; ln++) {
+            for (bd = free_list[node][ln]; bd != NULL; bd = bd->link) {
+                stats->free_blocks += bd->blocks;
+                stats->free_groups++;
+                if (bd->blocks > stats->largest_free_group) {
+                    stats->largest_free_group = bd->blocks;
+                }
+            }
+        }
+        for (bd = free_mblock_list[node]; bd != NULL; bd = bd->link) {
+            stats->free_mblocks += BLOCKS_TO_MBLOCKS(bd->blocks);
+        }
+    }
 }
 
 /* -----------------------------------------------------------------------------
@@ -1014,15 +1391,18 @@ void
 checkFreeListSanity(void)
 {
     bdescr *bd, *prev;
-    StgWord ln, min;
+    StgWord ln;
     uint32_t node;
 
     for (node = 0; node < n_numa_nodes; node++) {
-        min = 1;
         for (ln = 0; ln < NUM_FREE_LISTS; ln++) {
             IF_DEBUG(block_alloc,
                      debugBelch("free block list [%" FMT_Word "]:\n", ln));
 
+            ASSERT((free_list[node][ln] != NULL) ==
+                   ((free_list_bitmap[node][ln / BITS_IN(W_)]
+                     >> (ln % BITS_IN(W_))) & 1));
+
             prev = NULL;
             for (bd = free_list[node][ln]; bd != NULL; prev = bd, bd = bd->link)
             {
@@ -1031,7 +1411,7 @@ checkFreeListSanity(void)
                                     bd->start, (long)bd->blocks));
                 ASSERT(bd->free == (P_)-1);
                 ASSERT(bd->blocks > 0 && bd->blocks < BLOCKS_PER_MBLOCK);
-                ASSERT(bd->blocks >= min && bd->blocks <= (min*2 - 1));
+                ASSERT(free_list_index(bd->blocks) == ln);
                 ASSERT(bd->link != bd); // catch easy loops
                 ASSERT(bd->node == node);
 
@@ -1051,7 +1431,6 @@ checkFreeListSanity(void)
                     }
                 }
             }
-            min = min << 1;
         }
 
         prev = NULL;
@@ -13,11 +13,48 @@
 bdescr *allocLargeChunk (W_ min, W_ max);
 bdescr *allocLargeChunkOnNode (uint32_t node, W_ min, W_ max);
 
+/* Per-capability block caches ---------------------------------------------- */
+
+// See Note [Per-capability block caches] in BlockAlloc.c.
+
+// groups of up to this many blocks are served from the cache
+#define BLOCK_CACHE_MAX_GROUP 4
+
+// number of blocks fetched from the global free list per refill
+#define BLOCK_CACHE_REFILL_BLOCKS 16
+
+typedef struct BlockCache_ {
+    uint32_t node;
+    // groups[i] is a list (linked by bd->link) of groups of i+1 blocks
+    bdescr *groups[BLOCK_CACHE_MAX_GROUP];
+} BlockCache;
+
+void    initBlockCache   (BlockCache *cache, uint32_t node);
+bdescr *allocGroupCached (BlockCache *cache, W_ n);
+void    flushBlockCache  (BlockCache *cache);
+
+/* Fragmentation statistics ------------------------------------------------ */
+
+typedef struct FreeListStats_ {
+    W_ free_blocks;         // blocks in free groups smaller than an mblock
+    W_ free_groups;         // number of such groups
+    W_ largest_free_group;  // blocks in the largest such group
+    W_ free_mblocks;        // free megablocks not yet returned to the OS
+} FreeListStats;
+
+void getFreeListStats (FreeListStats *stats);
+
 /* Debugging  -------------------------------------------------------------- */
 
 extern W_ countBlocks       (bdescr *bd);
 extern W_ countAllocdBlocks (bdescr *bd);
-extern void returnMemoryToOS(uint32_t n);
+extern uint32_t returnMemoryToOS(uint32_t n);
+
+/* Gradual return of surplus megablocks to the OS, see
+ * Note [Gradual return of memory to the OS].  Require sm_mutex. */
+void scheduleReturnMemoryToOS (W_ need);
+void returnIdleMemoryToOS     (bool all);
+bool memoryReturnPending      (void);
 
 #if defined(DEBUG)
 void checkFreeListSanity(void);
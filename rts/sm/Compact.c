@@ -34,6 +34,12 @@
 # define STATIC_INLINE static
 #endif
 
+#if defined(THREADED_RTS)
+// Set while several threads may be threading pointers at the same time.
+// See Note [Parallel compaction].
+static bool compact_threading_in_parallel = false;
+#endif
+
 /* ----------------------------------------------------------------------------
    Threading / unthreading pointers.
 
@@ -134,14 +140,27 @@ thread (StgClosure **p)
     // ptr is possibly threaded:
     // ASSERT(LOOKS_LIKE_CLOSURE_PTR(q));
 
-    if (HEAP_ALLOCED(q)) {
+    if (HEAP_ALLOCED_GC(q)) {
         bdescr *bd = Bdescr(q);
 
         if (bd->flags & BF_MARKED)
         {
+            W_ new = (W_)p + 1 + (q0_tagged ? 1 : 0);
+#if defined(THREADED_RTS)
+            if (compact_threading_in_parallel) {
+                // Other threads may be adding fields to the same chain;
+                // see Note [Parallel compaction].
+                W_ iptr;
+                do {
+                    iptr = VOLATILE_LOAD(q);
+                    *p = (StgClosure *)iptr;
+                } while (cas((StgVolatilePtr)q, iptr, new) != iptr);
+                return;
+            }
+#endif
             W_ iptr = *q;
             *p = (StgClosure *)iptr;
-            *q = (W_)p + 1 + (q0_tagged ? 1 : 0);
+            *q = new;
         }
     }
 }
@@ -819,6 +838,18 @@ update_fwd( bdescr *blocks )
     }
 }
 
+// Thread the pointers in the objects of gen which are not being compacted.
+static void
+update_fwd_gen( generation *gen )
+{
+    update_fwd(gen->blocks);
+    for (W_ n = 0; n < n_capabilities; n++) {
+        update_fwd(gc_threads[n]->gens[gen->no].todo_bd);
+        update_fwd(gc_threads[n]->gens[gen->no].part_list);
+    }
+    update_fwd_large(gen->scavenged_large_objects);
+}
+
 static void
 update_fwd_compact( bdescr *blocks )
 {
@@ -954,6 +985,312 @@ update_bkwd_compact( generation *gen )
     return free_blocks;
 }
 
+/* ----------------------------------------------------------------------------
+   Note [Parallel compaction]
+   ~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+   With +RTS --compact-threads=<n> (n > 1) the threading and sliding of a
+   large oldest generation are shared between up to n threads: the main
+   GC thread and the GC threads that helped with the collection, which
+   are still waiting to continue when we compact (see runOnGcThreads in
+   GC.c).  So compaction is only parallel when the GC is.
+
+   The sequential algorithm interleaves threading and unthreading (fields
+   pointing forwards are unthreaded by update_fwd_compact and fields
+   pointing backwards by update_bkwd_compact), which relies on visiting
+   the heap strictly in address order. The parallel version instead
+   splits old_blocks into regions of consecutive blocks, and uses three
+   passes, separated by barriers:
+
+    1. Thread every pointer field in the heap. The work items are the
+       non-compacted part of each generation (update_fwd_gen) and the
+       regions. Several threads may add fields to the chain of the same
+       object, so thread() pushes onto a chain with a cas while
+       compact_threading_in_parallel is set. Nothing is unthreaded in
+       this pass, so the only concurrent accesses to a chain are pushes
+       and reads by get_threaded_info, which both see a well-formed
+       list.
+
+    2. For each region, walk its live objects in address order,
+       computing each object's destination as a running sum of the sizes
+       of the live objects before it in the region (setting the "too
+       large" mark bit as update_fwd_compact does, see Note [Mark bits in
+       mark-compact collector] in Compact.h), and unthread the object's
+       chain, which by now holds every reference to it. A chain is only
+       walked and rewritten by the thread owning the region of its
+       object, and no object moves during this pass.
+
+    3. For each region, slide its live objects into place, as
+       update_bkwd_compact does. All references have already been
+       updated, so a region's thread only touches that region's blocks.
+
+   Each region is compacted into its own blocks, so destinations never
+   depend on other regions and the passes need no global prefix sum.
+   The price is at most one partially filled block per region, so we
+   only use regions of at least COMPACT_MIN_REGION_BLOCKS blocks.
+   Afterwards the GC thread links the used blocks of the regions back
+   together and frees the rest.
+
+   CNF hash tables are threaded by the GC thread before the parallel
+   passes, as they are put on the shared nfdata_chain.
+   ------------------------------------------------------------------------- */
+
+#if defined(THREADED_RTS)
+
+#define COMPACT_MIN_REGION_BLOCKS 64
+#define COMPACT_REGIONS_PER_THREAD 4
+
+typedef struct {
+    bdescr *first;      // first block of the region
+    bdescr *end;        // first block of the next region, or NULL
+    bdescr *last;       // last block in use after compaction
+    W_ n_blocks;        // number of blocks in use after compaction
+} CompactRegion;
+
+static CompactRegion *compact_regions = NULL;
+static uint32_t n_compact_regions = 0;
+
+// The index of the next work item to be taken in the current pass
+static volatile StgWord compact_next_item;
+
+// The number of threads compacting in parallel, see compact_n_regions.
+static uint32_t n_compact_threads = 1;
+
+/* Run the given task on the calling thread and on the GC threads helping
+ * with this compaction, and return once all of them have finished.
+ */
+static void
+compactRunOnWorkers (void (*task)(void))
+{
+    compact_next_item = 0;
+    runOnGcThreads(task, n_compact_threads);
+}
+
+// Returns the index of the next work item of the current pass.
+STATIC_INLINE uint32_t
+next_compact_item (void)
+{
+    return atomic_inc(&compact_next_item, 1) - 1;
+}
+
+/* How many regions should we split the blocks of gen into? Returns 1 if
+ * the generation should be compacted sequentially.
+ */
+static uint32_t
+compact_n_regions (generation *gen)
+{
+    n_compact_threads = stg_min(stg_max(RtsFlags.GcFlags.compactThreads, 1),
+                                gcThreadsAvailable());
+    if (n_compact_threads == 1 || gen->old_blocks == NULL) {
+        return 1;
+    }
+    W_ n = stg_min(gen->n_old_blocks / COMPACT_MIN_REGION_BLOCKS,
+                   n_compact_threads * COMPACT_REGIONS_PER_THREAD);
+    return stg_max(n, 1);
+}
+
+// Pass 1: thread every pointer field. Items [0, generations) are the
+// non-compacted parts of the generations, the rest are regions.
+static void
+compact_thread_task (void)
+{
+    uint32_t n_gens = RtsFlags.GcFlags.generations;
+    uint32_t i;
+
+    while ((i = next_compact_item()) < n_gens + n_compact_regions) {
+        if (i < n_gens) {
+            update_fwd_gen(&generations[i]);
+        } else {
+            CompactRegion *r = &compact_regions[i - n_gens];
+            for (bdescr *bd = r->first; bd != r->end; bd = bd->link) {
+                P_ p = bd->start;
+                while (p < bd->free) {
+                    while (p < bd->free && !is_marked(p,bd)) {
+                        p++;
+                    }
+                    if (p >= bd->free) {
+                        break;
+                    }
+                    StgInfoTable *iptr = get_threaded_info(p);
+                    p = thread_obj(INFO_PTR_TO_STRUCT(iptr), p);
+                }
+            }
+        }
+    }
+}
+
+// Pass 2: compute the destination of each object in a region and unthread
+// its chain.
+static void
+compact_forward_task (void)
+{
+    uint32_t i;
+
+    while ((i = next_compact_item()) < n_compact_regions) {
+        CompactRegion *r = &compact_regions[i];
+        bdescr *free_bd = r->first;
+        P_ free = free_bd->start;
+
+        for (bdescr *bd = r->first; bd != r->end; bd = bd->link) {
+            P_ p = bd->start;
+            while (p < bd->free) {
+                while (p < bd->free && !is_marked(p,bd)) {
+                    p++;
+                }
+                if (p >= bd->free) {
+                    break;
+                }
+
+                StgInfoTable *iptr = get_threaded_info(p);
+                W_ size = closure_sizeW_((StgClosure *)p,
+                                         INFO_PTR_TO_STRUCT(iptr));
+                if (free + size > free_bd->start + BLOCK_SIZE_W) {
+                    mark(p+1,bd);
+                    free_bd = free_bd->link;
+                    free = free_bd->start;
+                } else {
+                    ASSERT(!is_marked(p+1,bd));
+                }
+
+                unthread(p, (W_)free, get_iptr_tag(iptr));
+                free += size;
+                p += size;
+            }
+        }
+    }
+}
+
+// Pass 3: slide the objects of a region into place.
+static void
+compact_slide_task (void)
+{
+    uint32_t i;
+
+    while ((i = next_compact_item()) < n_compact_regions) {
+        CompactRegion *r = &compact_regions[i];
+        bdescr *free_bd = r->first;
+        P_ free = free_bd->start;
+        W_ free_blocks = 1;
+
+        for (bdescr *bd = r->first; bd != r->end; bd = bd->link) {
+            P_ p = bd->start;
+            while (p < bd->free) {
+                while (p < bd->free && !is_marked(p,bd)) {
+                    p++;
+                }
+                if (p >= bd->free) {
+                    break;
+                }
+
+                if (is_marked(p+1,bd)) {
+                    free_bd->free = free;
+                    IF_DEBUG(zero_on_gc, {
+                        memset(free_bd->free, 0xaa,
+                               BLOCK_SIZE - ((W_)(free_bd->free - free_bd->start) * sizeof(W_)));
+                    });
+                    free_bd = free_bd->link;
+                    free = free_bd->start;
+                    free_blocks++;
+                }
+
+                ASSERT(LOOKS_LIKE_INFO_PTR((W_)((StgClosure *)p)->header.info));
+                const StgInfoTable *info = get_itbl((StgClosure *)p);
+                W_ size = closure_sizeW_((StgClosure *)p,info);
+
+                if (free != p) {
+                    move(free,p,size);
+                }
+
+                // relocate TSOs
+                if (info->type == STACK) {
+                    move_STACK((StgStack *)p, (StgStack *)free);
+                }
+
+                free += size;
+                p += size;
+            }
+        }
+
+        free_bd->free = free;
+        IF_DEBUG(zero_on_gc, {
+            memset(free_bd->free, 0xaa,
+                   free_bd->blocks * BLOCK_SIZE
+                   - (W_)(free_bd->free - free_bd->start) * sizeof(W_));
+        });
+        r->last = free_bd;
+        r->n_blocks = free_blocks;
+    }
+}
+
+static void
+compact_parallel (uint32_t n_regions)
+{
+    generation *gen = oldest_gen;
+
+    debugTrace(DEBUG_gc, "compact: %d regions, %d threads",
+               n_regions, n_compact_threads);
+
+    // Split old_blocks into regions of (nearly) equal numbers of blocks
+    compact_regions = stgMallocBytes(n_regions * sizeof(CompactRegion),
+                                     "compact_parallel");
+    n_compact_regions = n_regions;
+    {
+        W_ per_region = gen->n_old_blocks / n_regions;
+        bdescr *bd = gen->old_blocks;
+        for (uint32_t i = 0; i < n_regions; i++) {
+            compact_regions[i].first = bd;
+            if (i == n_regions - 1) {
+                bd = NULL;
+            } else {
+                for (W_ n = 0; n < per_region; n++) {
+                    bd = bd->link;
+                }
+            }
+            compact_regions[i].end = bd;
+        }
+    }
+
+    // The CNF hash tables go on the shared nfdata_chain; do them here.
+    for (W_ g = 0; g < RtsFlags.GcFlags.generations; g++) {
+        update_fwd_cnf(generations[g].live_compact_objects);
+    }
+
+    compact_threading_in_parallel = true;
+    compactRunOnWorkers(compact_thread_task);
+    compact_threading_in_parallel = false;
+
+    compactRunOnWorkers(compact_forward_task);
+    compactRunOnWorkers(compact_slide_task);
+
+    // Link the blocks still in use back together, freeing the others.
+    W_ blocks = 0;
+    for (uint32_t i = 0; i < n_regions; i++) {
+        CompactRegion *r = &compact_regions[i];
+        bdescr *unused = r->last->link;
+        if (unused != r->end) {
+            bdescr *bd = unused;
+            while (bd->link != r->end) {
+                bd = bd->link;
+            }
+            bd->link = NULL;
+            freeChain(unused);
+        }
+        r->last->link = (i == n_regions - 1) ? NULL : compact_regions[i+1].first;
+        blocks += r->n_blocks;
+    }
+
+    debugTrace(DEBUG_gc,
+               "compact: %d (parallel, old: %d blocks, now %d blocks)",
+               gen->no, gen->n_old_blocks, blocks);
+    gen->n_old_blocks = blocks;
+
+    stgFree(compact_regions);
+    compact_regions = NULL;
+    n_compact_regions = 0;
+}
+
+#endif /* THREADED_RTS */
+
 void
 compact(StgClosure *static_objects,
         StgWeak **dead_weak_ptr_list,
@@ -1017,32 +1354,35 @@ compact(StgClosure *static_objects,
     // the CAF list (used by GHCi)
     markCAFs((evac_fn)thread_root, NULL);
 
-    // 2. update forward ptrs
-    for (W_ g = 0; g < RtsFlags.GcFlags.generations; g++) {
-        generation *gen = &generations[g];
-        debugTrace(DEBUG_gc, "update_fwd:  %d", g);
-
-        update_fwd(gen->blocks);
-        for (W_ n = 0; n < n_capabilities; n++) {
-            update_fwd(gc_threads[n]->gens[g].todo_bd);
-            update_fwd(gc_threads[n]->gens[g].part_list);
-        }
-        update_fwd_large(gen->scavenged_large_objects);
-        update_fwd_cnf(gen->live_compact_objects);
-        if (g == RtsFlags.GcFlags.generations-1 && gen->old_blocks != NULL) {
-            debugTrace(DEBUG_gc, "update_fwd:  %d (compact)", g);
-            update_fwd_compact(gen->old_blocks);
+#if defined(THREADED_RTS)
+    uint32_t n_regions = compact_n_regions(oldest_gen);
+    if (n_regions > 1) {
+        compact_parallel(n_regions);
+    } else
+#endif
+    {
+        // 2. update forward ptrs
+        for (W_ g = 0; g < RtsFlags.GcFlags.generations; g++) {
+            generation *gen = &generations[g];
+            debugTrace(DEBUG_gc, "update_fwd:  %d", g);
+
+            update_fwd_gen(gen);
+            update_fwd_cnf(gen->live_compact_objects);
+            if (g == RtsFlags.GcFlags.generations-1 && gen->old_blocks != NULL) {
+                debugTrace(DEBUG_gc, "update_fwd:  %d (compact)", g);
+                update_fwd_compact(gen->old_blocks);
+            }
         }
-    }
 
-    // 3. update backward ptrs
-    generation *gen = oldest_gen;
-    if (gen->old_blocks != NULL) {
-        W_ blocks = update_bkwd_compact(gen);
-        debugTrace(DEBUG_gc,
-                   "update_bkwd: %d (compact, old: %d blocks, now %d blocks)",
-                   gen->no, gen->n_old_blocks, blocks);
-        gen->n_old_blocks = blocks;
+        // 3. update backward ptrs
+        generation *gen = oldest_gen;
+        if (gen->old_blocks != NULL) {
+            W_ blocks = update_bkwd_compact(gen);
+            debugTrace(DEBUG_gc,
+                       "update_bkwd: %d (compact, old: %d blocks, now %d blocks)",
+                       gen->no, gen->n_old_blocks, blocks);
+            gen->n_old_blocks = blocks;
+        }
     }
 
     // 4. Re-hash hash tables of threaded CNFs.
@@ -148,6 +148,11 @@ volatile StgWord64 whitehole_gc_spin = 0;
 
 bool work_stealing;
 
+#if defined(THREADED_RTS)
+// The task that runOnGcThreads() is running, if any
+static void (*gc_thread_task)(void) = NULL;
+#endif
+
 uint32_t static_flag = STATIC_FLAG_B;
 uint32_t prev_static_flag = STATIC_FLAG_A;
 
@@ -229,6 +234,12 @@ GarbageCollect (uint32_t collect_gen,
 
   ACQUIRE_SM_LOCK;
 
+  // Give the capabilities' cached free blocks back to the block
+  // allocator. See Note [Per-capability block caches] in BlockAlloc.c.
+  for (n = 0; n < n_capabilities; n++) {
+      flushBlockCache(&capabilities[n]->block_cache);
+  }
+
 #if defined(RTS_USER_SIGNALS)
   if (RtsFlags.MiscFlags.install_signal_handlers) {
     // block signals
@@ -430,11 +441,8 @@ GarbageCollect (uint32_t collect_gen,
   markWeakPtrList();
   initWeakForGC();
 
-  // Mark the stable pointer table.
-  markStablePtrTable(mark_root, gct);
-
-  // Remember old stable name addresses.
-  rememberOldStableNameAddresses ();
+  // Mark the stable pointers into the generations being collected.
+  gcStablePtrTable(mark_root, gct, N);
 
   /* -------------------------------------------------------------------------
    * Repeatedly scavenge all the areas we know about until there's no
@@ -464,8 +472,16 @@ GarbageCollect (uint32_t collect_gen,
 
   shutdown_gc_threads(gct->thread_index, idle_cap);
 
+  // No GC thread is stealing any more, so release the todo_q arrays
+  // replaced by resizes during this GC. See Note [Growable WSDeque].
+  for (n = 0; n < n_capabilities; n++) {
+      for (g = 0; g < RtsFlags.GcFlags.generations; g++) {
+          freeWSDequeRetired(gc_threads[n]->gens[g].todo_q);
+      }
+  }
+
   // Now see which stable names are still alive.
-  gcStableNameTable();
+  gcStableNameTable(N);
 
 #if defined(THREADED_RTS)
   if (n_gc_threads == 1) {
@@ -814,7 +830,7 @@ GarbageCollect (uint32_t collect_gen,
 #endif
 
   // Update the stable name hash table
-  updateStableNameTable(major_gc);
+  updateStableNameTable(N);
 
   // unlock the StablePtr table.  Must be before scheduleFinalizers(),
   // because a finalizer may call hs_free_fun_ptr() or
@@ -864,7 +880,7 @@ GarbageCollect (uint32_t collect_gen,
   ACQUIRE_SM_LOCK;
 
   if (major_gc) {
-      W_ need_prealloc, need_live, need, got;
+      W_ need_prealloc, need_live, need;
       uint32_t i;
 
       need_live = 0;
@@ -907,13 +923,16 @@ GarbageCollect (uint32_t collect_gen,
 
       need = BLOCKS_TO_MBLOCKS(need);
 
-      got = mblocks_allocated;
-
-      if (got > need) {
-          returnMemoryToOS(got - need);
-      }
+      // Either release the surplus now or start releasing it
+      // gradually, see Note [Gradual return of memory to the OS].
+      scheduleReturnMemoryToOS(need);
   }
 
+  // Advance the memory return schedule.  An idle GC releases all of
+  // the remaining surplus, as nothing will run the schedule while the
+  // program sleeps.
+  returnIdleMemoryToOS(deadlock_detect);
+
   // extra GC trace info
   IF_DEBUG(gc, statDescribeGens());
 
@@ -990,6 +1009,9 @@ new_gc_thread (uint32_t n, gc_thread *t)
     t->thread_index = n;
     t->free_blocks = NULL;
     t->gc_count = 0;
+    t->steal_seed = n + 1;   // xorshift state must be non-zero
+    t->steals = 0;
+    t->remote_steals = 0;
 
     init_gc_thread(t);
 
@@ -1016,7 +1038,7 @@ new_gc_thread (uint32_t n, gc_thread *t)
             ws->todo_lim = bd->start + BLOCK_SIZE_W;
         }
 
-        ws->todo_q = newWSDeque(128);
+        ws->todo_q = newWSDeque(TODO_Q_INIT_SIZE, TODO_Q_MAX_SIZE);
         ws->todo_overflow = NULL;
         ws->n_todo_overflow = 0;
         ws->todo_large_objects = NULL;
@@ -1055,6 +1077,10 @@ initGcThreads (uint32_t from USED_IF_THREADS, uint32_t to USED_IF_THREADS)
 
         new_gc_thread(i, gc_threads[i]);
     }
+
+    if (from == 0) {
+        initSpinLock(&split_arrays_sync);
+    }
 #else
     ASSERT(from == 0 && to == 1);
     gc_threads = stgMallocBytes (sizeof(gc_thread*),"alloc_gc_threads");
@@ -1137,17 +1163,11 @@ any_work (void)
     }
 
 #if defined(THREADED_RTS)
-    if (work_stealing) {
-        uint32_t n;
-        // look for work to steal
-        for (n = 0; n < n_gc_threads; n++) {
-            if (n == gct->thread_index) continue;
-            for (g = RtsFlags.GcFlags.generations-1; g >= 0; g--) {
-                ws = &gc_threads[n]->gens[g];
-                if (!looksEmptyWSDeque(ws->todo_q)) return true;
-            }
-        }
-    }
+    // chunks of a large array split across the GC threads
+    if (split_arrays != NULL) return true;
+
+    // look for work to steal, see Note [NUMA-aware work stealing]
+    if (work_stealing && any_work_to_steal()) return true;
 #endif
 
     gct->no_work++;
@@ -1253,13 +1273,24 @@ gcWorkerThread (Capability *cap)
     pruneSparkQueue(false, cap);
 #endif
 
-    // Wait until we're told to continue
+    // Wait until we're told to continue, running any tasks that the
+    // main GC thread hands out with runOnGcThreads() meanwhile
     RELEASE_SPIN_LOCK(&gct->gc_spin);
     gct->wakeup = GC_THREAD_WAITING_TO_CONTINUE;
     debugTrace(DEBUG_gc, "GC thread %d waiting to continue...",
                gct->thread_index);
     stat_endGCWorker (cap, gct);
     ACQUIRE_SPIN_LOCK(&gct->mut_spin);
+    while (gct->wakeup == GC_THREAD_RUNNING) {
+        gc_thread_task();
+        // the same handshake as at the start of the GC, in reverse
+        RELEASE_SPIN_LOCK(&gct->mut_spin);
+        gct->wakeup = GC_THREAD_STANDING_BY;
+        ACQUIRE_SPIN_LOCK(&gct->gc_spin);
+        RELEASE_SPIN_LOCK(&gct->gc_spin);
+        gct->wakeup = GC_THREAD_WAITING_TO_CONTINUE;
+        ACQUIRE_SPIN_LOCK(&gct->mut_spin);
+    }
     debugTrace(DEBUG_gc, "GC thread %d on my way...", gct->thread_index);
 
     SET_GCT(saved_gct);
@@ -1399,6 +1430,73 @@ releaseGCThreads (Capability *cap USED_IF_THREADS, bool idle_cap[])
         RELEASE_SPIN_LOCK(&gc_threads[i]->mut_spin);
     }
 }
+
+/* ----------------------------------------------------------------------------
+   Running a task on the GC threads
+
+   Once the heap has been scavenged (after shutdown_gc_threads()), the GC
+   threads that helped with this collection are waiting to continue,
+   each blocked on its mut_spin, which we hold.  runOnGcThreads(task)
+   wakes up to n-1 of them to run task alongside us, by setting their
+   wakeup to GC_THREAD_RUNNING and releasing mut_spin, and waits until
+   they have all finished and are waiting to continue again.  The tasks
+   share out their own work; see Note [Parallel compaction].
+   ------------------------------------------------------------------------- */
+
+// The number of threads that runOnGcThreads() can use: this one and the
+// GC threads waiting to continue.
+uint32_t
+gcThreadsAvailable (void)
+{
+    uint32_t i, n = 1;
+
+    for (i = 0; i < n_gc_threads; i++) {
+        if (i != gct->thread_index
+            && gc_threads[i]->wakeup == GC_THREAD_WAITING_TO_CONTINUE) {
+            n++;
+        }
+    }
+    return n;
+}
+
+void
+runOnGcThreads (void (*task)(void), uint32_t n)
+{
+    const uint32_t me = gct->thread_index;
+    bool helping[n_gc_threads];
+    uint32_t i;
+
+    gc_thread_task = task;
+    for (i = 0; i < n_gc_threads; i++) {
+        helping[i] = n > 1 && i != me
+            && gc_threads[i]->wakeup == GC_THREAD_WAITING_TO_CONTINUE;
+        if (!helping[i]) continue;
+        n--;
+        ACQUIRE_SPIN_LOCK(&gc_threads[i]->gc_spin);
+        gc_threads[i]->wakeup = GC_THREAD_RUNNING;
+        RELEASE_SPIN_LOCK(&gc_threads[i]->mut_spin);
+    }
+
+    task();
+
+    for (i = 0; i < n_gc_threads; i++) {
+        if (!helping[i]) continue;
+        while (gc_threads[i]->wakeup != GC_THREAD_STANDING_BY) {
+            busy_wait_nop();
+            write_barrier();
+        }
+        ACQUIRE_SPIN_LOCK(&gc_threads[i]->mut_spin);
+        RELEASE_SPIN_LOCK(&gc_threads[i]->gc_spin);
+    }
+    for (i = 0; i < n_gc_threads; i++) {
+        if (!helping[i]) continue;
+        while (gc_threads[i]->wakeup != GC_THREAD_WAITING_TO_CONTINUE) {
+            busy_wait_nop();
+            write_barrier();
+        }
+    }
+    gc_thread_task = NULL;
+}
 #endif
 
 /* ----------------------------------------------------------------------------
@@ -2015,5 +2113,13 @@ void gcCAFs(void)
 
 bool doIdleGCWork(Capability *cap STG_UNUSED, bool all)
 {
+    // Returning memory is never "outstanding" work that 'all' should
+    // finish off: it runs to a schedule, see
+    // Note [Gradual return of memory to the OS].
+    if (memoryReturnPending()) {
+        ACQUIRE_SM_LOCK;
+        returnIdleMemoryToOS(false);
+        RELEASE_SM_LOCK;
+    }
     return runSomeFinalizers(all);
 }
@@ -65,6 +65,8 @@ void resizeGenerations (void);
 #if defined(THREADED_RTS)
 void waitForGcThreads (Capability *cap, bool idle_cap[]);
 void releaseGCThreads (Capability *cap, bool idle_cap[]);
+uint32_t gcThreadsAvailable (void);
+void runOnGcThreads (void (*task)(void), uint32_t n);
 #endif
 
 #define WORK_UNIT_WORDS 128
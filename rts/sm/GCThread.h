@@ -75,6 +75,10 @@
 
    ------------------------------------------------------------------------- */
 
+// Initial and maximum number of entries in a gen_workspace's todo_q
+#define TODO_Q_INIT_SIZE 128
+#define TODO_Q_MAX_SIZE  (64 * 1024)
+
 typedef struct gen_workspace_ {
     generation * gen;           // the gen for this workspace
     struct gc_thread_ * my_gct; // the gc_thread that contains this workspace
@@ -85,6 +89,9 @@ typedef struct gen_workspace_ {
     StgPtr       todo_lim;             // lim for todo_bd
     struct NonmovingSegment *todo_seg; // only available for oldest gen workspace
 
+    // Blocks waiting to be scavenged, which other GC threads may steal.
+    // todo_q grows up to TODO_Q_MAX_SIZE entries; beyond that blocks go
+    // on the (unstealable) todo_overflow list.
     WSDeque *    todo_q;
     bdescr *     todo_overflow;
     uint32_t     n_todo_overflow;
@@ -143,6 +150,11 @@ typedef struct gc_thread_ {
 
     W_ gc_count;                   // number of GCs this thread has done
 
+    uint32_t steal_seed;           // where to start looking for victims,
+                                   // see Note [NUMA-aware work stealing]
+    W_ steals;                     // todo blocks stolen, over all GCs
+    W_ remote_steals;              // ... of which from another NUMA node
+
     // block that is currently being scanned
     bdescr *     scan_bd;
 
@@ -22,12 +22,16 @@
 #include "GCUtils.h"
 #include "Printer.h"
 #include "Trace.h"
+#include "RtsUtils.h"
 #if defined(THREADED_RTS)
 #include "WSDeque.h"
 #endif
 
 #if defined(THREADED_RTS)
 SpinLock gc_alloc_block_sync;
+
+SplitArray *split_arrays = NULL;
+SpinLock split_arrays_sync;
 #endif
 
 bdescr* allocGroup_sync(uint32_t n)
@@ -118,22 +122,117 @@ grab_local_todo_block (gen_workspace *ws)
 }
 
 #if defined(THREADED_RTS)
+/*
+  Note [NUMA-aware work stealing]
+  ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+  A GC thread that runs out of work steals todo blocks from the other
+  GC threads.  Scanning a stolen block means reading (and copying out
+  of) memory that the victim has just written, so on a NUMA machine
+  stealing from a thread on another node pulls remote cache lines into
+  our cache, and the evacuated objects then land in our node's blocks.
+  We therefore steal in two tiers: first from threads on our own node,
+  and only when none of them has anything from threads on other nodes.
+
+  Within a tier we start from a random victim rather than from thread
+  0, so that idle threads don't all hammer the same deque.  any_work()
+  looks at the victims in the same order.
+
+  gc_thread counts its steals and how many of them crossed a node
+  boundary; the totals are reported by +RTS -s.
+*/
+
+// Choose where to start looking for victims.
+STATIC_INLINE uint32_t
+steal_start (void)
+{
+    return xorshift32(&gct->steal_seed) % n_gc_threads;
+}
+
+// Is GC thread n a candidate in the given tier: tier 0 is our own
+// NUMA node, tier 1 every other node.
+STATIC_INLINE bool
+steal_victim_in_tier (uint32_t n, uint32_t tier)
+{
+    return n != gct->thread_index
+        && numaPassIncludes(tier, capNoToNumaNode(gct->thread_index),
+                            capNoToNumaNode(n));
+}
+
 bdescr *
 steal_todo_block (uint32_t g)
 {
-    uint32_t n;
+    uint32_t i, n, start, tier;
     bdescr *bd;
 
-    // look for work to steal
-    for (n = 0; n < n_gc_threads; n++) {
-        if (n == gct->thread_index) continue;
-        bd = stealWSDeque(gc_threads[n]->gens[g].todo_q);
-        if (bd) {
-            return bd;
+    // look for work to steal, see Note [NUMA-aware work stealing]
+    for (tier = 0; tier < numaPasses(); tier++) {
+        start = steal_start();
+        for (i = 0; i < n_gc_threads; i++) {
+            n = (start + i) % n_gc_threads;
+            if (!steal_victim_in_tier(n, tier)) continue;
+            bd = stealWSDeque(gc_threads[n]->gens[g].todo_q);
+            if (bd) {
+                gct->steals++;
+                if (tier > 0) gct->remote_steals++;
+                return bd;
+            }
         }
     }
     return NULL;
 }
+
+// Does another GC thread look like it has work we could steal?
+bool
+any_work_to_steal (void)
+{
+    uint32_t i, n, start, tier;
+    int g;
+
+    for (tier = 0; tier < numaPasses(); tier++) {
+        start = steal_start();
+        for (i = 0; i < n_gc_threads; i++) {
+            n = (start + i) % n_gc_threads;
+            if (!steal_victim_in_tier(n, tier)) continue;
+            for (g = RtsFlags.GcFlags.generations-1; g >= 0; g--) {
+                if (!looksEmptyWSDeque(gc_threads[n]->gens[g].todo_q)) {
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+void
+push_split_array (SplitArray *sa)
+{
+    ACQUIRE_SPIN_LOCK(&split_arrays_sync);
+    sa->link = split_arrays;
+    split_arrays = sa;
+    RELEASE_SPIN_LOCK(&split_arrays_sync);
+}
+
+// Claim the next chunk of a split array, returning NULL if there are
+// none left.  An array is taken off the list once its last chunk has
+// been claimed; the thread that finishes the last chunk frees it.
+SplitArray *
+grab_split_array_chunk (StgWord *chunk)
+{
+    SplitArray *sa;
+
+    if (split_arrays == NULL) return NULL;
+
+    ACQUIRE_SPIN_LOCK(&split_arrays_sync);
+    sa = split_arrays;
+    if (sa != NULL) {
+        *chunk = sa->next_chunk++;
+        if (sa->next_chunk == sa->n_chunks) {
+            split_arrays = sa->link;
+        }
+    }
+    RELEASE_SPIN_LOCK(&split_arrays_sync);
+    return sa;
+}
 #endif
 
 void
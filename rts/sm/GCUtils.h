@@ -40,6 +40,27 @@ StgPtr  alloc_todo_block     (gen_workspace *ws, uint32_t size);
 bdescr *grab_local_todo_block  (gen_workspace *ws);
 #if defined(THREADED_RTS)
 bdescr *steal_todo_block       (uint32_t s);
+bool    any_work_to_steal      (void);
+
+// A large array whose scavenging has been split into chunks that any GC
+// thread may pick up.  See Note [Scavenging large arrays in parallel] in
+// Scav.c.
+typedef struct SplitArray_ {
+    StgClosure *arr;
+    uint32_t gen_no;            // generation the array lives in
+    bool marked_only;           // only scavenge marked cards (mutable list)
+    StgWord n_chunks;
+    StgWord next_chunk;         // protected by split_arrays_sync
+    volatile StgWord chunks_left;
+    volatile StgWord failed;    // some chunk failed to evacuate
+    struct SplitArray_ *link;
+} SplitArray;
+
+extern SplitArray *split_arrays;
+extern SpinLock split_arrays_sync;
+
+void        push_split_array       (SplitArray *sa);
+SplitArray *grab_split_array_chunk (StgWord *chunk);
 #endif
 
 // Returns true if a block is partially full.  This predicate is used to try
@@ -220,13 +220,46 @@ static void *getCommittedMBlocks(uint32_t n)
     return p;
 }
 
+// When the heap is backed by huge pages, decommit only the huge pages
+// that are entirely free once [address, address+size) has been freed,
+// so that we never split one that is still partly in use.  Must be
+// called before the range is added to the free list.
+// See Note [Transparent huge pages] in posix/OSMem.c.
+static void decommitHugePages(W_ address, W_ size, W_ huge)
+{
+    struct free_list *iter;
+    W_ lo = address;
+    W_ hi = address + size;
+
+    // extend the range over the free neighbours it will coalesce with
+    for (iter = free_list_head; iter != NULL; iter = iter->next) {
+        if (iter->address + iter->size == lo) lo = iter->address;
+        if (iter->address == hi) hi += iter->size;
+    }
+    if (hi >= mblock_high_watermark) {
+        // everything above the high watermark is free too
+        hi = stg_min(roundUpToAlign(hi, huge), mblock_address_space.end);
+    }
+
+    lo = roundUpToAlign(lo, huge);
+    hi = hi & ~(huge - 1);
+    if (lo < hi) {
+        osDecommitMemory((void*)lo, hi - lo);
+    }
+}
+
 static void decommitMBlocks(char *addr, uint32_t n)
 {
     struct free_list *iter, *prev;
     W_ size = MBLOCK_SIZE * (W_)n;
     W_ address = (W_)addr;
+    W_ huge = osHugePageSize();
 
-    osDecommitMemory(addr, size);
+    if (huge > MBLOCK_SIZE) {
+        decommitHugePages(address, size, huge);
+    } else {
+        osDecommitMemory(addr, size);
+    }
 
     prev = NULL;
     for (iter = free_list_head; iter != NULL; iter = iter->next)
@@ -165,7 +165,8 @@ Mutex concurrent_coll_finished_lock;
  *
  *  6. [CONC] Sweep: Here we walk over the nonmoving segments on sweep_list
  *     and place them back on either the active, current, or filled list,
- *     depending upon how much live data they contain.
+ *     depending upon how much live data they contain. Allocating threads may
+ *     help with this (see Note [Lazy sweeping in the nonmoving collector]).
  *
  *
  * === Marking ===
@@ -396,7 +397,7 @@ static void* nonmovingConcurrentMark(void *mark_queue);
 #endif
 static void nonmovingMark_(MarkQueue *mark_queue, StgWeak **dead_weaks, StgTSO **resurrected_threads);
 
-static void nonmovingInitSegment(struct NonmovingSegment *seg, uint8_t log_block_size)
+void nonmovingInitSegment(struct NonmovingSegment *seg, uint8_t log_block_size)
 {
     bdescr *bd = Bdescr((P_) seg);
     seg->link = NULL;
@@ -424,6 +425,14 @@ void nonmovingPushFreeSegment(struct NonmovingSegment *seg)
         return;
     }
 
+    nonmovingCacheFreeSegment(seg);
+}
+
+// Add a segment to the free list without ever returning it to the block
+// allocator, for callers which can't take sm_mutex. n_free may then exceed
+// NONMOVING_MAX_FREE until the segments are reused.
+void nonmovingCacheFreeSegment(struct NonmovingSegment *seg)
+{
     while (true) {
         struct NonmovingSegment *old = nonmovingHeap.free;
         seg->link = old;
@@ -590,6 +599,12 @@ void *nonmovingAllocate(Capability *cap, StgWord sz)
         // first look for a new segment in the active list
         struct NonmovingSegment *new_current = pop_active_segment(alloca);
 
+        // there are no active segments, perhaps we can sweep one ourselves
+        // (see Note [Lazy sweeping in the nonmoving collector])
+        if (new_current == NULL && nonmoving_lazy_sweep_open) {
+            new_current = nonmovingLazySweep(cap->node, log_block_size);
+        }
+
         // there are no active segments, allocate new segment
         if (new_current == NULL) {
             new_current = nonmovingAllocSegment(cap->node);
@@ -633,6 +648,9 @@ void nonmovingInit(void)
         nonmovingHeap.allocators[i] = alloc_nonmoving_allocator(n_capabilities);
     }
     nonmovingMarkInitUpdRemSet();
+#if defined(THREADED_RTS)
+    nonmovingInitMarkWorkers();
+#endif
 }
 
 // Stop any nonmoving collection in preparation for RTS shutdown.
@@ -657,6 +675,7 @@ void nonmovingExit(void)
     nonmovingStop();
 
 #if defined(THREADED_RTS)
+    nonmovingStopMarkWorkers();
     closeMutex(&concurrent_coll_finished_lock);
     closeCondition(&concurrent_coll_finished);
     closeMutex(&nonmoving_collection_mutex);
@@ -131,6 +131,8 @@ void nonmovingCollect(StgWeak **dead_weaks,
 void *nonmovingAllocate(Capability *cap, StgWord sz);
 void nonmovingAddCapabilities(uint32_t new_n_caps);
 void nonmovingPushFreeSegment(struct NonmovingSegment *seg);
+void nonmovingCacheFreeSegment(struct NonmovingSegment *seg);
+void nonmovingInitSegment(struct NonmovingSegment *seg, uint8_t log_block_size);
 void nonmovingClearBitmap(struct NonmovingSegment *seg);
 
 
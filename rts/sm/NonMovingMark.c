@@ -19,6 +19,7 @@
 #include "Trace.h"
 #include "HeapUtils.h"
 #include "Printer.h"
+#include "RtsUtils.h"
 #include "Schedule.h"
 #include "Weak.h"
 #include "Stats.h"
@@ -89,9 +90,10 @@ memcount n_nonmoving_marked_compact_blocks = 0;
  * move the same large object to nonmoving_marked_large_objects more than once.
  */
 static Mutex nonmoving_large_objects_mutex;
-// Note that we don't need a similar lock for compact objects because we never
-// mark a compact object eagerly in a write barrier; all compact objects are
-// marked by the mark thread, so there can't be any races here.
+// We never mark a compact object eagerly in a write barrier, however with
+// parallel marking several mark workers may race to mark the same compact
+// object. Consequently we also take nonmoving_large_objects_mutex when moving
+// compact objects to nonmoving_marked_compact_objects.
 #endif
 
 /*
@@ -430,11 +432,17 @@ push (MarkQueue *q, const MarkQueueEnt *ent)
             // allocate a fresh block.
             ACQUIRE_SM_LOCK;
             bdescr *bd = allocGroup(MARK_QUEUE_BLOCKS);
+            RELEASE_SM_LOCK;
+            ((MarkQueueBlock *) bd->start)->head = 0;
+            // The block we just filled becomes visible to thieves.
+            ACQUIRE_SPIN_LOCK(&q->steal_lock);
             bd->link = q->blocks;
             q->blocks = bd;
             q->top = (MarkQueueBlock *) bd->start;
-            q->top->head = 0;
-            RELEASE_SM_LOCK;
+#if defined(THREADED_RTS)
+            q->n_stealable++;
+#endif
+            RELEASE_SPIN_LOCK(&q->steal_lock);
         }
     }
 
@@ -800,16 +808,23 @@ again:
 
     // Are we at the beginning of the block?
     if (top->head == 0) {
-        // Is this the first block of the queue?
-        if (q->blocks->link == NULL) {
+        // Is this the first block of the queue? Note that we must check this
+        // while holding steal_lock as a thief may take the block below us.
+        ACQUIRE_SPIN_LOCK(&q->steal_lock);
+        bdescr *old_block = q->blocks;
+        if (old_block->link == NULL) {
             // Yes, therefore queue is empty...
+            RELEASE_SPIN_LOCK(&q->steal_lock);
             MarkQueueEnt none = { .null_entry = { .p = NULL } };
             return none;
         } else {
             // No, unwind to the previous block and try popping again...
-            bdescr *old_block = q->blocks;
             q->blocks = old_block->link;
             q->top = (MarkQueueBlock*)q->blocks->start;
+#if defined(THREADED_RTS)
+            q->n_stealable--;
+#endif
+            RELEASE_SPIN_LOCK(&q->steal_lock);
             ACQUIRE_SM_LOCK;
             freeGroup(old_block); // TODO: hold on to a block to avoid repeated allocation/deallocation?
             RELEASE_SM_LOCK;
@@ -878,6 +893,10 @@ static void init_mark_queue_ (MarkQueue *queue)
     memset(&queue->prefetch_queue, 0, sizeof(queue->prefetch_queue));
     queue->prefetch_head = 0;
 #endif
+#if defined(THREADED_RTS)
+    initSpinLock(&queue->steal_lock);
+    queue->n_stealable = 0;
+#endif
 }
 
 /* Must hold sm_mutex. */
@@ -1281,12 +1300,16 @@ mark_closure (MarkQueue *queue, const StgClosure *p0, StgClosure **origin)
             }
 
             if (! (bd->flags & BF_MARKED)) {
-                dbl_link_remove(bd, &nonmoving_compact_objects);
-                dbl_link_onto(bd, &nonmoving_marked_compact_objects);
-                StgWord blocks = str->totalW / BLOCK_SIZE_W;
-                n_nonmoving_compact_blocks -= blocks;
-                n_nonmoving_marked_compact_blocks += blocks;
-                bd->flags |= BF_MARKED;
+                ACQUIRE_LOCK(&nonmoving_large_objects_mutex);
+                if (! (bd->flags & BF_MARKED)) {
+                    dbl_link_remove(bd, &nonmoving_compact_objects);
+                    dbl_link_onto(bd, &nonmoving_marked_compact_objects);
+                    StgWord blocks = str->totalW / BLOCK_SIZE_W;
+                    n_nonmoving_compact_blocks -= blocks;
+                    n_nonmoving_marked_compact_blocks += blocks;
+                    bd->flags |= BF_MARKED;
+                }
+                RELEASE_LOCK(&nonmoving_large_objects_mutex);
             }
 
             // N.B. the object being marked is in a compact region so by
@@ -1646,7 +1669,10 @@ mark_closure (MarkQueue *queue, const StgClosure *p0, StgClosure **origin)
         struct NonmovingSegment *seg = nonmovingGetSegment((StgPtr) p);
         nonmoving_block_idx block_idx = nonmovingGetBlockIdx((StgPtr) p);
         nonmovingSetMark(seg, block_idx);
-        nonmoving_live_words += nonmovingSegmentBlockSize(seg) / sizeof(W_);
+        // N.B. may race with other mark workers, see
+        // Note [Parallel marking in the nonmoving collector].
+        atomic_inc((StgVolatilePtr) &nonmoving_live_words,
+                   nonmovingSegmentBlockSize(seg) / sizeof(W_));
     }
 
     // If we found a indirection to shortcut keep going.
@@ -1665,6 +1691,464 @@ done:
     }
 }
 
+/* Note [Parallel marking in the nonmoving collector]
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * With --nonmoving-mark-threads=<n> (n > 1) the mark thread is joined by n-1
+ * helper threads, each of which drains its own MarkQueue. The helpers are
+ * started lazily by the first parallel pass and then sleep on
+ * mark_workers_start_cond between passes; nonmovingMark wakes them up (using
+ * nonmovingRunOnWorkers), takes part in marking itself using the global mark
+ * queue and returns when every worker has run out of work. The same helpers
+ * are also used to sweep in parallel (see nonmovingSweep).
+ *
+ * Work is shared at the granularity of mark queue blocks. The owner of a
+ * queue pushes and pops entries of its top block without synchronisation.
+ * The blocks below the top block are all non-empty and may be stolen by idle
+ * workers. Any change to the block chain of a queue (by the owner or by a
+ * thief) happens while holding the queue's steal_lock and n_stealable counts
+ * the blocks a thief may take. Since a block holds a few thousand entries a
+ * worker which notices that others are idle splits its top block in two,
+ * making the older half stealable (see share_mark_work).
+ *
+ * Marking itself is already safe in the face of concurrent markers since the
+ * mutator's write barrier may mark objects as well:
+ *
+ *  - setting the mark bit of a small object is idempotent (although two
+ *    workers may both trace the object, which is harmless),
+ *  - static objects are claimed with a CAS on their static link field,
+ *  - stacks are claimed with a CAS on StgStack.marking,
+ *  - large and compact objects are marked with nonmoving_large_objects_mutex
+ *    held.
+ *
+ * nonmoving_live_words is updated atomically, although it may slightly
+ * overestimate liveness if two workers race to mark the same object.
+ *
+ * Termination is detected with a counter of idle workers: a worker whose
+ * queue is empty and which cannot steal or pull from the update remembered
+ * set counts itself as idle and sleeps on mark_work_cond until either all
+ * workers are idle, in which case the pass is finished, or some queue
+ * becomes stealable again. share_mark_work signals the condition when it
+ * makes a block stealable and the last worker to become idle broadcasts it.
+ * The counter and the check for work are done with mark_workers_mutex held,
+ * and so is the signal, so an idle worker cannot miss a wake-up. Update
+ * remembered set blocks flushed during the pass don't wake anybody; a busy
+ * worker picks them up when its queue runs dry and shares them from there.
+ * Mutators may flush more update remembered set blocks after the pass is
+ * finished; these are picked up by the next pass (there is always one in the
+ * post-mark synchronisation).
+ *
+ * Each worker reports its index and the number of entries it processed
+ * with traceConcMarkBegin and traceConcMarkEnd.
+ */
+
+#if defined(THREADED_RTS)
+// Number of workers (including the mark thread itself) taking part in each
+// parallel mark pass. Zero until nonmovingInitMarkWorkers has run.
+uint32_t n_mark_workers = 0;
+
+// The mark queues of the workers; index 0 is the queue passed to
+// nonmovingMark by the mark thread.
+MarkQueue **mark_worker_queues = NULL;
+
+// Protects the fields below.
+static Mutex mark_workers_mutex;
+// Signalled when a new mark pass starts or when the helpers should exit.
+static Condition mark_workers_start_cond;
+// Signalled when a helper finishes its part of the current pass or exits.
+static Condition mark_workers_done_cond;
+// Incremented at the beginning of every parallel pass.
+static uint32_t mark_pass = 0;
+// The work to be done by each worker in the current pass.
+static void (*mark_pass_task)(uint32_t worker) = NULL;
+// Number of helpers which haven't yet finished the current pass.
+static uint32_t mark_workers_active = 0;
+// Number of helper threads still alive.
+static uint32_t mark_workers_alive = 0;
+static bool mark_workers_exiting = false;
+// Signalled when an idle worker may find work to steal or when all workers
+// are idle.
+static Condition mark_work_cond;
+// Number of workers with nothing to do in the current pass. Only read
+// without the lock by share_mark_work, as a hint.
+static volatile StgWord mark_workers_idle = 0;
+#endif
+
+/* Move the entries of the update remembered set into the given mark queue,
+ * which must be empty. Returns false if there was nothing to move.
+ */
+static bool
+pull_upd_rem_set (MarkQueue *queue)
+{
+    if (upd_rem_set_block_list == NULL) {
+        return false;
+    }
+
+    ACQUIRE_LOCK(&upd_rem_set_lock);
+    bdescr *blocks = upd_rem_set_block_list;
+    upd_rem_set_block_list = NULL;
+    RELEASE_LOCK(&upd_rem_set_lock);
+    if (blocks == NULL) {
+        // Another worker beat us to it
+        return false;
+    }
+
+    ACQUIRE_SPIN_LOCK(&queue->steal_lock);
+    bdescr *old = queue->blocks;
+    queue->blocks = blocks;
+    queue->top = (MarkQueueBlock *) blocks->start;
+#if defined(THREADED_RTS)
+    StgWord n = 0;
+    for (bdescr *bd = blocks->link; bd != NULL; bd = bd->link) {
+        n++;
+    }
+    queue->n_stealable = n;
+#endif
+    RELEASE_SPIN_LOCK(&queue->steal_lock);
+
+    ACQUIRE_SM_LOCK;
+    freeGroup(old);
+    RELEASE_SM_LOCK;
+    return true;
+}
+
+#if defined(THREADED_RTS)
+
+// Is there anything for an idle worker to do?
+static bool
+mark_work_available (void)
+{
+    if (upd_rem_set_block_list != NULL) {
+        return true;
+    }
+    for (uint32_t i = 0; i < n_mark_workers; i++) {
+        if (mark_worker_queues[i]->n_stealable > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Try to steal a block of entries from another worker's queue into the
+ * (empty) queue of worker `me`. Victims are tried in a round-robin order
+ * starting at the worker after `me` to avoid all thieves converging on the
+ * same victim.
+ */
+static bool
+steal_mark_work (MarkQueue *queue, uint32_t me)
+{
+    for (uint32_t i = 1; i < n_mark_workers; i++) {
+        MarkQueue *victim = mark_worker_queues[(me + i) % n_mark_workers];
+        if (victim->n_stealable == 0) {
+            continue;
+        }
+
+        ACQUIRE_SPIN_LOCK(&victim->steal_lock);
+        bdescr *stolen = victim->blocks->link;
+        if (stolen == NULL) {
+            RELEASE_SPIN_LOCK(&victim->steal_lock);
+            continue;
+        }
+        victim->blocks->link = stolen->link;
+        victim->n_stealable--;
+        RELEASE_SPIN_LOCK(&victim->steal_lock);
+
+        // Our queue is empty (a single block with no entries); replace it
+        // with the stolen block.
+        stolen->link = NULL;
+        ACQUIRE_SPIN_LOCK(&queue->steal_lock);
+        bdescr *old = queue->blocks;
+        ASSERT(old->link == NULL);
+        queue->blocks = stolen;
+        queue->top = (MarkQueueBlock *) stolen->start;
+        RELEASE_SPIN_LOCK(&queue->steal_lock);
+
+        ACQUIRE_SM_LOCK;
+        freeGroup(old);
+        RELEASE_SM_LOCK;
+        return true;
+    }
+    return false;
+}
+
+// Below this many entries in the top block we don't bother sharing work.
+#define MARK_SHARE_THRESHOLD 64
+
+/* If other workers are idle and our queue has nothing for them to steal then
+ * split our top block, moving the newer half of its entries into a fresh top
+ * block and thereby making the older half stealable.
+ */
+static void
+share_mark_work (MarkQueue *queue)
+{
+    if (mark_workers_idle == 0 || queue->n_stealable > 0) {
+        return;
+    }
+
+    MarkQueueBlock *top = queue->top;
+    uint32_t n = top->head;
+    if (n < MARK_SHARE_THRESHOLD) {
+        return;
+    }
+
+    ACQUIRE_SM_LOCK;
+    bdescr *bd = allocGroup(MARK_QUEUE_BLOCKS);
+    RELEASE_SM_LOCK;
+
+    MarkQueueBlock *new_top = (MarkQueueBlock *) bd->start;
+    uint32_t keep = n / 2;
+    memcpy(new_top->entries, &top->entries[keep],
+           (n - keep) * sizeof(MarkQueueEnt));
+    new_top->head = n - keep;
+
+    ACQUIRE_SPIN_LOCK(&queue->steal_lock);
+    top->head = keep;
+    bd->link = queue->blocks;
+    queue->blocks = bd;
+    queue->top = new_top;
+    queue->n_stealable++;
+    RELEASE_SPIN_LOCK(&queue->steal_lock);
+
+    // Wake up an idle worker to steal it
+    ACQUIRE_LOCK(&mark_workers_mutex);
+    signalCondition(&mark_work_cond);
+    RELEASE_LOCK(&mark_workers_mutex);
+}
+
+#endif /* THREADED_RTS */
+
+/* Mark a single mark queue entry. */
+STATIC_INLINE void
+mark_entry (MarkQueue *queue, MarkQueueEnt *ent)
+{
+    switch (nonmovingMarkQueueEntryType(ent)) {
+    case MARK_CLOSURE:
+        mark_closure(queue, ent->mark_closure.p, ent->mark_closure.origin);
+        break;
+    case MARK_ARRAY: {
+        const StgMutArrPtrs *arr = (const StgMutArrPtrs *)
+            UNTAG_CLOSURE((StgClosure *) ent->mark_array.array);
+        StgWord start = ent->mark_array.start_index;
+        StgWord end = start + MARK_ARRAY_CHUNK_LENGTH;
+        if (end < arr->ptrs) {
+            // There is more to be marked after this chunk.
+            markQueuePushArray(queue, arr, end);
+        } else {
+            end = arr->ptrs;
+        }
+        for (StgWord i = start; i < end; i++) {
+            markQueuePushClosure_(queue, arr->payload[i]);
+        }
+        break;
+    }
+    case NULL_ENTRY:
+        barf("mark_entry: NULL_ENTRY");
+    }
+}
+
+#if defined(THREADED_RTS)
+
+// How often (in processed entries) a busy worker checks whether it should
+// share work with idle workers.
+#define MARK_SHARE_INTERVAL 256
+
+/* The mark loop run by every worker of a parallel mark pass; see
+ * Note [Parallel marking in the nonmoving collector].
+ */
+static void
+nonmovingMarkWorker (MarkQueue *queue, uint32_t me)
+{
+    traceConcMarkBegin(me);
+    debugTrace(DEBUG_nonmoving_gc, "Mark worker %d: starting mark pass", me);
+    unsigned int count = 0;
+    while (true) {
+        MarkQueueEnt ent = markQueuePop(queue);
+        if (nonmovingMarkQueueEntryType(&ent) != NULL_ENTRY) {
+            count++;
+            mark_entry(queue, &ent);
+            if (count % MARK_SHARE_INTERVAL == 0) {
+                share_mark_work(queue);
+            }
+            continue;
+        }
+
+        if (pull_upd_rem_set(queue) || steal_mark_work(queue, me)) {
+            continue;
+        }
+
+        // Nothing to do; sleep until either somebody has work to steal or
+        // everybody is idle.
+        ACQUIRE_LOCK(&mark_workers_mutex);
+        mark_workers_idle++;
+        while (true) {
+            if (mark_workers_idle == n_mark_workers) {
+                broadcastCondition(&mark_work_cond);
+                RELEASE_LOCK(&mark_workers_mutex);
+                goto finished;
+            }
+            if (mark_work_available()) {
+                mark_workers_idle--;
+                break;
+            }
+            waitCondition(&mark_work_cond, &mark_workers_mutex);
+        }
+        RELEASE_LOCK(&mark_workers_mutex);
+    }
+
+finished:
+    debugTrace(DEBUG_nonmoving_gc, "Mark worker %d: finished mark pass: %d",
+               me, count);
+    traceConcMarkEnd(me, count);
+}
+
+static void *
+nonmovingMarkWorkerThread (void *data)
+{
+    uint32_t me = (uint32_t) (StgWord) data;
+    uint32_t last_pass = 0;
+
+    ACQUIRE_LOCK(&mark_workers_mutex);
+    while (true) {
+        while (mark_pass == last_pass && !mark_workers_exiting) {
+            waitCondition(&mark_workers_start_cond, &mark_workers_mutex);
+        }
+        if (mark_workers_exiting) {
+            break;
+        }
+        last_pass = mark_pass;
+        void (*task)(uint32_t) = mark_pass_task;
+        RELEASE_LOCK(&mark_workers_mutex);
+
+        task(me);
+
+        ACQUIRE_LOCK(&mark_workers_mutex);
+        mark_workers_active--;
+        if (mark_workers_active == 0) {
+            signalCondition(&mark_workers_done_cond);
+        }
+    }
+    mark_workers_alive--;
+    signalCondition(&mark_workers_done_cond);
+    RELEASE_LOCK(&mark_workers_mutex);
+    return NULL;
+}
+
+/* Initialise the parallel mark workers. Called by nonmovingInit. The helper
+ * threads themselves are started by the first parallel mark pass.
+ */
+void
+nonmovingInitMarkWorkers (void)
+{
+    n_mark_workers = RtsFlags.GcFlags.nonmovingMarkThreads;
+    if (n_mark_workers <= 1) {
+        return;
+    }
+
+    initMutex(&mark_workers_mutex);
+    initCondition(&mark_workers_start_cond);
+    initCondition(&mark_workers_done_cond);
+    initCondition(&mark_work_cond);
+    mark_worker_queues =
+        stgMallocBytes(n_mark_workers * sizeof(MarkQueue *),
+                       "nonmovingInitMarkWorkers");
+    // Index 0 is filled in by each pass with the mark thread's queue.
+    mark_worker_queues[0] = NULL;
+    for (uint32_t i = 1; i < n_mark_workers; i++) {
+        mark_worker_queues[i] = NULL;
+    }
+}
+
+static void
+start_mark_workers (void)
+{
+    ACQUIRE_SM_LOCK;
+    for (uint32_t i = 1; i < n_mark_workers; i++) {
+        mark_worker_queues[i] =
+            stgMallocBytes(sizeof(MarkQueue), "start_mark_workers");
+        initMarkQueue(mark_worker_queues[i]);
+    }
+    RELEASE_SM_LOCK;
+
+    for (uint32_t i = 1; i < n_mark_workers; i++) {
+        OSThreadId tid;
+        if (createOSThread(&tid, "non-moving mark worker",
+                           nonmovingMarkWorkerThread, (void *) (StgWord) i) != 0) {
+            barf("start_mark_workers: failed to spawn mark worker: %s",
+                 strerror(errno));
+        }
+        mark_workers_alive++;
+    }
+}
+
+/* Stop the helper threads and free their mark queues. Called by
+ * nonmovingExit after the collector has stopped.
+ */
+void
+nonmovingStopMarkWorkers (void)
+{
+    if (n_mark_workers <= 1) {
+        return;
+    }
+
+    ACQUIRE_LOCK(&mark_workers_mutex);
+    mark_workers_exiting = true;
+    broadcastCondition(&mark_workers_start_cond);
+    while (mark_workers_alive > 0) {
+        waitCondition(&mark_workers_done_cond, &mark_workers_mutex);
+    }
+    RELEASE_LOCK(&mark_workers_mutex);
+
+    for (uint32_t i = 1; i < n_mark_workers; i++) {
+        if (mark_worker_queues[i]) {
+            freeMarkQueue(mark_worker_queues[i]);
+            stgFree(mark_worker_queues[i]);
+        }
+    }
+    stgFree(mark_worker_queues);
+    mark_worker_queues = NULL;
+
+    closeCondition(&mark_work_cond);
+    closeCondition(&mark_workers_done_cond);
+    closeCondition(&mark_workers_start_cond);
+    closeMutex(&mark_workers_mutex);
+    n_mark_workers = 0;
+}
+
+/* Run the given task on each of the n_mark_workers workers, the calling
+ * thread taking the part of worker 0, and return once all of them have
+ * finished. Only called by the mark thread.
+ */
+void
+nonmovingRunOnWorkers (void (*task)(uint32_t worker))
+{
+    ASSERT(n_mark_workers > 1);
+    if (mark_worker_queues[1] == NULL) {
+        start_mark_workers();
+    }
+
+    ACQUIRE_LOCK(&mark_workers_mutex);
+    mark_workers_active = n_mark_workers - 1;
+    mark_pass_task = task;
+    mark_pass++;
+    broadcastCondition(&mark_workers_start_cond);
+    RELEASE_LOCK(&mark_workers_mutex);
+
+    task(0);
+
+    ACQUIRE_LOCK(&mark_workers_mutex);
+    while (mark_workers_active > 0) {
+        waitCondition(&mark_workers_done_cond, &mark_workers_mutex);
+    }
+    RELEASE_LOCK(&mark_workers_mutex);
+}
+
+static void
+nonmovingMarkTask (uint32_t worker)
+{
+    nonmovingMarkWorker(mark_worker_queues[worker], worker);
+}
+
+#endif /* THREADED_RTS */
+
 /* This is the main mark loop.
  * Invariants:
  *
@@ -1676,53 +2160,31 @@ done:
 GNUC_ATTR_HOT void
 nonmovingMark (MarkQueue *queue)
 {
-    traceConcMarkBegin();
+#if defined(THREADED_RTS)
+    if (n_mark_workers > 1) {
+        mark_worker_queues[0] = queue;
+        mark_workers_idle = 0;
+        nonmovingRunOnWorkers(nonmovingMarkTask);
+        return;
+    }
+#endif
+
+    traceConcMarkBegin(0);
     debugTrace(DEBUG_nonmoving_gc, "Starting mark pass");
     unsigned int count = 0;
     while (true) {
         count++;
         MarkQueueEnt ent = markQueuePop(queue);
 
-        switch (nonmovingMarkQueueEntryType(&ent)) {
-        case MARK_CLOSURE:
-            mark_closure(queue, ent.mark_closure.p, ent.mark_closure.origin);
-            break;
-        case MARK_ARRAY: {
-            const StgMutArrPtrs *arr = (const StgMutArrPtrs *)
-                UNTAG_CLOSURE((StgClosure *) ent.mark_array.array);
-            StgWord start = ent.mark_array.start_index;
-            StgWord end = start + MARK_ARRAY_CHUNK_LENGTH;
-            if (end < arr->ptrs) {
-                // There is more to be marked after this chunk.
-                markQueuePushArray(queue, arr, end);
-            } else {
-                end = arr->ptrs;
-            }
-            for (StgWord i = start; i < end; i++) {
-                markQueuePushClosure_(queue, arr->payload[i]);
-            }
-            break;
-        }
-        case NULL_ENTRY:
-            // Perhaps the update remembered set has more to mark...
-            if (upd_rem_set_block_list) {
-                ACQUIRE_LOCK(&upd_rem_set_lock);
-                bdescr *old = queue->blocks;
-                queue->blocks = upd_rem_set_block_list;
-                queue->top = (MarkQueueBlock *) queue->blocks->start;
-                upd_rem_set_block_list = NULL;
-                RELEASE_LOCK(&upd_rem_set_lock);
-
-                ACQUIRE_SM_LOCK;
-                freeGroup(old);
-                RELEASE_SM_LOCK;
-            } else {
-                // Nothing more to do
-                debugTrace(DEBUG_nonmoving_gc, "Finished mark pass: %d", count);
-                traceConcMarkEnd(count);
-                return;
-            }
+        if (nonmovingMarkQueueEntryType(&ent) != NULL_ENTRY) {
+            mark_entry(queue, &ent);
+        } else if (!pull_upd_rem_set(queue)) {
+            // Nothing more to do
+            debugTrace(DEBUG_nonmoving_gc, "Finished mark pass: %d", count);
+            traceConcMarkEnd(0, count);
+            return;
         }
+        // Otherwise the update remembered set had more to mark...
     }
 }
 
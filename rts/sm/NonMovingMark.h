@@ -103,6 +103,17 @@ typedef struct MarkQueue_ {
     // The first free slot in prefetch_queue.
     uint8_t prefetch_head;
 #endif
+
+#if defined(THREADED_RTS)
+    // Protects the block chain (but not the entries of the top block) from
+    // other mark workers stealing from this queue.
+    // See Note [Parallel marking in the nonmoving collector].
+    SpinLock steal_lock;
+
+    // Number of full blocks below top which may be stolen. Only modified
+    // while holding steal_lock but read without it by idle workers.
+    volatile StgWord n_stealable;
+#endif
 } MarkQueue;
 
 /* While it shares its representation with MarkQueue, UpdRemSet differs in
@@ -135,6 +146,10 @@ extern StgIndStatic *debug_caf_list_snapshot;
 #endif
 
 extern MarkQueue *current_mark_queue;
+#if defined(THREADED_RTS)
+extern uint32_t n_mark_workers;
+extern MarkQueue **mark_worker_queues;
+#endif
 extern bdescr *upd_rem_set_block_list;
 
 
@@ -160,6 +175,12 @@ void initMarkQueue(MarkQueue *queue);
 void freeMarkQueue(MarkQueue *queue);
 void nonmovingMark(struct MarkQueue_ *restrict queue);
 
+#if defined(THREADED_RTS)
+void nonmovingInitMarkWorkers(void);
+void nonmovingStopMarkWorkers(void);
+void nonmovingRunOnWorkers(void (*task)(uint32_t worker));
+#endif
+
 bool nonmovingTidyWeaks(struct MarkQueue_ *queue);
 void nonmovingTidyThreads(void);
 void nonmovingMarkDeadWeaks(struct MarkQueue_ *queue, StgWeak **dead_weak_ptr_list);
@@ -128,33 +128,181 @@ clear_segment_free_blocks(struct NonmovingSegment* seg)
 
 #endif
 
+/* Note [Lazy sweeping in the nonmoving collector]
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * Once marking has finished the mark thread sweeps the segments on
+ * nonmovingHeap.sweep_list, which may take a while on a large heap. With
+ * --nonmoving-lazy-sweep we allow allocating threads to help: when
+ * nonmovingAllocate runs out of active segments while the sweep is in
+ * progress it pops segments from sweep_list and sweeps them itself, using the
+ * first one which has room for its block size instead of asking the block
+ * allocator for a fresh segment. A segment found to be free is only reused if
+ * it lives on the allocating capability's NUMA node; otherwise it goes to the
+ * free segment list.
+ *
+ * The sweep list may only be used in this way after marking has finished
+ * (segments are moved to sweep_list at the beginning of the mark); the mark
+ * thread indicates this by setting nonmoving_lazy_sweep_open for the duration
+ * of nonmovingSweep. All sweepers (the mark thread, the parallel sweep workers
+ * and allocating threads) take segments off of sweep_list with
+ * nonmovingPopSweepSegment. Since segments are never pushed back to sweep_list
+ * during sweep this is safe from ABA issues.
+ *
+ * An allocating thread may still be sweeping the segments it popped when
+ * sweep_list runs dry and the other sweepers finish. So each allocating
+ * thread counts itself in nonmoving_lazy_sweepers while it sweeps. After
+ * nonmovingSweep clears nonmoving_lazy_sweep_open it waits for that count to
+ * drop to zero. An allocating thread checks nonmoving_lazy_sweep_open again
+ * after it has counted itself in. Both sides write their own variable and
+ * then read the other's, with a full barrier in between, so either the
+ * allocating thread backs off or the mark thread waits for it. Since the
+ * next collection can't start before nonmovingSweep has returned (see
+ * concurrent_coll_running), segments are always swept in the same cycle in
+ * which they were marked.
+ */
+
+/* Set while the mark thread is sweeping and lazy sweeping is enabled. */
+volatile bool nonmoving_lazy_sweep_open = false;
+
+/* Number of allocating threads in nonmovingLazySweep. */
+static volatile StgWord nonmoving_lazy_sweepers = 0;
+
+// How many segments an allocating thread may sweep before giving up and
+// allocating a fresh segment.
+#define NONMOVING_LAZY_SWEEP_MAX_SEGMENTS 4
+
+/* Take a segment off of the sweep list. Returns NULL if the list is empty. */
+static struct NonmovingSegment *nonmovingPopSweepSegment(void)
+{
+    while (true) {
+        struct NonmovingSegment *seg =
+            (struct NonmovingSegment *) VOLATILE_LOAD(&nonmovingHeap.sweep_list);
+        if (seg == NULL) {
+            return NULL;
+        }
+        if (cas((StgVolatilePtr) &nonmovingHeap.sweep_list,
+                (StgWord) seg,
+                (StgWord) seg->link) == (StgWord) seg) {
+            return seg;
+        }
+    }
+}
+
+/* Sweep a segment taken off of the sweep list and place it on the free,
+ * active, or filled list as appropriate. */
+static void nonmovingSweepAndPushSegment(struct NonmovingSegment *seg)
+{
+    enum SweepResult ret = nonmovingSweepSegment(seg);
+
+    switch (ret) {
+    case SEGMENT_FREE:
+        IF_DEBUG(sanity, clear_segment(seg));
+        nonmovingPushFreeSegment(seg);
+        break;
+    case SEGMENT_PARTIAL:
+        IF_DEBUG(sanity, clear_segment_free_blocks(seg));
+        nonmovingPushActiveSegment(seg);
+        break;
+    case SEGMENT_FILLED:
+        nonmovingPushFilledSegment(seg);
+        break;
+    default:
+        barf("nonmovingSweep: weird sweep return: %d\n", ret);
+    }
+}
+
+static void nonmovingSweepWorker(uint32_t worker STG_UNUSED)
+{
+    struct NonmovingSegment *seg;
+    while ((seg = nonmovingPopSweepSegment()) != NULL) {
+        nonmovingSweepAndPushSegment(seg);
+    }
+}
+
 GNUC_ATTR_HOT void nonmovingSweep(void)
 {
-    while (nonmovingHeap.sweep_list) {
-        struct NonmovingSegment *seg = nonmovingHeap.sweep_list;
+    if (RtsFlags.GcFlags.nonmovingLazySweep) {
+        nonmoving_lazy_sweep_open = true;
+    }
 
-        // Pushing the segment to one of the free/active/filled segments
-        // updates the link field, so update sweep_list here
-        nonmovingHeap.sweep_list = seg->link;
+#if defined(THREADED_RTS)
+    // Sweep in parallel if we have parallel mark workers
+    if (n_mark_workers > 1) {
+        nonmovingRunOnWorkers(nonmovingSweepWorker);
+    } else
+#endif
+    {
+        nonmovingSweepWorker(0);
+    }
 
-        enum SweepResult ret = nonmovingSweepSegment(seg);
+    if (RtsFlags.GcFlags.nonmovingLazySweep) {
+        nonmoving_lazy_sweep_open = false;
+        store_load_barrier();
+        // wait for allocating threads which are still sweeping
+        while (nonmoving_lazy_sweepers != 0) {
+            yieldThread();
+        }
+    }
+}
 
-        switch (ret) {
+/* Sweep segments from the sweep list on behalf of nonmovingAllocate until we
+ * find one which can serve as the current segment of the allocator for the
+ * given block size on the given NUMA node. Returns NULL if none was found.
+ *
+ * We may be called by a GC thread while sm_mutex is held by the GC leader, so
+ * unlike nonmovingSweep we must not return free segments to the block
+ * allocator; we reuse those of our node for our own block size and keep the
+ * others on the free segment list.
+ *
+ * See Note [Lazy sweeping in the nonmoving collector].
+ */
+static struct NonmovingSegment *lazySweepSegments(uint32_t node,
+                                                  uint8_t log_block_size)
+{
+    for (int i = 0; i < NONMOVING_LAZY_SWEEP_MAX_SEGMENTS; i++) {
+        struct NonmovingSegment *seg = nonmovingPopSweepSegment();
+        if (seg == NULL) {
+            return NULL;
+        }
+
+        switch (nonmovingSweepSegment(seg)) {
         case SEGMENT_FREE:
             IF_DEBUG(sanity, clear_segment(seg));
-            nonmovingPushFreeSegment(seg);
+            if (Bdescr((P_) seg)->node == node) {
+                nonmovingInitSegment(seg, log_block_size);
+                return seg;
+            }
+            nonmovingCacheFreeSegment(seg);
             break;
         case SEGMENT_PARTIAL:
             IF_DEBUG(sanity, clear_segment_free_blocks(seg));
+            if (nonmovingSegmentLogBlockSize(seg) == log_block_size) {
+                return seg;
+            }
             nonmovingPushActiveSegment(seg);
             break;
         case SEGMENT_FILLED:
             nonmovingPushFilledSegment(seg);
             break;
-        default:
-            barf("nonmovingSweep: weird sweep return: %d\n", ret);
         }
     }
+    return NULL;
+}
+
+struct NonmovingSegment *nonmovingLazySweep(uint32_t node,
+                                            uint8_t log_block_size)
+{
+    struct NonmovingSegment *seg = NULL;
+
+    atomic_inc(&nonmoving_lazy_sweepers, 1);
+    // Our caller saw nonmoving_lazy_sweep_open, but nonmovingSweep may have
+    // finished since, and then sweep_list may already belong to the next
+    // collection. Look again now that nonmovingSweep will wait for us.
+    if (nonmoving_lazy_sweep_open) {
+        seg = lazySweepSegments(node, log_block_size);
+    }
+    atomic_dec(&nonmoving_lazy_sweepers);
+    return seg;
 }
 
 /* Must a closure remain on the mutable list?
@@ -11,8 +11,15 @@
 #include "NonMoving.h"
 #include "Hash.h"
 
+extern volatile bool nonmoving_lazy_sweep_open;
+
 GNUC_ATTR_HOT void nonmovingSweep(void);
 
+// Sweep segments on behalf of an allocator which has run out of active
+// segments. See Note [Lazy sweeping in the nonmoving collector].
+struct NonmovingSegment *nonmovingLazySweep(uint32_t node,
+                                            uint8_t log_block_size);
+
 // Remove unmarked entries in oldest generation mut_lists
 void nonmovingSweepMutLists(void);
 
@@ -24,6 +24,12 @@ uint32_t osNumaNodes(void);
 uint64_t osNumaMask(void);
 void osBindMBlocksToNode(void *addr, StgWord size, uint32_t node);
 
+// Transparent huge pages, see Note [Transparent huge pages] in
+// posix/OSMem.c.  osHugePageSize() is 0 unless +RTS --huge-pages is in
+// effect.
+W_ osHugePageSize(void);
+W_ osHeapHugePageBytes(void);
+
 INLINE_HEADER size_t
 roundDownToPage (size_t x)
 {
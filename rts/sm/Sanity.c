@@ -941,6 +941,14 @@ findMemoryLeak (void)
         markNonMovingSegments(nonmovingHeap.free);
         if (current_mark_queue)
             markBlocks(current_mark_queue->blocks);
+#if defined(THREADED_RTS)
+        // The queues of the parallel mark helpers; index 0 is
+        // current_mark_queue.
+        for (i = 1; i < n_mark_workers; i++) {
+            if (mark_worker_queues[i])
+                markBlocks(mark_worker_queues[i]->blocks);
+        }
+#endif
     }
 
 #if defined(PROFILING)
@@ -1012,6 +1020,12 @@ genBlocks (generation *gen)
         ret += countNonMovingHeap(&nonmovingHeap);
         if (current_mark_queue)
             ret += countBlocks(current_mark_queue->blocks);
+#if defined(THREADED_RTS)
+        for (uint32_t i = 1; i < n_mark_workers; i++) {
+            if (mark_worker_queues[i])
+                ret += countBlocks(mark_worker_queues[i]->blocks);
+        }
+#endif
     } else {
         ASSERT(countBlocks(gen->blocks) == gen->n_blocks);
         ASSERT(countCompactBlocks(gen->compact_objects) == gen->n_compact_blocks);
@@ -56,6 +56,7 @@
 #include "Apply.h"
 #include "Trace.h"
 #include "Sanity.h"
+#include "RtsUtils.h"
 #include "Capability.h"
 #include "LdvProfile.h"
 #include "HeapUtils.h"
@@ -1570,6 +1571,209 @@ scavenge_one(StgPtr p)
     return (no_luck);
 }
 
+#if defined(PARALLEL_GC)
+/* -----------------------------------------------------------------------------
+   Note [Scavenging large arrays in parallel]
+   ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+   A large array is a single unit of work: whichever GC thread takes its
+   block off todo_large_objects (or finds it on a mutable list) scavenges
+   the whole thing, while the other threads may be left with nothing to
+   steal.  With a multi-gigabyte array this serialises the tail of the GC.
+
+   So in the parallel GC, when a thread meets a pointer array with at
+   least SPLIT_ARRAY_MIN_CHUNKS chunks, it wraps it in a SplitArray
+   descriptor and pushes that on the global split_arrays list instead of
+   scavenging it.  A chunk of a MUT_ARR_PTRS is SPLIT_ARRAY_CHUNK_CARDS
+   cards of its card table; a SMALL_MUT_ARR_PTRS has no card table, so
+   its chunks are just the same number of elements.  Any thread in
+   scavenge_find_work() can claim the next chunk with
+   grab_split_array_chunk(), and any_work() counts pending chunks as
+   work, so idle threads pick them up.
+
+   Each chunk updates its own cards exactly as scavenge_mut_arr_ptrs()
+   (or scavenge_mut_arr_ptrs_marked(), for arrays from a mutable list)
+   would.  Whether anything failed to evacuate is accumulated in the
+   descriptor; the thread that finishes the last chunk sets the array's
+   CLEAN/DIRTY header, records it on its mutable list if needed, and
+   frees the descriptor.  Nothing else reads the header of a split array
+   during the GC, so updating it late is safe.
+   -------------------------------------------------------------------------- */
+
+#define SPLIT_ARRAY_CHUNK_CARDS 64
+#define SPLIT_ARRAY_CHUNK_ELEMS (SPLIT_ARRAY_CHUNK_CARDS << MUT_ARR_PTRS_CARD_BITS)
+#define SPLIT_ARRAY_MIN_CHUNKS  4
+
+// Returns true if the array has been handed over to the split_arrays
+// list, in which case the caller must not scavenge or record it.
+static bool
+split_large_array (StgPtr p, uint32_t gen_no, bool marked_only)
+{
+    StgWord ptrs, n_chunks;
+    SplitArray *sa;
+
+    if (!work_stealing || n_gc_threads == 1) return false;
+
+    switch (get_itbl((StgClosure *)p)->type) {
+    case MUT_ARR_PTRS_CLEAN:
+    case MUT_ARR_PTRS_DIRTY:
+    case MUT_ARR_PTRS_FROZEN_CLEAN:
+    case MUT_ARR_PTRS_FROZEN_DIRTY:
+        ptrs = ((StgMutArrPtrs *)p)->ptrs;
+        break;
+    case SMALL_MUT_ARR_PTRS_CLEAN:
+    case SMALL_MUT_ARR_PTRS_DIRTY:
+    case SMALL_MUT_ARR_PTRS_FROZEN_CLEAN:
+    case SMALL_MUT_ARR_PTRS_FROZEN_DIRTY:
+        ptrs = ((StgSmallMutArrPtrs *)p)->ptrs;
+        break;
+    default:
+        return false;
+    }
+
+    n_chunks = (ptrs + SPLIT_ARRAY_CHUNK_ELEMS - 1) / SPLIT_ARRAY_CHUNK_ELEMS;
+    if (n_chunks < SPLIT_ARRAY_MIN_CHUNKS) return false;
+
+    sa = stgMallocBytes(sizeof(SplitArray), "split_large_array");
+    sa->arr = (StgClosure *)p;
+    sa->gen_no = gen_no;
+    sa->marked_only = marked_only;
+    sa->n_chunks = n_chunks;
+    sa->next_chunk = 0;
+    sa->chunks_left = n_chunks;
+    sa->failed = 0;
+    push_split_array(sa);
+    return true;
+}
+
+// Called by the thread that scavenged the last chunk of a split array.
+static void
+finish_split_array (SplitArray *sa, bool is_mutable)
+{
+    StgClosure *p = sa->arr;
+    bool failed = sa->failed != 0;
+
+    switch (get_itbl(p)->type) {
+    case MUT_ARR_PTRS_CLEAN:
+    case MUT_ARR_PTRS_DIRTY:
+        p->header.info = failed ? &stg_MUT_ARR_PTRS_DIRTY_info
+                                : &stg_MUT_ARR_PTRS_CLEAN_info;
+        break;
+    case MUT_ARR_PTRS_FROZEN_CLEAN:
+    case MUT_ARR_PTRS_FROZEN_DIRTY:
+        p->header.info = failed ? &stg_MUT_ARR_PTRS_FROZEN_DIRTY_info
+                                : &stg_MUT_ARR_PTRS_FROZEN_CLEAN_info;
+        break;
+    case SMALL_MUT_ARR_PTRS_CLEAN:
+    case SMALL_MUT_ARR_PTRS_DIRTY:
+        p->header.info = failed ? &stg_SMALL_MUT_ARR_PTRS_DIRTY_info
+                                : &stg_SMALL_MUT_ARR_PTRS_CLEAN_info;
+        break;
+    case SMALL_MUT_ARR_PTRS_FROZEN_CLEAN:
+    case SMALL_MUT_ARR_PTRS_FROZEN_DIRTY:
+        p->header.info = failed ? &stg_SMALL_MUT_ARR_PTRS_FROZEN_DIRTY_info
+                                : &stg_SMALL_MUT_ARR_PTRS_FROZEN_CLEAN_info;
+        break;
+    default:
+        barf("finish_split_array: strange closure type %d",
+             (int)(get_itbl(p)->type));
+    }
+
+    // mutable arrays always stay on the mutable list, as in scavenge_one()
+    if ((is_mutable || failed) && sa->gen_no > 0) {
+        recordMutableGen_GC(p, sa->gen_no);
+    }
+}
+
+static void
+scavenge_split_array_chunk (SplitArray *sa, StgWord chunk)
+{
+    StgClosure *arr = sa->arr;
+    bool saved_eager_promotion = gct->eager_promotion;
+    uint32_t saved_evac_gen_no = gct->evac_gen_no;
+    bool any_failed = false;
+    bool is_mutable;
+    StgPtr p, q;
+
+    gct->evac_gen_no = sa->gen_no;
+    gct->failed_to_evac = false;
+
+    switch (get_itbl(arr)->type) {
+    case MUT_ARR_PTRS_CLEAN:
+    case MUT_ARR_PTRS_DIRTY:
+    case SMALL_MUT_ARR_PTRS_CLEAN:
+    case SMALL_MUT_ARR_PTRS_DIRTY:
+        // no eager promotion for mutable arrays, see scavenge_one()
+        is_mutable = true;
+        gct->eager_promotion = false;
+        break;
+    default:
+        is_mutable = false;
+        break;
+    }
+
+    switch (get_itbl(arr)->type) {
+    case MUT_ARR_PTRS_CLEAN:
+    case MUT_ARR_PTRS_DIRTY:
+    case MUT_ARR_PTRS_FROZEN_CLEAN:
+    case MUT_ARR_PTRS_FROZEN_DIRTY:
+    {
+        StgMutArrPtrs *a = (StgMutArrPtrs *)arr;
+        W_ m = chunk * SPLIT_ARRAY_CHUNK_CARDS;
+        W_ end = stg_min(m + SPLIT_ARRAY_CHUNK_CARDS, mutArrPtrsCards(a->ptrs));
+
+        for (; m < end; m++) {
+            if (sa->marked_only && *mutArrPtrsCard(a,m) == 0) continue;
+            p = (StgPtr)&a->payload[m << MUT_ARR_PTRS_CARD_BITS];
+            q = stg_min(p + (1 << MUT_ARR_PTRS_CARD_BITS),
+                        (StgPtr)&a->payload[a->ptrs]);
+            // stats; the mutable list isn't counted, as in
+            // scavenge_mutable_list()
+            if (!sa->marked_only) gct->scanned += q - p;
+            for (; p < q; p++) {
+                evacuate((StgClosure**)p);
+            }
+            if (gct->failed_to_evac) {
+                any_failed = true;
+                *mutArrPtrsCard(a,m) = 1;
+                gct->failed_to_evac = false;
+            } else {
+                *mutArrPtrsCard(a,m) = 0;
+            }
+        }
+        break;
+    }
+    default:
+    {
+        StgSmallMutArrPtrs *a = (StgSmallMutArrPtrs *)arr;
+        p = (StgPtr)&a->payload[chunk * SPLIT_ARRAY_CHUNK_ELEMS];
+        q = stg_min(p + SPLIT_ARRAY_CHUNK_ELEMS,
+                    (StgPtr)&a->payload[a->ptrs]);
+        gct->scanned += q - p;
+        for (; p < q; p++) {
+            evacuate((StgClosure**)p);
+        }
+        any_failed = gct->failed_to_evac;
+        break;
+    }
+    }
+
+    if (any_failed) {
+        sa->failed = 1;
+    }
+    gct->failed_to_evac = false;
+    gct->eager_promotion = saved_eager_promotion;
+    gct->evac_gen_no = saved_evac_gen_no;
+
+    // atomic_dec() is a full barrier, so the last thread out sees every
+    // other chunk's failures and card updates.
+    if (atomic_dec(&sa->chunks_left) == 0) {
+        finish_split_array(sa, is_mutable);
+        stgFree(sa);
+    }
+}
+#endif /* PARALLEL_GC */
+
 /* -----------------------------------------------------------------------------
    Scavenging mutable lists.
 
@@ -1640,6 +1844,14 @@ scavenge_mutable_list(bdescr *bd, generation *gen)
             case MUT_ARR_PTRS_DIRTY:
             {
                 bool saved_eager_promotion;
+
+#if defined(PARALLEL_GC)
+                // See Note [Scavenging large arrays in parallel]
+                if (split_large_array(p, gen_no, true)) {
+                    continue;
+                }
+#endif
+
                 saved_eager_promotion = gct->eager_promotion;
                 gct->eager_promotion = false;
 
@@ -2013,6 +2225,15 @@ scavenge_large (gen_workspace *ws)
         }
         RELEASE_SPIN_LOCK(&ws->gen->sync);
 
+#if defined(PARALLEL_GC)
+        // big arrays are scavenged in chunks by all the GC threads;
+        // see Note [Scavenging large arrays in parallel]
+        if (!(bd->flags & BF_COMPACT) &&
+            split_large_array(p, ws->gen->no, false)) {
+            continue;
+        }
+#endif
+
         if (scavenge_one(p)) {
             if (ws->gen->no > 0) {
                 recordMutableGen_GC((StgClosure *)p, ws->gen->no);
@@ -2100,6 +2321,21 @@ loop:
         goto loop;
     }
 
+#if defined(PARALLEL_GC)
+    {
+        // help with any large arrays that have been split into chunks;
+        // see Note [Scavenging large arrays in parallel]
+        SplitArray *sa;
+        StgWord chunk;
+
+        if ((sa = grab_split_array_chunk(&chunk)) != NULL) {
+            scavenge_split_array_chunk(sa, chunk);
+            did_anything = true;
+            goto loop;
+        }
+    }
+#endif
+
 #if defined(THREADED_RTS)
     if (work_stealing) {
         // look for work to steal
@@ -1026,8 +1026,15 @@ allocateMightFail (Capability *cap, W_ n)
         // Only credit allocation after we've passed the size check above
         accountAllocation(cap, n);
 
-        ACQUIRE_SM_LOCK
-        bd = allocGroupOnNode(cap->node,req_blocks);
+        // small large objects come from the capability's block cache, so
+        // we only need sm_mutex for the large_objects list
+        if (req_blocks <= BLOCK_CACHE_MAX_GROUP) {
+            bd = allocGroupCached(&cap->block_cache, req_blocks);
+            ACQUIRE_SM_LOCK;
+        } else {
+            ACQUIRE_SM_LOCK;
+            bd = allocGroupOnNode(cap->node,req_blocks);
+        }
         dbl_link_onto(bd, &g0->large_objects);
         g0->n_large_blocks += bd->blocks; // might be larger than req_blocks
         g0->n_new_large_words += n;
@@ -1055,10 +1062,8 @@ allocateMightFail (Capability *cap, W_ n)
         if (bd == NULL) {
             // The nursery is empty: allocate a fresh block (we can't
             // fail here).
-            ACQUIRE_SM_LOCK;
-            bd = allocBlockOnNode(cap->node);
+            bd = allocGroupCached(&cap->block_cache, 1);
             cap->r.rNursery->n_blocks++;
-            RELEASE_SM_LOCK;
             initBdescr(bd, g0, g0);
             bd->flags = 0;
             // If we had to allocate a new block, then we'll GC
@@ -1216,9 +1221,7 @@ allocatePinned (Capability *cap, W_ n /*words*/, W_ alignment /*bytes*/, W_ alig
         if (bd == NULL) {
             // The nursery is empty: allocate a fresh block (we can't fail
             // here).
-            ACQUIRE_SM_LOCK;
-            bd = allocBlockOnNode(cap->node);
-            RELEASE_SM_LOCK;
+            bd = allocGroupCached(&cap->block_cache, 1);
             initBdescr(bd, g0, g0);
         } else {
             newNurseryBlock(bd);
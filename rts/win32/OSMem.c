@@ -59,6 +59,10 @@ osMemInit(void)
                 "osBindMBlocksToNode: VirtualAllocExNuma does not exist. How did you get this far?");
         }
     }
+
+    if (RtsFlags.GcFlags.hugePages) {
+        errorBelch("warning: --huge-pages is not supported on this platform");
+    }
 }
 
 static
@@ -593,3 +597,13 @@ void osBindMBlocksToNode(
         }
     }
 }
+
+W_ osHugePageSize(void)
+{
+    return 0;
+}
+
+W_ osHeapHugePageBytes(void)
+{
+    return 0;
+}
@@ -14,6 +14,13 @@ static HANDLE timer_queue = NULL;
 static HANDLE timer       = NULL;
 static Time tick_interval = 0;
 
+// With --tickless, idleTicker() replaces the timer from the timer thread
+// while startTicker() and stopTicker() run on the RTS's own threads, so
+// timer and ticker_running are protected by timer_lock.  This is a plain
+// critical section because the non-threaded RTS has no Mutex.
+static CRITICAL_SECTION timer_lock;
+static bool ticker_running = false;
+
 static VOID CALLBACK tick_callback(
   PVOID lpParameter STG_UNUSED,
   BOOLEAN TimerOrWaitFired STG_UNUSED
@@ -42,6 +49,8 @@ initTicker (Time interval, TickProc handle_tick)
     tick_interval = interval;
     tick_proc = handle_tick;
 
+    InitializeCriticalSection(&timer_lock);
+
     timer_queue = CreateTimerQueue();
     if (timer_queue == NULL) {
         sysErrorBelch("CreateTimerQueue");
@@ -49,8 +58,20 @@ initTicker (Time interval, TickProc handle_tick)
     }
 }
 
-void
-startTicker(void)
+// Called with timer_lock held.  Doesn't wait for the timer's callbacks
+// to finish, because idleTicker() calls this from one of them.
+static void
+deleteTimer(void)
+{
+    if (timer_queue != NULL && timer != NULL) {
+        DeleteTimerQueueTimer(timer_queue, timer, NULL);
+        timer = NULL;
+    }
+}
+
+// Called with timer_lock held.
+static void
+createTimer(Time first_tick)
 {
     BOOL r;
 
@@ -58,7 +79,7 @@ startTicker(void)
                               timer_queue,
                               tick_callback,
                               0,
-                              0,
+                              TimeToMS(first_tick),    // ms
                               TimeToMS(tick_interval), // ms
                               WT_EXECUTEINTIMERTHREAD);
     if (r == 0) {
@@ -68,20 +89,51 @@ startTicker(void)
 }
 
 void
-stopTicker(void)
+startTicker(void)
 {
-    if (timer_queue != NULL && timer != NULL) {
-        DeleteTimerQueueTimer(timer_queue, timer, NULL);
-        timer = NULL;
+    EnterCriticalSection(&timer_lock);
+    // idleTicker() may have left a timer running
+    if (RtsFlags.MiscFlags.tickless) {
+        deleteTimer();
+    }
+    createTimer(0);
+    ticker_running = true;
+    LeaveCriticalSection(&timer_lock);
+}
+
+void
+idleTicker(Time timeout)
+{
+    EnterCriticalSection(&timer_lock);
+    // We are called from tick_callback(); if the ticker has been stopped
+    // since that tick was delivered, leave it stopped.
+    if (ticker_running) {
+        deleteTimer();
+        createTimer(timeout);
     }
+    LeaveCriticalSection(&timer_lock);
+}
+
+void
+stopTicker(void)
+{
+    EnterCriticalSection(&timer_lock);
+    deleteTimer();
+    ticker_running = false;
+    LeaveCriticalSection(&timer_lock);
 }
 
 void
 exitTicker (bool wait)
 {
     stopTicker();
+    // Not holding timer_lock: with wait, DeleteTimerQueueEx waits for
+    // running callbacks, which may be waiting for the lock in idleTicker().
     if (timer_queue != NULL) {
         DeleteTimerQueueEx(timer_queue, wait ? INVALID_HANDLE_VALUE : NULL);
         timer_queue = NULL;
     }
+    if (wait) {
+        DeleteCriticalSection(&timer_lock);
+    }
 }
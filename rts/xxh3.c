@@ -0,0 +1,471 @@
+/*
+*  XXH3 - 64-bit variant of the xxHash algorithm
+*  Copyright (C) 2012-2020, Yann Collet
+*
+*  BSD 2-Clause License (http://www.opensource.org/licenses/bsd-license.php)
+*
+*  Redistribution and use in source and binary forms, with or without
+*  modification, are permitted provided that the following conditions are
+*  met:
+*
+*  * Redistributions of source code must retain the above copyright
+*  notice, this list of conditions and the following disclaimer.
+*  * Redistributions in binary form must reproduce the above
+*  copyright notice, this list of conditions and the following disclaimer
+*  in the documentation and/or other materials provided with the
+*  distribution.
+*
+*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+*  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+*  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+*  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+*  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+*  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+*  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+*  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+*  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+*  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+*  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*
+*  You can contact the author at :
+*  - xxHash homepage: http://www.xxhash.com
+*  - xxHash source repository : https://github.com/Cyan4973/xxHash
+*/
+
+/*
+ * This is XXH3_64bits() from xxHash 0.8 (with the default secret and no
+ * seed), cut down to what the RTS needs: hashing the keys of its string
+ * hash tables, mostly mangled symbol names of 20 to 150 bytes.  The long
+ * input path (more than 240 bytes) uses AVX2 or SSE2 when the RTS is
+ * compiled for them, like the upstream code without runtime dispatch.
+ * The results are the same as upstream's, whatever the path.
+ */
+
+#include "PosixSource.h"
+#include "Rts.h"
+
+#include "xxh3.h"
+
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+typedef uint8_t  xxh_u8;
+typedef uint32_t xxh_u32;
+typedef uint64_t xxh_u64;
+
+#define XXH_PRIME32_1  0x9E3779B1U
+#define XXH_PRIME32_2  0x85EBCA77U
+#define XXH_PRIME32_3  0xC2B2AE3DU
+#define XXH_PRIME64_1  0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2  0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3  0x165667B19E3779F9ULL
+#define XXH_PRIME64_4  0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5  0x27D4EB2F165667C5ULL
+#define XXH_PRIME_MX1  0x165667919E3779F9ULL
+#define XXH_PRIME_MX2  0x9FB21C651E98DF25ULL
+
+#define XXH_SECRET_SIZE 192
+#define XXH_SECRET_SIZE_MIN 136
+#define XXH_MIDSIZE_MAX 240
+#define XXH_MIDSIZE_STARTOFFSET 3
+#define XXH_MIDSIZE_LASTOFFSET 17
+#define XXH_STRIPE_LEN 64
+#define XXH_SECRET_CONSUME_RATE 8
+#define XXH_ACC_NB 8
+#define XXH_SECRET_LASTACC_START 7
+#define XXH_SECRET_MERGEACCS_START 11
+
+/* Pseudorandom secret taken directly from FARSH */
+static const xxh_u8 kSecret[XXH_SECRET_SIZE] ATTRIBUTE_ALIGNED(64) = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+/* -----------------------------------------------------------------------------
+ * Primitives
+ * -------------------------------------------------------------------------- */
+
+STATIC_INLINE xxh_u32
+readLE32(const void *p)
+{
+    xxh_u32 v;
+    memcpy(&v, p, sizeof(v));
+#if defined(WORDS_BIGENDIAN)
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+
+STATIC_INLINE xxh_u64
+readLE64(const void *p)
+{
+    xxh_u64 v;
+    memcpy(&v, p, sizeof(v));
+#if defined(WORDS_BIGENDIAN)
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+STATIC_INLINE xxh_u64
+rotl64(xxh_u64 x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+/* The 128-bit product of lhs and rhs, folded to 64 bits */
+STATIC_INLINE xxh_u64
+mul128_fold64(xxh_u64 lhs, xxh_u64 rhs)
+{
+#if defined(__SIZEOF_INT128__)
+    __uint128_t product = (__uint128_t)lhs * rhs;
+    return (xxh_u64)product ^ (xxh_u64)(product >> 64);
+#else
+    xxh_u64 lo_lo = (lhs & 0xFFFFFFFF) * (rhs & 0xFFFFFFFF);
+    xxh_u64 hi_lo = (lhs >> 32)        * (rhs & 0xFFFFFFFF);
+    xxh_u64 lo_hi = (lhs & 0xFFFFFFFF) * (rhs >> 32);
+    xxh_u64 hi_hi = (lhs >> 32)        * (rhs >> 32);
+    xxh_u64 cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+    xxh_u64 upper = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+    xxh_u64 lower = (cross << 32) | (lo_lo & 0xFFFFFFFF);
+    return lower ^ upper;
+#endif
+}
+
+STATIC_INLINE xxh_u64
+xxh64_avalanche(xxh_u64 h)
+{
+    h ^= h >> 33;
+    h *= XXH_PRIME64_2;
+    h ^= h >> 29;
+    h *= XXH_PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+STATIC_INLINE xxh_u64
+xxh3_avalanche(xxh_u64 h)
+{
+    h ^= h >> 37;
+    h *= XXH_PRIME_MX1;
+    h ^= h >> 32;
+    return h;
+}
+
+STATIC_INLINE xxh_u64
+rrmxmx(xxh_u64 h, xxh_u64 len)
+{
+    h ^= rotl64(h, 49) ^ rotl64(h, 24);
+    h *= XXH_PRIME_MX2;
+    h ^= (h >> 35) + len;
+    h *= XXH_PRIME_MX2;
+    return h ^ (h >> 28);
+}
+
+/* -----------------------------------------------------------------------------
+ * Short inputs (up to 240 bytes)
+ * -------------------------------------------------------------------------- */
+
+STATIC_INLINE xxh_u64
+len_1to3(const xxh_u8 *input, size_t len, const xxh_u8 *secret)
+{
+    xxh_u8 c1 = input[0];
+    xxh_u8 c2 = input[len >> 1];
+    xxh_u8 c3 = input[len - 1];
+    xxh_u32 combined = ((xxh_u32)c1 << 16) | ((xxh_u32)c2 << 24)
+                     | ((xxh_u32)c3 << 0)  | ((xxh_u32)len << 8);
+    xxh_u64 bitflip = readLE32(secret) ^ readLE32(secret + 4);
+    return xxh64_avalanche((xxh_u64)combined ^ bitflip);
+}
+
+STATIC_INLINE xxh_u64
+len_4to8(const xxh_u8 *input, size_t len, const xxh_u8 *secret)
+{
+    xxh_u32 input1 = readLE32(input);
+    xxh_u32 input2 = readLE32(input + len - 4);
+    xxh_u64 bitflip = readLE64(secret + 8) ^ readLE64(secret + 16);
+    xxh_u64 input64 = input2 + ((xxh_u64)input1 << 32);
+    return rrmxmx(input64 ^ bitflip, len);
+}
+
+STATIC_INLINE xxh_u64
+len_9to16(const xxh_u8 *input, size_t len, const xxh_u8 *secret)
+{
+    xxh_u64 bitflip1 = readLE64(secret + 24) ^ readLE64(secret + 32);
+    xxh_u64 bitflip2 = readLE64(secret + 40) ^ readLE64(secret + 48);
+    xxh_u64 input_lo = readLE64(input) ^ bitflip1;
+    xxh_u64 input_hi = readLE64(input + len - 8) ^ bitflip2;
+    xxh_u64 acc = len + __builtin_bswap64(input_lo) + input_hi
+                + mul128_fold64(input_lo, input_hi);
+    return xxh3_avalanche(acc);
+}
+
+STATIC_INLINE xxh_u64
+mix16B(const xxh_u8 *input, const xxh_u8 *secret)
+{
+    return mul128_fold64(readLE64(input) ^ readLE64(secret),
+                         readLE64(input + 8) ^ readLE64(secret + 8));
+}
+
+STATIC_INLINE xxh_u64
+len_17to128(const xxh_u8 *input, size_t len, const xxh_u8 *secret)
+{
+    xxh_u64 acc = len * XXH_PRIME64_1;
+
+    if (len > 32) {
+        if (len > 64) {
+            if (len > 96) {
+                acc += mix16B(input + 48, secret + 96);
+                acc += mix16B(input + len - 64, secret + 112);
+            }
+            acc += mix16B(input + 32, secret + 64);
+            acc += mix16B(input + len - 48, secret + 80);
+        }
+        acc += mix16B(input + 16, secret + 32);
+        acc += mix16B(input + len - 32, secret + 48);
+    }
+    acc += mix16B(input + 0, secret + 0);
+    acc += mix16B(input + len - 16, secret + 16);
+    return xxh3_avalanche(acc);
+}
+
+static xxh_u64
+len_129to240(const xxh_u8 *input, size_t len, const xxh_u8 *secret)
+{
+    xxh_u64 acc = len * XXH_PRIME64_1;
+    xxh_u64 acc_end;
+    unsigned int nbRounds = (unsigned int)len / 16;
+    unsigned int i;
+
+    for (i = 0; i < 8; i++) {
+        acc += mix16B(input + 16 * i, secret + 16 * i);
+    }
+    acc_end = mix16B(input + len - 16,
+                     secret + XXH_SECRET_SIZE_MIN - XXH_MIDSIZE_LASTOFFSET);
+    acc = xxh3_avalanche(acc);
+    for (i = 8; i < nbRounds; i++) {
+        acc_end += mix16B(input + 16 * i,
+                          secret + 16 * (i - 8) + XXH_MIDSIZE_STARTOFFSET);
+    }
+    return xxh3_avalanche(acc + acc_end);
+}
+
+/* -----------------------------------------------------------------------------
+ * Long inputs: 8 accumulators, fed 64-byte stripes
+ * -------------------------------------------------------------------------- */
+
+#if defined(__AVX2__)
+
+#define XXH_ACC_ALIGN 32
+
+STATIC_INLINE void
+accumulate_512(xxh_u64 *acc, const xxh_u8 *input, const xxh_u8 *secret)
+{
+    __m256i *xacc = (__m256i *)acc;
+    const __m256i *xinput = (const __m256i *)input;
+    const __m256i *xsecret = (const __m256i *)secret;
+    size_t i;
+
+    for (i = 0; i < XXH_STRIPE_LEN / sizeof(__m256i); i++) {
+        __m256i data_vec    = _mm256_loadu_si256(xinput + i);
+        __m256i key_vec     = _mm256_loadu_si256(xsecret + i);
+        __m256i data_key    = _mm256_xor_si256(data_vec, key_vec);
+        __m256i data_key_lo = _mm256_srli_epi64(data_key, 32);
+        __m256i product     = _mm256_mul_epu32(data_key, data_key_lo);
+        __m256i data_swap   = _mm256_shuffle_epi32(data_vec, _MM_SHUFFLE(1, 0, 3, 2));
+        __m256i sum         = _mm256_add_epi64(xacc[i], data_swap);
+        xacc[i] = _mm256_add_epi64(product, sum);
+    }
+}
+
+STATIC_INLINE void
+scramble_acc(xxh_u64 *acc, const xxh_u8 *secret)
+{
+    __m256i *xacc = (__m256i *)acc;
+    const __m256i *xsecret = (const __m256i *)secret;
+    const __m256i prime32 = _mm256_set1_epi32((int)XXH_PRIME32_1);
+    size_t i;
+
+    for (i = 0; i < XXH_STRIPE_LEN / sizeof(__m256i); i++) {
+        __m256i acc_vec     = xacc[i];
+        __m256i shifted     = _mm256_srli_epi64(acc_vec, 47);
+        __m256i data_vec    = _mm256_xor_si256(acc_vec, shifted);
+        __m256i key_vec     = _mm256_loadu_si256(xsecret + i);
+        __m256i data_key    = _mm256_xor_si256(data_vec, key_vec);
+        __m256i data_key_hi = _mm256_srli_epi64(data_key, 32);
+        __m256i prod_lo     = _mm256_mul_epu32(data_key, prime32);
+        __m256i prod_hi     = _mm256_mul_epu32(data_key_hi, prime32);
+        xacc[i] = _mm256_add_epi64(prod_lo, _mm256_slli_epi64(prod_hi, 32));
+    }
+}
+
+#elif defined(__SSE2__)
+
+#define XXH_ACC_ALIGN 16
+
+STATIC_INLINE void
+accumulate_512(xxh_u64 *acc, const xxh_u8 *input, const xxh_u8 *secret)
+{
+    __m128i *xacc = (__m128i *)acc;
+    const __m128i *xinput = (const __m128i *)input;
+    const __m128i *xsecret = (const __m128i *)secret;
+    size_t i;
+
+    for (i = 0; i < XXH_STRIPE_LEN / sizeof(__m128i); i++) {
+        __m128i data_vec    = _mm_loadu_si128(xinput + i);
+        __m128i key_vec     = _mm_loadu_si128(xsecret + i);
+        __m128i data_key    = _mm_xor_si128(data_vec, key_vec);
+        __m128i data_key_lo = _mm_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1));
+        __m128i product     = _mm_mul_epu32(data_key, data_key_lo);
+        __m128i data_swap   = _mm_shuffle_epi32(data_vec, _MM_SHUFFLE(1, 0, 3, 2));
+        __m128i sum         = _mm_add_epi64(xacc[i], data_swap);
+        xacc[i] = _mm_add_epi64(product, sum);
+    }
+}
+
+STATIC_INLINE void
+scramble_acc(xxh_u64 *acc, const xxh_u8 *secret)
+{
+    __m128i *xacc = (__m128i *)acc;
+    const __m128i *xsecret = (const __m128i *)secret;
+    const __m128i prime32 = _mm_set1_epi32((int)XXH_PRIME32_1);
+    size_t i;
+
+    for (i = 0; i < XXH_STRIPE_LEN / sizeof(__m128i); i++) {
+        __m128i acc_vec     = xacc[i];
+        __m128i shifted     = _mm_srli_epi64(acc_vec, 47);
+        __m128i data_vec    = _mm_xor_si128(acc_vec, shifted);
+        __m128i key_vec     = _mm_loadu_si128(xsecret + i);
+        __m128i data_key    = _mm_xor_si128(data_vec, key_vec);
+        __m128i data_key_hi = _mm_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1));
+        __m128i prod_lo     = _mm_mul_epu32(data_key, prime32);
+        __m128i prod_hi     = _mm_mul_epu32(data_key_hi, prime32);
+        xacc[i] = _mm_add_epi64(prod_lo, _mm_slli_epi64(prod_hi, 32));
+    }
+}
+
+#else
+
+#define XXH_ACC_ALIGN 8
+
+STATIC_INLINE void
+accumulate_512(xxh_u64 *acc, const xxh_u8 *input, const xxh_u8 *secret)
+{
+    size_t i;
+
+    for (i = 0; i < XXH_ACC_NB; i++) {
+        xxh_u64 data_val = readLE64(input + 8 * i);
+        xxh_u64 data_key = data_val ^ readLE64(secret + 8 * i);
+        acc[i ^ 1] += data_val;     /* swap adjacent lanes */
+        acc[i] += (data_key & 0xFFFFFFFF) * (data_key >> 32);
+    }
+}
+
+STATIC_INLINE void
+scramble_acc(xxh_u64 *acc, const xxh_u8 *secret)
+{
+    size_t i;
+
+    for (i = 0; i < XXH_ACC_NB; i++) {
+        xxh_u64 a = acc[i];
+        a ^= a >> 47;
+        a ^= readLE64(secret + 8 * i);
+        a *= XXH_PRIME32_1;
+        acc[i] = a;
+    }
+}
+
+#endif
+
+STATIC_INLINE void
+accumulate(xxh_u64 *acc, const xxh_u8 *input, const xxh_u8 *secret,
+           size_t nbStripes)
+{
+    size_t n;
+
+    for (n = 0; n < nbStripes; n++) {
+        accumulate_512(acc, input + n * XXH_STRIPE_LEN,
+                       secret + n * XXH_SECRET_CONSUME_RATE);
+    }
+}
+
+STATIC_INLINE xxh_u64
+mix2Accs(const xxh_u64 *acc, const xxh_u8 *secret)
+{
+    return mul128_fold64(acc[0] ^ readLE64(secret),
+                         acc[1] ^ readLE64(secret + 8));
+}
+
+static xxh_u64
+hashLong(const xxh_u8 *input, size_t len)
+{
+    xxh_u64 acc[XXH_ACC_NB] ATTRIBUTE_ALIGNED(XXH_ACC_ALIGN) = {
+        XXH_PRIME32_3, XXH_PRIME64_1, XXH_PRIME64_2, XXH_PRIME64_3,
+        XXH_PRIME64_4, XXH_PRIME32_2, XXH_PRIME64_5, XXH_PRIME32_1 };
+    const xxh_u8 *secret = kSecret;
+    size_t nbStripesPerBlock =
+        (XXH_SECRET_SIZE - XXH_STRIPE_LEN) / XXH_SECRET_CONSUME_RATE;
+    size_t block_len = XXH_STRIPE_LEN * nbStripesPerBlock;
+    size_t nb_blocks = (len - 1) / block_len;
+    size_t nbStripes, n;
+    xxh_u64 result;
+
+    for (n = 0; n < nb_blocks; n++) {
+        accumulate(acc, input + n * block_len, secret, nbStripesPerBlock);
+        scramble_acc(acc, secret + XXH_SECRET_SIZE - XXH_STRIPE_LEN);
+    }
+
+    /* last partial block */
+    nbStripes = ((len - 1) - block_len * nb_blocks) / XXH_STRIPE_LEN;
+    accumulate(acc, input + nb_blocks * block_len, secret, nbStripes);
+
+    /* last stripe */
+    accumulate_512(acc, input + len - XXH_STRIPE_LEN,
+                   secret + XXH_SECRET_SIZE - XXH_STRIPE_LEN
+                          - XXH_SECRET_LASTACC_START);
+
+    /* converge into the final hash */
+    result = len * XXH_PRIME64_1;
+    for (n = 0; n < 4; n++) {
+        result += mix2Accs(acc + 2 * n,
+                           secret + XXH_SECRET_MERGEACCS_START + 16 * n);
+    }
+    return xxh3_avalanche(result);
+}
+
+/* -----------------------------------------------------------------------------
+ * Entry point
+ * -------------------------------------------------------------------------- */
+
+StgWord64
+xxh3_64bits(const void *data, size_t len)
+{
+    const xxh_u8 *input = (const xxh_u8 *)data;
+
+    if (len <= 16) {
+        if (len > 8) return len_9to16(input, len, kSecret);
+        if (len >= 4) return len_4to8(input, len, kSecret);
+        if (len > 0) return len_1to3(input, len, kSecret);
+        return xxh64_avalanche(readLE64(kSecret + 56) ^ readLE64(kSecret + 64));
+    }
+    if (len <= 128) {
+        return len_17to128(input, len, kSecret);
+    }
+    if (len <= XXH_MIDSIZE_MAX) {
+        return len_129to240(input, len, kSecret);
+    }
+    return hashLong(input, len);
+}
@@ -0,0 +1,17 @@
+/* -----------------------------------------------------------------------------
+ *
+ * (c) The GHC Team, 2020
+ *
+ * The XXH3 hash function, for the RTS's string hash tables; see xxh3.c
+ *
+ * ---------------------------------------------------------------------------*/
+
+#pragma once
+
+#include "BeginPrivate.h"
+
+/* XXH3_64bits() of xxHash: the 64-bit XXH3 hash of len bytes at data,
+ * with the default secret and no seed */
+StgWord64 xxh3_64bits ( const void *data, size_t len );
+
+#include "EndPrivate.h"
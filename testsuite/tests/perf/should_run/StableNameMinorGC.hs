@@ -0,0 +1,21 @@
+-- Minor GCs should only look at the stable names of young objects, so the
+-- number of table entries they visit should not grow with the number of
+-- long-lived stable names.  The RTS reports that number as
+-- stable_name_minor_gc_visits, which all.T collects.  Also checks that
+-- makeStableName still finds the existing stable names after the GCs
+-- have moved their objects.
+
+import Control.Monad
+import System.Mem
+import System.Mem.StableName
+
+main :: IO ()
+main = do
+  let n = 500000
+  let objs = [ Just i | i <- [1 .. n :: Int] ]
+  sns <- mapM makeStableName objs
+  performMajorGC  -- the objects and stable names are now old
+  replicateM_ 200 performMinorGC
+  performMajorGC
+  sns' <- mapM makeStableName objs
+  print (sns == sns' && sum (map hashStableName sns) == sum (map hashStableName sns'))
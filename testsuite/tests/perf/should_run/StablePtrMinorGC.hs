@@ -0,0 +1,23 @@
+-- Minor GCs should only visit the stable pointers that may point into the
+-- young generation, so the number of table entries they visit should not
+-- grow with the number of long-lived stable pointers.  The RTS reports
+-- that number as stable_ptr_minor_gc_visits, which all.T collects; here
+-- we check that the stable pointers survive the GCs intact.
+
+import Control.Monad
+import Foreign.StablePtr
+import System.Mem
+
+main :: IO ()
+main = do
+  let n = 1000000
+  sps <- mapM newStablePtr [1 .. n :: Int]
+  performMajorGC  -- the targets are now old
+  -- some young ones among the old ones
+  young <- mapM (newStablePtr . negate) [1 .. 1000 :: Int]
+  replicateM_ 200 performMinorGC
+  xs <- mapM deRefStablePtr sps
+  ys <- mapM deRefStablePtr young
+  mapM_ freeStablePtr young
+  mapM_ freeStablePtr sps
+  print (xs == [1 .. n] && ys == map negate [1 .. 1000])
@@ -0,0 +1,35 @@
+-- Wake many threads on one Capability from a thread on another.  The
+-- commit that wakes them sends all the wakeup messages in one batch (see
+-- Note [Batched messages] in rts/Messages.c).  Run with +RTS -ls; then
+-- batched_messages_check reads the EVENT_MESSAGE_COUNTERS records from
+-- the eventlog.
+
+import Control.Concurrent
+import Control.Monad
+import GHC.Conc
+
+waiters :: Int
+waiters = 100
+
+main :: IO ()
+main = do
+  go <- newTVarIO False
+  woken <- newTVarIO 0
+  tids <- replicateM waiters $ forkOn 1 $ atomically $ do
+    g <- readTVar go
+    unless g retry
+    modifyTVar' woken (+1)
+
+  -- wait until they are all blocked
+  let blocked = do
+        ss <- mapM threadStatus tids
+        unless (all (== ThreadBlocked BlockedOnSTM) ss) $ do
+          threadDelay 1000
+          blocked
+  blocked
+
+  _ <- forkOn 0 $ atomically $ writeTVar go True
+  atomically $ do
+    n <- readTVar woken
+    unless (n == waiters) retry
+  putStrLn "woken"
@@ -0,0 +1,110 @@
+/*
+ * Read an eventlog and check that it has EVENT_MESSAGE_COUNTERS records,
+ * and that some Capability delivered its messages in batches of more
+ * than one.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define EVENT_HEADER_BEGIN      0x68647262
+#define EVENT_HEADER_END        0x68647265
+#define EVENT_DATA_BEGIN        0x64617462
+#define EVENT_DATA_END          0xffff
+#define EVENT_HET_BEGIN         0x68657462
+#define EVENT_HET_END           0x68657465
+#define EVENT_ET_BEGIN          0x65746200
+#define EVENT_ET_END            0x65746500
+#define EVENT_MESSAGE_COUNTERS  208
+
+static unsigned char *buf;
+static size_t len, pos;
+
+static uint64_t get (int bytes)
+{
+    uint64_t r = 0;
+    if (pos + bytes > len) {
+        printf("truncated eventlog\n");
+        exit(1);
+    }
+    while (bytes-- > 0) {
+        r = (r << 8) | buf[pos++];
+    }
+    return r;
+}
+
+static void expect (uint32_t marker)
+{
+    if (get(4) != marker) {
+        printf("bad eventlog at offset %zu\n", pos - 4);
+        exit(1);
+    }
+}
+
+int main (int argc, char *argv[])
+{
+    static int32_t sizes[0x10000];
+    FILE *f;
+    uint64_t sent, batches, max_batch;
+    int counters = 0, batched = 0;
+
+    if (argc != 2 || (f = fopen(argv[1], "rb")) == NULL) {
+        printf("usage: %s <eventlog>\n", argv[0]);
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    buf = malloc(len);
+    if (fread(buf, 1, len, f) != len) {
+        printf("can't read %s\n", argv[1]);
+        return 1;
+    }
+    fclose(f);
+
+    expect(EVENT_HEADER_BEGIN);
+    expect(EVENT_HET_BEGIN);
+    for (;;) {
+        uint32_t marker = get(4);
+        uint16_t num;
+        if (marker == EVENT_HET_END) break;
+        if (marker != EVENT_ET_BEGIN) {
+            printf("bad event type at offset %zu\n", pos - 4);
+            return 1;
+        }
+        num = get(2);
+        sizes[num] = (int16_t)get(2);
+        pos += get(4);              // description
+        pos += get(4);              // extra info
+        expect(EVENT_ET_END);
+    }
+    expect(EVENT_HEADER_END);
+    expect(EVENT_DATA_BEGIN);
+
+    for (;;) {
+        uint16_t type = get(2);
+        uint32_t size;
+        if (type == EVENT_DATA_END) break;
+        get(8);                     // timestamp
+        size = sizes[type] < 0 ? get(2) : (uint32_t)sizes[type];
+        if (type == EVENT_MESSAGE_COUNTERS) {
+            sent      = get(8);
+            batches   = get(8);
+            max_batch = get(8);
+            counters = 1;
+            if (batches > sent) {
+                printf("more batches than messages\n");
+            }
+            if (max_batch > 1 && batches < sent) {
+                batched = 1;
+            }
+        } else {
+            pos += size;
+        }
+    }
+
+    printf("message counters: %s\n", counters ? "yes" : "no");
+    printf("batched: %s\n", batched ? "yes" : "no");
+    return 0;
+}
@@ -0,0 +1,46 @@
+-- threadWaitRead on more pipes than select() can handle (FD_SETSIZE is
+-- 1024), with the epoll backend of the non-threaded RTS; see Note
+-- [Waiting for I/O with epoll] in rts/posix/Select.c.  If the file
+-- descriptor limit can't be raised far enough there is nothing to test,
+-- and we just print the expected output.
+
+import Control.Concurrent
+import Control.Monad
+import Foreign
+import Foreign.C
+import System.Posix.Types
+
+foreign import ccall unsafe "raise_fd_limit" raiseFdLimit :: CInt -> IO CInt
+foreign import ccall unsafe "pipe" c_pipe :: Ptr CInt -> IO CInt
+foreign import ccall unsafe "read" c_read :: CInt -> Ptr Word8 -> CSize -> IO CSsize
+foreign import ccall unsafe "write" c_write :: CInt -> Ptr Word8 -> CSize -> IO CSsize
+
+pipes :: Int
+pipes = 1100
+
+main :: IO ()
+main = do
+  ok <- raiseFdLimit (fromIntegral (2 * pipes + 64))
+  if ok == 0 then putStrLn (show pipes ++ " readers woken") else do
+    fds <- replicateM pipes $ allocaArray 2 $ \p -> do
+      throwErrnoIfMinus1_ "pipe" (c_pipe p)
+      [r, w] <- peekArray 2 p
+      return (r, w)
+    when (maximum (map snd fds) < 1024) $
+      putStrLn "no descriptors above FD_SETSIZE"
+
+    count <- newMVar (0 :: Int)
+    done <- newEmptyMVar
+    forM_ fds $ \(r, _) -> forkIO $ do
+      threadWaitRead (Fd r)
+      alloca $ \b -> throwErrnoIfMinus1_ "read" (c_read r b 1)
+      n <- modifyMVar count $ \n -> return (n + 1, n + 1)
+      when (n == pipes) $ putMVar done ()
+
+    -- let them all block, then wake them from the last pipe to the first
+    yield
+    forM_ (reverse fds) $ \(_, w) ->
+      with 1 $ \b -> throwErrnoIfMinus1_ "write" (c_write w b 1)
+    takeMVar done
+    n <- readMVar count
+    putStrLn (show n ++ " readers woken")
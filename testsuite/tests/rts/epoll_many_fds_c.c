@@ -0,0 +1,21 @@
+#include <sys/resource.h>
+
+/* Try to allow at least n open file descriptors.  Returns 1 if we can. */
+int raise_fd_limit (int n)
+{
+    struct rlimit rl;
+
+    if (getrlimit(RLIMIT_NOFILE, &rl) != 0) {
+        return 0;
+    }
+    if (rl.rlim_cur != RLIM_INFINITY && rl.rlim_cur < (rlim_t)n) {
+        if (rl.rlim_max != RLIM_INFINITY && rl.rlim_max < (rlim_t)n) {
+            return 0;
+        }
+        rl.rlim_cur = n;
+        if (setrlimit(RLIMIT_NOFILE, &rl) != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
@@ -0,0 +1,552 @@
+// Sanity check and microbenchmark for the RTS hash tables (rts/Hash.c).
+//
+// Times inserting, looking up (hits and misses), removing and
+// re-inserting word keys (aligned addresses, like most users of the
+// table, both in order and scattered over a 1GB heap, and small integers,
+// like thread ids and file descriptors) and string keys (like the
+// linker's symbol tables), and hashing symbol names of the lengths GHC
+// produces, with and without the hashes cached as the linker does.  The
+// word and string keys are run both on rts/Hash.c and on a copy of the
+// linear hash table with separate chaining that it used to be, so that
+// one run compares the two layouts.  The stdout only says whether the
+// tables gave the right answers.
+//
+// The testsuite runs it on small tables, which is enough to check the
+// answers and to make the tables grow and rehash a few times.  Run it
+// with --bench to use tables of up to several million keys; the timings
+// go to stderr.
+
+#include "Rts.h"
+#include "Hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* -----------------------------------------------------------------------------
+ * The old layout: Larson's linear hash table with separate chaining, as
+ * in rts/Hash.c before Note [Hash table layout], including its identity
+ * hash for word keys and its limit of HDIRSIZE segments.
+ * -------------------------------------------------------------------------- */
+
+#define HSEGSIZE    1024
+#define HDIRSIZE    1024
+#define HLOAD       5
+#define HCHUNK      (1024 * sizeof(W_) / sizeof(OldList))
+
+typedef struct oldlist {
+    StgWord key;
+    const void *data;
+    struct oldlist *next;
+} OldList;
+
+typedef struct oldchunk {
+    OldList *chunk;
+    struct oldchunk *next;
+} OldChunk;
+
+typedef struct {
+    int split, max, mask1, mask2, kcount, bcount;
+    OldList **dir[HDIRSIZE];
+    OldList *freeList;
+    OldChunk *chunks;
+    StgWord (*hash)(StgWord key);
+    int (*cmp)(StgWord key1, StgWord key2);
+} OldTable;
+
+static int oldBucket(const OldTable *t, StgWord key)
+{
+    StgWord h = t->hash(key);
+    int bucket = h & t->mask1;
+    if (bucket < t->split) {
+        bucket = h & t->mask2;
+    }
+    return bucket;
+}
+
+static OldTable *oldAlloc(StgWord (*hash)(StgWord),
+                          int (*cmp)(StgWord, StgWord))
+{
+    OldTable *t = calloc(1, sizeof(OldTable));
+    t->dir[0] = calloc(HSEGSIZE, sizeof(OldList *));
+    t->max = HSEGSIZE;
+    t->mask1 = HSEGSIZE - 1;
+    t->mask2 = 2 * HSEGSIZE - 1;
+    t->bcount = HSEGSIZE;
+    t->hash = hash;
+    t->cmp = cmp;
+    return t;
+}
+
+static void oldExpand(OldTable *t)
+{
+    OldList *hl, *next, *old = NULL, *new = NULL;
+    int oldsegment, oldindex, newbucket;
+
+    if (t->split + t->max >= HDIRSIZE * HSEGSIZE) {
+        return;
+    }
+    oldsegment = t->split / HSEGSIZE;
+    oldindex = t->split % HSEGSIZE;
+    newbucket = t->max + t->split;
+    if (newbucket % HSEGSIZE == 0) {
+        t->dir[newbucket / HSEGSIZE] = calloc(HSEGSIZE, sizeof(OldList *));
+    }
+    if (++t->split == t->max) {
+        t->split = 0;
+        t->max *= 2;
+        t->mask1 = t->mask2;
+        t->mask2 = t->mask2 << 1 | 1;
+    }
+    t->bcount++;
+
+    for (hl = t->dir[oldsegment][oldindex]; hl != NULL; hl = next) {
+        next = hl->next;
+        if (oldBucket(t, hl->key) == newbucket) {
+            hl->next = new;
+            new = hl;
+        } else {
+            hl->next = old;
+            old = hl;
+        }
+    }
+    t->dir[oldsegment][oldindex] = old;
+    t->dir[newbucket / HSEGSIZE][newbucket % HSEGSIZE] = new;
+}
+
+static void oldInsert(OldTable *t, StgWord key, const void *data)
+{
+    OldList *hl;
+    int bucket;
+
+    if (++t->kcount >= HLOAD * t->bcount) {
+        oldExpand(t);
+    }
+    if ((hl = t->freeList) != NULL) {
+        t->freeList = hl->next;
+    } else {
+        OldChunk *cl = malloc(sizeof(OldChunk));
+        OldList *p;
+        hl = malloc(HCHUNK * sizeof(OldList));
+        cl->chunk = hl;
+        cl->next = t->chunks;
+        t->chunks = cl;
+        t->freeList = hl + 1;
+        for (p = t->freeList; p < hl + HCHUNK - 1; p++) {
+            p->next = p + 1;
+        }
+        p->next = NULL;
+    }
+    bucket = oldBucket(t, key);
+    hl->key = key;
+    hl->data = data;
+    hl->next = t->dir[bucket / HSEGSIZE][bucket % HSEGSIZE];
+    t->dir[bucket / HSEGSIZE][bucket % HSEGSIZE] = hl;
+}
+
+static void *oldLookup(const OldTable *t, StgWord key)
+{
+    int bucket = oldBucket(t, key);
+    OldList *hl;
+
+    for (hl = t->dir[bucket / HSEGSIZE][bucket % HSEGSIZE]; hl != NULL;
+         hl = hl->next) {
+        if (t->cmp(hl->key, key)) {
+            return (void *) hl->data;
+        }
+    }
+    return NULL;
+}
+
+static void *oldRemove(OldTable *t, StgWord key)
+{
+    int bucket = oldBucket(t, key);
+    OldList **prev = &t->dir[bucket / HSEGSIZE][bucket % HSEGSIZE];
+    OldList *hl;
+
+    for (hl = *prev; hl != NULL; prev = &hl->next, hl = hl->next) {
+        if (t->cmp(hl->key, key)) {
+            *prev = hl->next;
+            hl->next = t->freeList;
+            t->freeList = hl;
+            t->kcount--;
+            return (void *) hl->data;
+        }
+    }
+    return NULL;
+}
+
+static void oldFree(OldTable *t)
+{
+    OldChunk *cl, *next;
+    int i;
+
+    for (i = 0; i < HDIRSIZE && t->dir[i] != NULL; i++) {
+        free(t->dir[i]);
+    }
+    for (cl = t->chunks; cl != NULL; cl = next) {
+        next = cl->next;
+        free(cl->chunk);
+        free(cl);
+    }
+    free(t);
+}
+
+static StgWord oldHashWord(StgWord key)
+{
+    return key >> sizeof(StgWord);
+}
+
+static int oldCompareWord(StgWord key1, StgWord key2)
+{
+    return key1 == key2;
+}
+
+static StgWord oldHashStr(StgWord key)
+{
+    return hashStr(NULL, key);
+}
+
+static int oldCompareStr(StgWord key1, StgWord key2)
+{
+    return strcmp((char *)key1, (char *)key2) == 0;
+}
+
+/* -----------------------------------------------------------------------------
+ * The two layouts behind one interface
+ * -------------------------------------------------------------------------- */
+
+typedef struct {
+    const char *name;
+    void *(*allocWords)(void);
+    void *(*allocStrings)(void);
+    void (*insert)(void *t, StgWord key, const void *data, bool str);
+    void *(*lookup)(void *t, StgWord key, bool str);
+    void *(*remove)(void *t, StgWord key, bool str);
+    StgWord (*count)(void *t);
+    void (*free)(void *t, bool str);
+} Layout;
+
+static void *newAllocWords(void) { return allocHashTable(); }
+static void *newAllocStrings(void) { return allocStrHashTable(); }
+
+static void newInsert(void *t, StgWord key, const void *data, bool str)
+{
+    if (str) {
+        insertStrHashTable(t, (const char *)key, data);
+    } else {
+        insertHashTable(t, key, data);
+    }
+}
+
+static void *newLookup(void *t, StgWord key, bool str)
+{
+    return str ? lookupStrHashTable(t, (const char *)key)
+               : lookupHashTable(t, key);
+}
+
+static void *newRemove(void *t, StgWord key, bool str)
+{
+    return str ? removeStrHashTable(t, (const char *)key, NULL)
+               : removeHashTable(t, key, NULL);
+}
+
+static StgWord newCount(void *t) { return keyCountHashTable(t); }
+
+static void newFree(void *t, bool str)
+{
+    if (str) {
+        freeStrHashTable(t, NULL);
+    } else {
+        freeHashTable(t, NULL);
+    }
+}
+
+static void *oldAllocWords(void)
+{
+    return oldAlloc(oldHashWord, oldCompareWord);
+}
+
+static void *oldAllocStrings(void)
+{
+    return oldAlloc(oldHashStr, oldCompareStr);
+}
+
+static void oldInsert_(void *t, StgWord key, const void *data,
+                       bool str STG_UNUSED)
+{
+    oldInsert(t, key, data);
+}
+
+static void *oldLookup_(void *t, StgWord key, bool str STG_UNUSED)
+{
+    return oldLookup(t, key);
+}
+
+static void *oldRemove_(void *t, StgWord key, bool str STG_UNUSED)
+{
+    return oldRemove(t, key);
+}
+
+static StgWord oldCount(void *t) { return ((OldTable *)t)->kcount; }
+
+static void oldFree_(void *t, bool str STG_UNUSED) { oldFree(t); }
+
+static const Layout layouts[] = {
+    { "new", newAllocWords, newAllocStrings, newInsert, newLookup,
+      newRemove, newCount, newFree },
+    { "old", oldAllocWords, oldAllocStrings, oldInsert_, oldLookup_,
+      oldRemove_, oldCount, oldFree_ },
+};
+
+/* -----------------------------------------------------------------------------
+ * Benchmarks
+ * -------------------------------------------------------------------------- */
+
+static const char *order;
+
+static void report(const Layout *l, const char *what, StgWord n, double t)
+{
+    fprintf(stderr, "%-4s %-24s %-10s %9" FMT_Word " keys: %7.1f ns/op\n",
+            l->name, what, order, n, t * 1e9 / n);
+}
+
+// The i-th word key, and a key that is not in the table: 16-byte aligned
+// addresses, as for heap objects, either consecutive or scattered
+// (multiplying by an odd number is a bijection modulo 2^26), or small
+// integers
+static StgWord (*wordKey)(StgWord i);
+static StgWord (*missKey)(StgWord i);
+
+static StgWord seqKey(StgWord i)
+{
+    return 0x4200000000 + i * 16;
+}
+
+static StgWord scatteredKey(StgWord i)
+{
+    return 0x4200000000 + ((i * 2654435761U) & ((1 << 26) - 1)) * 16;
+}
+
+static StgWord addrMissKey(StgWord i)
+{
+    return wordKey(i) + 8;
+}
+
+static StgWord intKey(StgWord i)
+{
+    return i;
+}
+
+static StgWord intMissKey(StgWord i)
+{
+    return ~i;
+}
+
+static int benchWords(const Layout *l, StgWord n)
+{
+    void *t = l->allocWords();
+    StgWord i;
+    int ok = 1;
+    double t0;
+
+    t0 = now();
+    for (i = 0; i < n; i++) {
+        l->insert(t, wordKey(i), (void *)(i + 1), false);
+    }
+    report(l, "word insert", n, now() - t0);
+    ok &= l->count(t) == n;
+
+    t0 = now();
+    for (i = 0; i < n; i++) {
+        ok &= l->lookup(t, wordKey(i), false) == (void *)(i + 1);
+    }
+    report(l, "word lookup (hit)", n, now() - t0);
+
+    t0 = now();
+    for (i = 0; i < n; i++) {
+        ok &= l->lookup(t, missKey(i), false) == NULL;
+    }
+    report(l, "word lookup (miss)", n, now() - t0);
+
+    // remove every other key, then put them back
+    t0 = now();
+    for (i = 0; i < n; i += 2) {
+        ok &= l->remove(t, wordKey(i), false) == (void *)(i + 1);
+    }
+    for (i = 0; i < n; i += 2) {
+        l->insert(t, wordKey(i), (void *)(i + 1), false);
+    }
+    report(l, "word remove + reinsert", n, now() - t0);
+
+    for (i = 0; i < n; i++) {
+        ok &= l->lookup(t, wordKey(i), false) == (void *)(i + 1);
+    }
+    ok &= l->count(t) == n;
+
+    l->free(t, false);
+    return ok;
+}
+
+static int benchStrings(const Layout *l, StgWord n)
+{
+    void *t = l->allocStrings();
+    char **keys = malloc(n * sizeof(char *));
+    char miss[32];
+    StgWord i;
+    int ok = 1;
+    double t0;
+
+    order = "";
+    for (i = 0; i < n; i++) {
+        keys[i] = malloc(32);
+        snprintf(keys[i], 32, "base_GHCziSym%" FMT_Word "_closure", i);
+    }
+
+    t0 = now();
+    for (i = 0; i < n; i++) {
+        l->insert(t, (StgWord)keys[i], keys[i], true);
+    }
+    report(l, "string insert", n, now() - t0);
+
+    t0 = now();
+    for (i = 0; i < n; i++) {
+        ok &= l->lookup(t, (StgWord)keys[i], true) == keys[i];
+    }
+    report(l, "string lookup (hit)", n, now() - t0);
+
+    t0 = now();
+    for (i = 0; i < n; i++) {
+        snprintf(miss, sizeof(miss), "base_GHCziSym%" FMT_Word "_info", i);
+        ok &= l->lookup(t, (StgWord)miss, true) == NULL;
+    }
+    report(l, "string lookup (miss)", n, now() - t0);
+
+    for (i = 0; i < n; i++) {
+        ok &= l->remove(t, (StgWord)keys[i], true) == keys[i];
+    }
+    ok &= l->count(t) == 0;
+
+    l->free(t, true);
+    for (i = 0; i < n; i++) {
+        free(keys[i]);
+    }
+    free(keys);
+    return ok;
+}
+
+// Hash mangled names of len bytes or a little more, then insert, look up
+// and remove them, as ghciInsertSymbolTable, ocTryLoad and unloadObj do;
+// first hashing the name each time, and then with the hash computed once
+// and cached, as in Symbol_t
+static int benchSymbols(StgWord n, StgWord len)
+{
+    StrHashTable *t;
+    char **keys = malloc(n * sizeof(char *));
+    StgWord *hashes = malloc(n * sizeof(StgWord));
+    char name[32];
+    const char *prefix = "ghczmprim_GHCziClasses_zdfOrdzuzdczlze_";
+    StgWord i, j;
+    int ok = 1;
+    double t0;
+
+    order = name;
+    snprintf(name, sizeof(name), "%" FMT_Word " bytes", len);
+    for (i = 0; i < n; i++) {
+        keys[i] = malloc(len + 32);
+        for (j = 0; j < len; j++) {
+            keys[i][j] = prefix[j % strlen(prefix)];
+        }
+        snprintf(keys[i] + len, 32, "%" FMT_Word "_closure", i);
+    }
+
+    t0 = now();
+    for (i = 0; i < n; i++) {
+        hashes[i] = hashStr(NULL, (StgWord)keys[i]);
+    }
+    report(&layouts[0], "symbol hash", n, now() - t0);
+
+    t = allocStrHashTable();
+    t0 = now();
+    for (i = 0; i < n; i++) {
+        insertStrHashTable(t, keys[i], keys[i]);
+    }
+    for (i = 0; i < n; i++) {
+        ok &= lookupStrHashTable(t, keys[i]) == keys[i];
+    }
+    for (i = 0; i < n; i++) {
+        ok &= removeStrHashTable(t, keys[i], NULL) == keys[i];
+    }
+    report(&layouts[0], "symbol load (hashing)", n, now() - t0);
+    ok &= keyCountHashTable((HashTable *)t) == 0;
+    freeStrHashTable(t, NULL);
+
+    t = allocStrHashTable();
+    t0 = now();
+    for (i = 0; i < n; i++) {
+        insertStrHashTableHashed(t, keys[i], hashes[i], keys[i]);
+    }
+    for (i = 0; i < n; i++) {
+        ok &= lookupStrHashTableHashed(t, keys[i], hashes[i]) == keys[i];
+    }
+    for (i = 0; i < n; i++) {
+        ok &= removeStrHashTableHashed(t, keys[i], hashes[i], NULL) == keys[i];
+    }
+    report(&layouts[0], "symbol load (cached)", n, now() - t0);
+    ok &= keyCountHashTable((HashTable *)t) == 0;
+
+    freeStrHashTable(t, NULL);
+    for (i = 0; i < n; i++) {
+        free(keys[i]);
+    }
+    free(keys);
+    free(hashes);
+    return ok;
+}
+
+int main (int argc, char *argv[])
+{
+    StgWord sizes[] = { 100, 10000, 1000000, 4000000 };
+    StgWord n_sizes = 2, n_symbols = 1000;
+    StgWord s, l;
+    int ok = 1;
+
+    hs_init(&argc, &argv);
+
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        n_sizes = sizeof(sizes) / sizeof(sizes[0]);
+        n_symbols = 200000;
+    }
+
+    for (s = 0; s < n_sizes; s++) {
+        for (l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+            wordKey = seqKey;
+            missKey = addrMissKey;
+            order = "in order";
+            ok &= benchWords(&layouts[l], sizes[s]);
+            wordKey = scatteredKey;
+            order = "scattered";
+            ok &= benchWords(&layouts[l], sizes[s]);
+            wordKey = intKey;
+            missKey = intMissKey;
+            order = "integers";
+            ok &= benchWords(&layouts[l], sizes[s]);
+            ok &= benchStrings(&layouts[l], sizes[s] / 4 + 1);
+        }
+    }
+    ok &= benchSymbols(n_symbols, 24);
+    ok &= benchSymbols(n_symbols, 64);
+    ok &= benchSymbols(n_symbols, 160);
+
+    printf("%s\n", ok ? "ok" : "FAILED");
+
+    hs_exit();
+    return 0;
+}
@@ -0,0 +1,87 @@
+-- Smoke test for the io_uring C API of the threaded RTS: threadDelay and
+-- threadWaitRead written with ioUringTimeout and ioUringPollFd, and a
+-- cancelled request.  Where io_uring isn't available the calls fail with
+-- ENOSYS and we fall back to the usual functions, so the output is the
+-- same everywhere.
+
+import Control.Concurrent
+import Control.Monad
+import Data.Word
+import Foreign
+import Foreign.C
+import GHC.Clock
+import GHC.Conc
+
+foreign import ccall unsafe "ioUringPollFd"
+  ioUringPollFd :: CInt -> Word32 -> StablePtr PrimMVar -> IO Word64
+foreign import ccall unsafe "ioUringTimeout"
+  ioUringTimeout :: Word64 -> StablePtr PrimMVar -> IO Word64
+foreign import ccall unsafe "ioUringCancel"
+  ioUringCancel :: Word64 -> IO CInt
+
+foreign import ccall unsafe "pipe" c_pipe :: Ptr CInt -> IO CInt
+foreign import ccall unsafe "write" c_write :: CInt -> Ptr Word8 -> CSize -> IO CSsize
+
+pollIn :: Word32
+pollIn = 1
+
+-- Submit a request; Nothing if the RTS can't use io_uring here
+submit :: (StablePtr PrimMVar -> IO Word64) -> IO (Maybe (Word64, MVar ()))
+submit req = do
+  mvar <- newEmptyMVar
+  sp <- newStablePtrPrimMVar mvar
+  r <- req sp
+  if r /= 0 then return (Just (r, mvar)) else do
+    freeStablePtr sp
+    return Nothing
+
+uringDelay :: Int -> IO ()
+uringDelay usecs = do
+  r <- submit (ioUringTimeout (fromIntegral usecs))
+  case r of
+    Just (_, mvar) -> takeMVar mvar
+    Nothing        -> threadDelay usecs
+
+uringWaitRead :: CInt -> IO ()
+uringWaitRead fd = do
+  r <- submit (ioUringPollFd fd pollIn)
+  case r of
+    Just (_, mvar) -> takeMVar mvar
+    Nothing        -> threadWaitRead (fromIntegral fd)
+
+main :: IO ()
+main = do
+  -- a single delay doesn't end early
+  t0 <- getMonotonicTime
+  uringDelay 100000
+  t1 <- getMonotonicTime
+  when (t1 - t0 < 0.1) $ putStrLn "delay too short"
+
+  -- concurrent delays finish in order
+  done <- newChan
+  forM_ [3, 1, 2] $ \i -> forkIO $ do
+    uringDelay (i * 100000)
+    writeChan done i
+  replicateM 3 (readChan done) >>= print
+
+  -- readiness of a pipe
+  (r, w) <- allocaArray 2 $ \fds -> do
+    throwErrnoIfMinus1_ "pipe" (c_pipe fds)
+    [r, w] <- peekArray 2 fds
+    return (r, w)
+  woke <- newEmptyMVar
+  _ <- forkIO $ uringWaitRead r >> putMVar woke ()
+  threadDelay 100000
+  tryTakeMVar woke >>= print
+  _ <- with 1 $ \p -> c_write w p 1
+  takeMVar woke
+  putStrLn "readable"
+
+  -- a cancelled request still fills its MVar
+  c <- submit (ioUringTimeout 100000000)
+  case c of
+    Just (i, mvar) -> do
+      throwErrnoIfMinus1_ "ioUringCancel" (ioUringCancel i)
+      takeMVar mvar
+    Nothing -> return ()
+  putStrLn "cancelled"
@@ -0,0 +1,33 @@
+-- Requests made by the Capability's own Task while its completion thread
+-- is busy reaping must still be submitted.  Many threads on one
+-- Capability keep submitting very short timeouts, so completions arrive
+-- all the time and the completion thread often holds the ring's lock
+-- when the scheduler comes to submit; a lost submission leaves a thread
+-- blocked for ever and the test times out.
+
+import Control.Concurrent
+import Control.Monad
+import Data.Word
+import Foreign
+import GHC.Conc
+
+foreign import ccall unsafe "ioUringTimeout"
+  ioUringTimeout :: Word64 -> StablePtr PrimMVar -> IO Word64
+
+uringDelay :: Int -> IO ()
+uringDelay usecs = do
+  mvar <- newEmptyMVar
+  sp <- newStablePtrPrimMVar mvar
+  r <- ioUringTimeout (fromIntegral usecs) sp
+  if r /= 0 then takeMVar mvar else do
+    freeStablePtr sp
+    threadDelay usecs
+
+main :: IO ()
+main = do
+  done <- newEmptyMVar
+  forM_ [1 .. 50 :: Int] $ \_ -> forkOn 0 $ do
+    replicateM_ 200 (uringDelay 10)
+    putMVar done ()
+  replicateM_ 50 (takeMVar done)
+  putStrLn "done"
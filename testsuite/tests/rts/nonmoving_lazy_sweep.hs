@@ -0,0 +1,12 @@
+-- Exercise lazy sweeping in the nonmoving collector: keep replacing a large
+-- structure so that allocation into the nonmoving heap overlaps with sweeping.
+import Control.Monad
+import Data.IORef
+
+main :: IO ()
+main = do
+  ref <- newIORef ([] :: [[Int]])
+  forM_ [1..200 :: Int] $ \i -> do
+    let xs = [i .. i + 5000]
+    modifyIORef' ref (\xss -> take 100 (sum xs `seq` xs : xss))
+  readIORef ref >>= print . sum . map length
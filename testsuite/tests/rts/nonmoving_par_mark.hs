@@ -0,0 +1,25 @@
+-- Exercise parallel marking in the nonmoving collector: keep a large,
+-- branching structure alive across a number of major collections and check
+-- that it survives intact.
+import Control.Monad
+import Data.IORef
+import System.Mem
+
+data Tree = Leaf !Int | Node Tree Tree
+
+build :: Int -> Int -> Tree
+build 0 n = Leaf n
+build d n = Node (build (d-1) (2*n)) (build (d-1) (2*n+1))
+
+sumTree :: Tree -> Int
+sumTree (Leaf n) = n
+sumTree (Node l r) = sumTree l + sumTree r
+
+main :: IO ()
+main = do
+  ref <- newIORef (build 18 1)
+  forM_ [1..10 :: Int] $ \i -> do
+    -- replace part of the structure so that each cycle has garbage to sweep
+    when (even i) $ modifyIORef' ref (\(Node l _) -> Node l (build 17 3))
+    performMajorGC
+  readIORef ref >>= print . sumTree
@@ -0,0 +1,20 @@
+-- Exercise parallel scavenging of large arrays: a big boxed array is kept
+-- alive across minor and major collections while some of its elements are
+-- overwritten with fresh heap objects, so that it is scavenged both from
+-- the mutable list and as a large object.
+import Control.Monad
+import Data.Array.IO
+import System.Mem
+
+n :: Int
+n = 1024 * 1024
+
+main :: IO ()
+main = do
+  arr <- newListArray (0, n-1) [0 ..] :: IO (IOArray Int Int)
+  forM_ [1..4] $ \r -> do
+    forM_ [0, 7 .. n-1] $ \i -> writeArray arr i $! i + r
+    performMinorGC
+    performMajorGC
+  xs <- getElems arr
+  print (sum xs)
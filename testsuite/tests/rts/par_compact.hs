@@ -0,0 +1,34 @@
+-- Exercise parallel compaction of the oldest generation: keep a number of
+-- trees alive across major collections, replacing some of them each time so
+-- that the live trees are separated by garbage and have to be moved, and
+-- check that they survive intact.
+import Control.Exception
+import Control.Monad
+import Data.IORef
+import System.Mem
+
+data Tree = Leaf !Int | Node Tree Tree
+
+build :: Int -> Int -> Tree
+build 0 n = Leaf n
+build d n = Node (build (d-1) (2*n)) (build (d-1) (2*n+1))
+
+sumTree :: Tree -> Int
+sumTree (Leaf n) = n
+sumTree (Node l r) = sumTree l + sumTree r
+
+newTree :: Int -> IO Tree
+newTree n = do
+  let t = build 15 n
+  _ <- evaluate (sumTree t)
+  return t
+
+main :: IO ()
+main = do
+  refs <- forM [0..7] $ \j -> newTree j >>= newIORef
+  forM_ [1..8 :: Int] $ \i -> do
+    forM_ (zip [0..] refs) $ \(j, ref) ->
+      when ((i + j) `mod` 2 == 0) $ newTree j >>= writeIORef ref
+    performMajorGC
+  sums <- mapM (fmap sumTree . readIORef) refs
+  print (sum sums)
@@ -0,0 +1,35 @@
+-- Stable pointers created and freed concurrently on several capabilities,
+-- some of them freed on a different capability from the one that created
+-- them, with GCs and table enlargements happening in between.  Exercises
+-- the per-capability stable pointer batches in rts/StablePtr.c.
+
+import Control.Concurrent
+import Control.Monad
+import Foreign.StablePtr
+import System.Mem
+
+main :: IO ()
+main = do
+    let n = 4
+        rounds = 20
+        perRound = 20000
+    chans <- replicateM n newChan
+    dones <- replicateM n newEmptyMVar
+    forM_ (zip3 [0..] chans dones) $ \(i, chan, done) ->
+      forkOn i $ do
+        forM_ [1..rounds] $ \r -> do
+          sps <- forM [1..perRound] $ \j -> newStablePtr (i, r, j)
+          -- keep half, give the other half to the next capability
+          let (mine, theirs) = splitAt (perRound `div` 2) sps
+          writeChan (chans !! ((i + 1) `mod` n)) theirs
+          when (r `mod` 5 == 0) performGC
+          ok <- fmap and $ forM (zip [1..] mine) $ \(j, sp) -> do
+            v <- deRefStablePtr sp
+            return (v == (i, r, j))
+          unless ok $ error ("bad stable pointer on capability " ++ show i)
+          mapM_ freeStablePtr mine
+          readChan chan >>= mapM_ freeStablePtr
+        putMVar done ()
+    mapM_ takeMVar dones
+    performMajorGC
+    putStrLn "OK"
@@ -0,0 +1,16 @@
+import Control.Concurrent
+import Control.Monad
+
+-- Fork a burst of threads from one capability, so that with +RTS -qs the
+-- idle capabilities have to ask for them.
+main :: IO ()
+main = do
+  vars <- forM [1..200] $ \i -> do
+    v <- newEmptyMVar
+    _ <- forkIO $ putMVar v $! work i
+    return v
+  rs <- mapM takeMVar vars
+  print (sum rs)
+
+work :: Int -> Int
+work i = foldl (\a x -> (a + x * i) `mod` 1000003) 0 [1..20000]
@@ -0,0 +1,61 @@
+-- Transfers between many TVars on several capabilities, while other
+-- threads check in long read-only transactions that the total never
+-- changes, with nested transactions (orElse) and blocking (retry) mixed
+-- in.  Run with +RTS --stm-global-clock to exercise the clock-based
+-- validation in rts/STM.c.
+
+import Control.Concurrent
+import Control.Monad
+import GHC.Conc
+
+accounts, writers, readers, transfers :: Int
+accounts = 1000
+writers = 4
+readers = 4
+transfers = 20000
+
+-- A small linear congruential generator, so that the run is repeatable
+next :: Int -> Int
+next x = (x * 1103515245 + 12345) `mod` 2147483648
+
+main :: IO ()
+main = do
+    tvs <- replicateM accounts (newTVarIO (100 :: Int))
+    finished <- newTVarIO (0 :: Int)
+    let total = sum <$> mapM readTVar tvs
+        account i = tvs !! (i `mod` accounts)
+        transfer from to = do
+          a <- readTVar from
+          -- take what we can: all of it, or nothing if it's empty
+          amount <- (guard (a >= 10) >> return 10) `orElse` return a
+          writeTVar from (a - amount)
+          b <- readTVar to
+          writeTVar to (b + amount)
+
+    forM_ [1..writers] $ \w ->
+      forkOn w $ do
+        let loop 0 _ = return ()
+            loop n seed = do
+              let s1 = next seed
+                  s2 = next s1
+              atomically $ transfer (account s1) (account s2)
+              loop (n - 1 :: Int) s2
+        loop transfers w
+        atomically $ readTVar finished >>= writeTVar finished . (+ 1)
+
+    results <- forM [1..readers] $ \r -> do
+      result <- newEmptyMVar
+      _ <- forkOn (writers + r) $ do
+        let loop bad = do
+              t <- atomically total
+              done <- readTVarIO finished
+              let bad' = bad || t /= accounts * 100
+              if done == writers then putMVar result bad' else loop bad'
+        loop False
+      return result
+
+    -- block until the writers are done
+    atomically $ readTVar finished >>= \n -> when (n < writers) retry
+    bad <- or <$> mapM takeMVar results
+    t <- atomically total
+    putStrLn (if bad || t /= accounts * 100 then "total changed" else "OK")
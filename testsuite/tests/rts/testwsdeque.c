@@ -35,6 +35,7 @@ myStealWSDeque_ (WSDeque *q, uint32_t n)
 {
     void * stolen;
     StgWord b,t; 
+    WSDequeArray *a;
     
 // Can't do this on someone else's spark pool:
 // ASSERT_WSDEQUE_INVARIANTS(q); 
@@ -52,11 +53,13 @@ myStealWSDeque_ (WSDeque *q, uint32_t n)
         return NULL; /* already looks empty, abort */
     }
     // NB. the load of q->bottom must be ordered before the load of
-    // q->elements[t & q-> moduloSize]. See comment "KG:..." below
-    // and Ticket #13633.
+    // q->array and q->array->elements[t & moduloSize]. See comment
+    // "KG:..." below, Ticket #13633, and Note [Growable WSDeque].
+    load_load_barrier();
+    a = q->array;
     load_load_barrier();
     /* now access array, see pushBottom() */
-    stolen = q->elements[t & q->moduloSize];
+    stolen = a->elements[t & a->moduloSize];
     
     /* now decide whether we have won */
     if ( !(CASTOP(&(q->top),t,t+1)) ) {
@@ -122,12 +125,22 @@ void work(void *p, uint32_t n)
 void OSThreadProcAttr thief(void *info)
 {
     void *p;
+    void *batch[8];
     StgWord n;
+    uint32_t i, got;
     uint32_t count = 0;
 
     n = (StgWord)info;
 
     while (!done) {
+        // the last thief steals in batches
+        if (n == THREADS-1) {
+            got = stealHalfWSDeque(q, batch, 8);
+            for (i = 0; i < got; i++) {
+                work(batch[i],n+1); count++;
+            }
+            continue;
+        }
 #if defined(DEBUG)
         p = myStealWSDeque(q,n);
 #else
@@ -144,7 +157,8 @@ int main(int argc, char*argv[])
     uint32_t count = 0;
     void *p;
 
-    q = newWSDeque(1024);
+    // start small, so that the deque is resized while being stolen from
+    q = newWSDeque(16, 0);
     done = 0;
     
     for (n=0; n < SCRATCH_SIZE; n++) {
@@ -160,7 +174,9 @@ int main(int argc, char*argv[])
             p = popWSDeque(q);
             if (p != NULL) { work(p,0); count++; }
         }
-        pushWSDeque(q,&scratch[n]);
+        if (!pushWSDeque(q,&scratch[n])) {
+            barf("FAIL: push %d", n);
+        }
     }
 
 #if defined(DEBUG)
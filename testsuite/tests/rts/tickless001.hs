@@ -0,0 +1,33 @@
+-- With +RTS --tickless the ticker slows down while no Haskell code is
+-- running (Note [Tickless idle] in rts/Timer.c).  Check that threadDelay
+-- still wakes up on time after such an idle period, and that the ticker
+-- is back at its regular rate afterwards, so that a busy thread is
+-- preempted again.
+
+import Control.Concurrent
+import Control.Monad
+import Data.IORef
+import GHC.Clock
+
+main :: IO ()
+main = do
+  forM_ [1 :: Int .. 3] $ \_ -> do
+    t0 <- getMonotonicTime
+    threadDelay 300000
+    t1 <- getMonotonicTime
+    when (t1 - t0 < 0.3) $ putStrLn "woke up too early"
+    when (t1 - t0 > 5) $ putStrLn "woke up too late"
+  putStrLn "delays OK"
+
+  -- the main thread only gets to run again if the busy thread is
+  -- preempted
+  done <- newIORef False
+  _ <- forkIO $
+    let loop :: Int -> IO ()
+        loop n = do
+          d <- readIORef done
+          unless d $ loop (n + 1)
+    in loop 0
+  threadDelay 200000
+  writeIORef done True
+  putStrLn "preempted"